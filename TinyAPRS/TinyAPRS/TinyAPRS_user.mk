@@ -36,6 +36,9 @@ MOD_BEACON := 0
 MOD_TRACKER := 0
 MOD_DIGI := 0
 MOD_RADIO := 0
+MOD_FX25 := 0
+MOD_PORT2 := 0
+MOD_SLICERS := 1
 
 ifeq ($(TNC),1)
 MOD_CONSOLE := 1
@@ -113,6 +116,34 @@ TinyAPRS_USER_CSRC += \
 	$(TinyAPRS_SRC_PATH)/radio.c
 endif
 
+# FX.25 needs more RAM than the ATmega328P has
+ifeq ($(FX25),1)
+MOD_FX25 := 1
+TinyAPRS_MCU = atmega644p
+TinyAPRS_PROGRAMMER_CPU = atmega644p
+TinyAPRS_USER_CSRC += \
+	bertos/algo/rs.c \
+	bertos/net/fx25.c
+endif
+
+# A second radio port, on ADC1: the ISR runs twice as often and the second
+# modem needs ~900 bytes of RAM the ATmega328P does not have
+ifeq ($(PORT2),1)
+MOD_PORT2 := 1
+TinyAPRS_MCU = atmega644p
+TinyAPRS_PROGRAMMER_CPU = atmega644p
+endif
+
+# Additional demodulator slicers: each one needs a frame buffer of the
+# AX25 layer and ISR time the ATmega328P does not have
+ifneq ($(SLICERS),)
+MOD_SLICERS := $(SLICERS)
+endif
+ifneq ($(filter-out 1,$(MOD_SLICERS)),)
+TinyAPRS_MCU = atmega644p
+TinyAPRS_PROGRAMMER_CPU = atmega644p
+endif
+
 #TinyAPRS_USER_CSRC += \
 	#$(TinyAPRS_SRC_PATH)/lcd/hw_lcd_4884.c \	
 	#$(TinyAPRS_SRC_PATH)/hw/hw_softser.c \
@@ -156,7 +187,10 @@ TinyAPRS_USER_CPPFLAGS += \
 	-D'MOD_DIGI=$(MOD_DIGI)' \
 	-D'MOD_BEACON=$(MOD_BEACON)' \
 	-D'MOD_RADIO=$(MOD_RADIO)' \
-	-D'MOD_CONSOLE=$(MOD_CONSOLE)'
+	-D'MOD_CONSOLE=$(MOD_CONSOLE)' \
+	-D'MOD_FX25=$(MOD_FX25)' \
+	-D'MOD_PORT2=$(MOD_PORT2)' \
+	-D'MOD_SLICERS=$(MOD_SLICERS)'
 
 # Print binary size, make sure avr-size is in the PATH env
 AVRSIZE=avr-size
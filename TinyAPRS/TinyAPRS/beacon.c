@@ -40,12 +40,13 @@ void beacon_init(beacon_exit_callback_t exitcb){
 	lastSendTimeSeconds = 0;
 }
 
-static void _send_fixed_text(void){
+static bool _send_fixed_text(void){
 	char payload[128];
 	uint8_t payloadLen = settings_get_beacon_text(payload,127);
 	if(payloadLen > 0){
-		beacon_send(payload,payloadLen);
+		return beacon_send(payload,payloadLen);
 	}
+	return true;
 }
 
 #if CFG_BEACON_TEST
@@ -67,22 +68,30 @@ void beacon_broadcast_poll(void){
 		return;
 	}
 	volatile mtime_t currentTimestamp = timer_clock_seconds();
+	// the beacon is sent again by the next poll if the queue is full
 	if(lastSendTimeSeconds == 0){
 		// just started
-		lastSendTimeSeconds = timer_clock_seconds();
-		if(lastSendTimeSeconds > 0){ // possible be zero in less than 1 seconds
-			_send_fixed_text();
+		if(currentTimestamp > 0 && _send_fixed_text()){ // possible be zero in less than 1 seconds
+			lastSendTimeSeconds = currentTimestamp;
 		}
 		return;
 	}
 
-	if(currentTimestamp - lastSendTimeSeconds > beaconSendInterval){
-		_send_fixed_text();
+	if(currentTimestamp - lastSendTimeSeconds > beaconSendInterval && !beacon_channel_busy()
+			&& _send_fixed_text()){
 		lastSendTimeSeconds = timer_clock_seconds();
 	}
 }
 
-void beacon_send(char* payload, uint8_t payloadLen){
+bool beacon_channel_busy(void){
+#if CONFIG_AFSK_CHANNEL_LOAD && CFG_BEACON_MAX_LOAD
+	return afsk_channelLoad(&g_afsk, AFSK_LOAD_SYNC, AFSK_LOAD_1MIN) > CFG_BEACON_MAX_LOAD;
+#else
+	return false;
+#endif
+}
+
+bool beacon_send(char* payload, uint8_t payloadLen){
 	CallData calldata;
 	settings_get_call_data(&calldata);
 
@@ -95,12 +104,20 @@ void beacon_send(char* payload, uint8_t payloadLen){
 		pathCount++;
 	}
 
+#if CONFIG_AX25_TX_QUEUE
+	// don't hold the main loop while the beacon waits for the channel,
+	// the caller tries again later if the queue is full
+	if(!ax25_queueVia(&g_ax25, (AX25Call*)&calldata, pathCount, payload, payloadLen, NULL, NULL)){
+		return false;
+	}
+#else
 	ax25_sendVia(&g_ax25, (AX25Call*)&calldata, pathCount, payload, payloadLen);
+#endif
 
 #if CFG_BEACON_DEBUG
 	kfile_putc('.',&(g_serial.fd));
 #endif
-
+	return true;
 }
 
 //#define APRS_TEST_MSG "!3011.54N/12007.35E>000/000/A=000087Rolling! 3.6V 1011.0pa" // 六和塔
@@ -35,9 +35,14 @@ void beacon_init(beacon_exit_callback_t exitcb);
 void beacon_broadcast_poll(void);
 
 /*
- * Send raw payload
+ * Check if the channel is too busy to beacon now
  */
-void beacon_send(char* payload, uint8_t payloadLen);
+bool beacon_channel_busy(void);
+
+/*
+ * Send raw payload, false if it could not be queued
+ */
+bool beacon_send(char* payload, uint8_t payloadLen);
 
 #if CFG_BEACON_TEST
 /*
@@ -74,17 +74,21 @@
 
 /**
  * AFSK receiver buffer length.
+ * A power of 2, the FIFO being a lock-free ring (see struct/spscbuf.h).
  *
  * $WIZ$ type = "int"
  * $WIZ$ min = 2
+ * $WIZ$ max = 128
  */
 #define CONFIG_AFSK_RX_BUFLEN 64
 
 /**
  * AFSK transimtter buffer length.
+ * A power of 2, the FIFO being a lock-free ring (see struct/spscbuf.h).
  *
  * $WIZ$ type = "int"
  * $WIZ$ min = 2
+ * $WIZ$ max = 128
  */
 #define CONFIG_AFSK_TX_BUFLEN 64
 
@@ -105,6 +109,7 @@
 
 /**
  * AFSK Preamble length in [ms], before starting transmissions.
+ * Default of the value set at runtime by afsk_setTxDelay().
  * $WIZ$ type = "int"
  * $WIZ$ min = 1
  */
@@ -114,6 +119,7 @@
 
 /**
  * AFSK Trailer length in [ms], before stopping transmissions.
+ * Default of the value set at runtime by afsk_setTxDelay().
  * $WIZ$ type = "int"
  * $WIZ$ min = 1
  */
@@ -124,11 +130,155 @@
  */
 #define CONFIG_AFSK_ADC_USE_EXTERNAL_AREF 0
 
+/**
+ * AFSK output on the Timer2 fast PWM (OC2B, pin D3) instead of the
+ * 4 bit R-2R ladder on D4-D7: 8 bit samples at 62.5kHz, to be
+ * filtered by an RC low pass (e.g. 1k and 100nF).
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_DAC_PWM 0
+
 /**
  * AFSK stores carrier detected flag
  * $WIZ$ type = bool
  * $WIZ$ default value = 0
  */
-#define CONFIG_AFSK_CARRIER_DETECT_FLAG 0
+#define CONFIG_AFSK_CARRIER_DETECT_FLAG 1
+
+/**
+ * Channel load meter: the time the channel is busy with a signal
+ * (the carrier detect flag) and with HDLC frames, over the last second,
+ * minute and 10 minutes (see afsk_channelLoad()). Counted once per bit
+ * by the demodulator, takes about 50 bytes of RAM per modem.
+ * Needs CONFIG_AFSK_CARRIER_DETECT_FLAG.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_CHANNEL_LOAD 1
+
+/**
+ * Number of demodulator slicers.
+ * Additional slicers run on the same discriminator output with a
+ * different filter and threshold, recovering some of the frames the
+ * main one misses (see ax25_poll() for duplicates removal).
+ * Each one takes about CONFIG_AFSK_RX_BUFLEN + 20 bytes of RAM, a
+ * receive channel of the AX25 layer with its frame buffer, and about
+ * 60 CPU cycles per sample in the ADC ISR, which must stay below the
+ * 104us sample period. The ATmega328P has no RAM for a second one:
+ * "make SLICERS=n" builds the firmware with n slicers for the
+ * ATmega644P, profile its ADC ISR with bench/avr_prof.sh before use.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ * $WIZ$ max = 5
+ */
+#ifndef MOD_SLICERS
+	#define MOD_SLICERS 1
+#endif
+#define CONFIG_AFSK_SLICERS MOD_SLICERS
+
+/**
+ * ADC samples ring length, must be a power of 2 up to 256.
+ * If not 0, the ADC ISR only stores the samples here and they are
+ * demodulated in blocks by afsk_process_block(), called when the modem
+ * channel is read by ax25_poll(). This keeps the ISR short, so the
+ * UART is not starved at high baudrates, at the cost of this much RAM:
+ * the main loop must not stall more than the ring length in samples
+ * (at 9600Hz, 128 samples are 13ms), lost samples are counted.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ * $WIZ$ max = 256
+ */
+#define CONFIG_AFSK_SAMPLE_BUFLEN 0
+
+/**
+ * Full resolution ADC input with a DC blocker and an automatic gain control.
+ * The 10 bit ADC samples go through a single pole high-pass filter, which
+ * removes the bias of the audio input wherever it sits, and a slow digital
+ * AGC that scales them to the range of the discriminator: weak audio keeps
+ * the two low bits the 8 bit path throws away, and levels from about -36dB
+ * to full scale decode alike. Takes 6 bytes of RAM and about 50 CPU cycles
+ * per sample in the ADC ISR.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_AGC 1
+
+/**
+ * Mark/space twist equalizer, for the audio of the radio discriminator
+ * output, where the space tone can be up to 6dB louder than the mark tone
+ * and the FM noise rises with the frequency. The twist is measured on the
+ * HDLC flags of the received frames and kept from one frame to the next,
+ * see afsk_twist(); a first order filter in front of the discriminator
+ * cuts a louder space tone, with the noise above it. A weaker space tone,
+ * from de-emphasized audio, is left alone: raising it lost more frames
+ * than it saved on the SNR bench. Off by default, on white noise the cut
+ * loses frames too. Takes 14 bytes of RAM and about 40 CPU cycles per
+ * sample in the ADC ISR.
+ * Needs CONFIG_AFSK_AGC.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_EQ 0
+
+/**
+ * \name Bit clock recovery loops.
+ * $WIZ$ afsk_pll_list = "AFSK_PLL_SIMPLE", "AFSK_PLL_PI"
+ * \{
+ */
+#define AFSK_PLL_SIMPLE   0
+#define AFSK_PLL_PI       1
+/* \} */
+
+/**
+ * AFSK bit clock recovery loop.
+ * AFSK_PLL_SIMPLE moves the bit phase by a fixed step on every edge.
+ * AFSK_PLL_PI is a proportional-integral loop that locks within a few
+ * HDLC flags and then narrows its bandwidth: better with transmitters
+ * using a short TXDELAY, a bit heavier on the CPU.
+ *
+ * $WIZ$ type = "enum"; value_list = "afsk_pll_list"
+ */
+#define CONFIG_AFSK_PLL AFSK_PLL_PI
+
+/**
+ * Number of low confidence bits remembered for each received frame.
+ * ax25_poll() can use them to repair the frames with a wrong CRC
+ * (see CONFIG_AX25_CRC_FIX), 0 to disable. Takes 4 bytes of RAM each.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ * $WIZ$ max = 16
+ */
+#define CONFIG_AFSK_WEAK_BITS 0
+
+/* Set by "make FX25=1", the ATmega644P build profile */
+#ifndef MOD_FX25
+	#define MOD_FX25 0
+#endif
+
+/**
+ * FX.25 forward error correction.
+ * Frames are sent wrapped in a Reed-Solomon codeword when
+ * Afsk.fx25.tx_check is not 0, and FX.25 codewords are decoded in
+ * parallel with the plain HDLC frames, on the channel returned by
+ * afsk_fx25Channel(). Takes about 550 bytes of RAM and 500 bytes of
+ * stack for decoding: too much for the ATmega328P.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_FX25 MOD_FX25
+
+/**
+ * Parity bytes of the transmitted FX.25 frames: 16, 32 or 64,
+ * 0 to send plain AX.25 frames. Can be changed at runtime.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ * $WIZ$ max = 64
+ */
+#define CONFIG_AFSK_FX25_TX_CHECK 16
 
 #endif /* CFG_AFSK_H */
@@ -78,4 +78,118 @@
  */
 #define CONFIG_AX25_STAT 1
 
+/**
+ * Number of receive channels polled by ax25_poll().
+ * Channels beyond the first one are added with ax25_addRxChannel(),
+ * frames received by more than a channel are delivered once.
+ * Each additional channel takes CONFIG_AX25_FRAME_BUF_LEN + 10 bytes of RAM.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#ifndef MOD_FX25
+	#define MOD_FX25 0
+#endif
+#ifndef MOD_SLICERS
+	#define MOD_SLICERS 1
+#endif
+/* One for each demodulator slicer, one more for the FX.25 decoder */
+#define CONFIG_AX25_RX_CHANNELS (MOD_SLICERS + MOD_FX25)
+
+/**
+ * Try to repair the frames received with a wrong CRC on the main
+ * channel, flipping single bits, pairs of adjacent bits and pairs of
+ * the low confidence bits marked by the demodulator.
+ * Repaired frames must still look like APRS frames to be delivered.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AX25_CRC_FIX 0
+
+/**
+ * Maximum number of bits, counted from the end of the frame,
+ * searched by the CRC repair of a frame. Bounds the time spent
+ * on each broken frame.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 16
+ */
+#define CONFIG_AX25_CRC_FIX_BUDGET 2048
+
+/**
+ * Number of frames in the transmit queue, 0 to disable it.
+ * Frames sent with ax25_queueVia(), ax25_queueRaw() and ax25_queueMsg()
+ * are written to the channel by ax25_poll() when the channel is clear,
+ * so the main loop doesn't wait for the channel, and a callback is
+ * called when each one has been sent. A frame is written whole once
+ * started, the main loop waits for the modem only while the rest of
+ * it doesn't fit the modulator FIFO.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_AX25_TX_QUEUE 2
+
+/**
+ * Room for the data of the queued frames, FCS excluded.
+ * Each frame of the queue takes 10 more bytes on AVR.
+ * Frames that don't fit are copied in a free frame buffer, see
+ * CONFIG_AX25_FRAMES; 0 to always do so.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_AX25_TX_BUF_LEN 128
+
+/**
+ * Number of received frames queued for ax25_rxDeliver(), 0 to pass
+ * them to the hook from ax25_poll() instead.
+ * With the queue a slow hook doesn't hold up the channel: the frames
+ * received meanwhile are queued, or dropped and counted when it is full.
+ * Each queued frame holds a buffer of CONFIG_AX25_FRAMES; while none is
+ * free for the receiver to go on with, frames are passed to the hook
+ * from ax25_poll() as without the queue.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_AX25_RX_QUEUE 1
+
+/**
+ * Number of frame buffers, CONFIG_AX25_FRAME_BUF_LEN + 7 bytes each.
+ * Each receive channel holds one while receiving, the frames received
+ * are delivered in it and can be queued for transmission without
+ * copying them (see ax25_queueFrame()).
+ * The serial input (console, tracker and KISS) borrows one while a
+ * line or a KISS frame is being read, there is no other buffer for it.
+ * The ATmega328P has room for two, the receive channel's and the serial
+ * input's: the receive queue has no buffer of its own there and uses the
+ * serial input's while it is idle, the KISS queue and the digi pending
+ * slot are off (see CONFIG_KISS_QUEUE and CFG_DIGI_PENDING). main.c
+ * checks the budget.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#include "cfg_kiss.h"
+#include "cfg_digi.h"
+#ifndef MOD_PORT2
+	#define MOD_PORT2 0
+#endif
+#ifndef MOD_KISS
+	#define MOD_KISS 0
+#endif
+#ifndef MOD_DIGI
+	#define MOD_DIGI 0
+#endif
+/* Buffers of the receive queue, none on the ATmega328P */
+#if CPU_AVR_ATMEGA328P
+	#define CONFIG_AX25_RX_QUEUE_FRAMES 0
+#else
+	#define CONFIG_AX25_RX_QUEUE_FRAMES CONFIG_AX25_RX_QUEUE
+#endif
+/* One more for the second port, the serial input, the receive queue, the blocks of the KISS queue and the frames the digi holds */
+#define CONFIG_AX25_FRAMES (CONFIG_AX25_RX_CHANNELS + MOD_PORT2 + 1 + CONFIG_AX25_RX_QUEUE_FRAMES \
+		+ MOD_KISS * CONFIG_KISS_QUEUE + MOD_DIGI * CFG_DIGI_PENDING)
+
 #endif /* CFG_AX25_H */
@@ -21,4 +21,8 @@
 #define CFG_BEACON_DEBUG 1
 
 #define CFG_BEACON_TEST 1  // enables the beacon test feature
+
+// postpone the beacons while frames were received more than this percent of the last minute,
+// 0 to disable (needs CONFIG_AFSK_CHANNEL_LOAD)
+#define CFG_BEACON_MAX_LOAD 50
 #endif /* CFG_BEACON_H_ */
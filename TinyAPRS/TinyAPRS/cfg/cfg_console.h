@@ -28,7 +28,7 @@
 #define CONSOLE_SETTINGS_COMMAND_DEST_ENABLED 0		// Disable the at+dest command by default
 
 #if CONSOLE_SETTINGS_COMMANDS_ENABLED
-	#define CONSOLE_MAX_COMMAND	12					// How many AT commands to support
+	#define CONSOLE_MAX_COMMAND	16					// How many AT commands to support
 #else
 	#define CONSOLE_MAX_COMMAND	4					// How many AT commands to support
 #endif
@@ -19,9 +19,34 @@
 
 #define CFG_DIGI_ENABLED 1
 
-#define CFG_DIGI_DUP_CHECK_CACHE_SIZE 8
+// frames remembered by the duplicate check, a power of 2 up to 128, 4 bytes each
+#define CFG_DIGI_DUP_CHECK_CACHE_SIZE 32
 
-#define CFG_DIGI_DUP_CHECK_INTERVAL 15
+// seconds a frame is a duplicate after it was first heard, less than 128
+#define CFG_DIGI_DUP_CHECK_INTERVAL 30
+
+// milliseconds before a frame is repeated;
+// unused on the ATmega328P, which repeats right away (CFG_DIGI_PENDING 0)
+#define CFG_DIGI_DELAY 150
+
+// viscous digipeating: seconds a frame is held, cancelled if another digi repeats it meanwhile,
+// less than CFG_DIGI_DUP_CHECK_INTERVAL; 0 to repeat every frame after CFG_DIGI_DELAY.
+// Needs CFG_DIGI_PENDING, not available on the ATmega328P
+#define CFG_DIGI_VISCOUS_DELAY 0
+
+// frames waiting to be repeated, each one holds a frame buffer of the AX25 layer;
+// 0 to repeat them right away, CFG_DIGI_DELAY and viscous digipeating unused.
+// The ATmega328P has no RAM left for the extra frame buffer.
+#include <cpu/detect.h>
+#if CPU_AVR_ATMEGA328P
+#define CFG_DIGI_PENDING 0
+#else
+#define CFG_DIGI_PENDING 1
+#endif
+
+#if CFG_DIGI_VISCOUS_DELAY && !CFG_DIGI_PENDING
+#error CFG_DIGI_VISCOUS_DELAY needs CFG_DIGI_PENDING, the frames are held in the pending slots
+#endif
 
 #define CFG_DIGI_DEBUG 1
 #endif /* CFG_DIGI_H_ */
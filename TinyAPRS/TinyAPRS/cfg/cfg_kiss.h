@@ -19,11 +19,25 @@
 #define KISS_LOG_FORMAT     LOG_FMT_TERSE
 
 /**
- * KISS queue length
+ * KISS transmit queue length, in frames.
+ * Each frame takes a frame buffer of the AX25 layer (see CONFIG_AX25_FRAMES),
+ * the serial input is decoded in place in it, then it joins the transmit
+ * queue of the modem without being copied, until it has been sent. While
+ * the queue is full the serial input waits in the receive ring of the
+ * serial port: there is no flow control, the input that doesn't fit is
+ * lost and its frames dropped. Hosts should pace their frames with ACKMODE.
  * for AVR chip with 4k ram, 1 or 2 is enough
  * set 0 to disable the queue for Atmega328P with 2K ram
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
  */
+#include <cpu/detect.h>
+#if CPU_AVR_ATMEGA328P
 #define CONFIG_KISS_QUEUE	0
+#else
+#define CONFIG_KISS_QUEUE	2
+#endif
 
 
 #endif /* CFG_KISS_H */
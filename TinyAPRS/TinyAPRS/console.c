@@ -11,12 +11,21 @@
 #include "settings.h"
 #include "reader.h"
 
+#include <net/afsk.h>
 #include <net/ax25.h>
 
 #if MOD_BEACON
 #include "beacon.h"
 #endif
 
+#if MOD_DIGI
+#include "digi.h"
+#endif
+
+#if MOD_KISS
+#include <net/kiss.h>
+#endif
+
 #include <cfg/cfg_afsk.h> // afst configuration info
 #include <cfg/cfg_kiss.h> // kiss config
 
@@ -41,6 +50,14 @@ static bool cmd_send(Serial* pSer, char* command, size_t len);
 static bool cmd_test_send(Serial* pSer, char* command, size_t len);
 #endif
 
+#if CONFIG_AFSK_CHANNEL_LOAD
+static bool cmd_channel_load(Serial* pSer, char* value, size_t len);
+#endif
+
+#if CONFIG_AFSK_EQ
+static bool cmd_twist(Serial* pSer, char* value, size_t len);
+#endif
+
 struct COMMAND_ENTRY{
 	PGM_P cmdName;
 	PFUN_CMD_HANDLER cmdHandler;
@@ -193,6 +210,41 @@ static bool cmd_info(Serial* pSer, char* value, size_t len){
 	// print the ax25 stat
 #if CONFIG_AX25_STAT
 	SERIAL_PRINTF_P(pSer, PSTR("RX:%d, TX:%d, ERR: %d\r\n"),g_ax25.stat.rx_ok,g_ax25.stat.tx_ok,g_ax25.stat.rx_err);
+#endif
+#if CONFIG_AX25_STAT && MOD_PORT2
+	SERIAL_PRINTF_P(pSer, PSTR("Port2 RX:%d, TX:%d, ERR: %d\r\n"),g_ax25_2.stat.rx_ok,g_ax25_2.stat.tx_ok,g_ax25_2.stat.rx_err);
+#endif
+	SERIAL_PRINTF_P(pSer, PSTR("Frame buffers: %d/%d free\r\n"),ax25_framesFree(),CONFIG_AX25_FRAMES);
+#if CONFIG_AX25_STAT
+	SERIAL_PRINTF_P(pSer, PSTR("RX no buffer: %lu\r\n"),g_ax25.stat.rx_nobuf);
+#endif
+#if CONFIG_AX25_STAT && MOD_PORT2
+	SERIAL_PRINTF_P(pSer, PSTR("Port2 RX no buffer: %lu\r\n"),g_ax25_2.stat.rx_nobuf);
+#endif
+#if CONFIG_AX25_STAT && CONFIG_AX25_RX_QUEUE
+	SERIAL_PRINTF_P(pSer, PSTR("RX queue max: %d, dropped: %lu\r\n"),g_ax25.stat.rx_qmax,g_ax25.stat.rx_qdrop);
+#endif
+#if CONFIG_AX25_STAT && CONFIG_AX25_RX_QUEUE && MOD_PORT2
+	SERIAL_PRINTF_P(pSer, PSTR("Port2 RX queue max: %d, dropped: %lu\r\n"),g_ax25_2.stat.rx_qmax,g_ax25_2.stat.rx_qdrop);
+#endif
+#if MOD_KISS
+	SERIAL_PRINTF_P(pSer, PSTR("KISS serial overruns: %u, frames dropped: %u\r\n"),kiss_rx_overruns(),kiss_rx_drops());
+#endif
+#if MOD_DIGI
+	{
+	uint16_t hits, misses, evicts, held, cancels;
+	digi_dup_stat(&hits, &misses, &evicts);
+	SERIAL_PRINTF_P(pSer, PSTR("Digi dups: %u, new: %u, evicted: %u\r\n"),hits,misses,evicts);
+	digi_pending_stat(&held, &cancels);
+	SERIAL_PRINTF_P(pSer, PSTR("Digi held: %u, cancelled: %u\r\n"),held,cancels);
+	}
+#endif
+
+#if CONFIG_AFSK_SAMPLE_BUFLEN
+	SERIAL_PRINTF_P(pSer, PSTR("ADC overrun: %u\r\n"),g_afsk.sample_overrun);
+#if MOD_PORT2
+	SERIAL_PRINTF_P(pSer, PSTR("Port2 ADC overrun: %u\r\n"),g_afsk2.sample_overrun);
+#endif
 #endif
 
 	// print free memory
@@ -218,6 +270,11 @@ static bool cmd_help(Serial* pSer, char* command, size_t len){
 	SERIAL_PRINT_P(pSer,PSTR("AT+SYMBOL=[SYMBOL_TABLE/IDX]\t;Set beacon symbol\r\n"));
 	SERIAL_PRINT_P(pSer,PSTR("AT+BEACON=[45]\t\t\t;Set beacon interval, 0 to disable \r\n"));
 	SERIAL_PRINT_P(pSer,PSTR("AT+TEXT=[!3011.54N/12007.35E>]\t;Set beacon text \r\n"));
+	SERIAL_PRINT_P(pSer,PSTR("AT+TXDELAY=[35]\t\t\t;Set preamble length, in 10ms units\r\n"));
+	SERIAL_PRINT_P(pSer,PSTR("AT+TXTAIL=[8]\t\t\t;Set trailer length, in 10ms units\r\n"));
+	SERIAL_PRINT_P(pSer,PSTR("AT+PERSIST=[63]\t\t\t;Set CSMA persistence, 0-255\r\n"));
+	SERIAL_PRINT_P(pSer,PSTR("AT+SLOT=[10]\t\t\t;Set CSMA slot time, in 10ms units\r\n"));
+	SERIAL_PRINT_P(pSer,PSTR("AT+DUPLEX=[0|1]\t\t\t;Set full duplex, no CSMA\r\n"));
 #endif
 	SERIAL_PRINT_P(pSer,PSTR("AT+MODE=[0|1|2]\t\t\t;Set device run mode, see manual\r\n"));
 	SERIAL_PRINT_P(pSer,PSTR("AT+KISS=[1]\t\t\t;Enter kiss mode\r\n"));
@@ -381,6 +438,61 @@ static bool cmd_settings_beacon_interval(Serial* pSer, char* value, size_t value
 }
 
 
+/*
+ * Set/display a rf parameter, as the KISS parameter commands do
+ */
+static bool _settings_rf_param(Serial* pSer, char* value, size_t valueLen, uint8_t *param, PGM_P name){
+	if(valueLen > 0){
+		int i = atoi((const char*) value);
+		if(i < 0 || i > 255){
+			return false;
+		}
+		*param = i;
+		settings_apply_rf();
+		settings_save();
+	}
+	SERIAL_PRINTF_P(pSer,PSTR("%S: %d\r\n"),name,*param);
+	return true;
+}
+
+/*
+ * AT+TXDELAY=35, preamble length in 10ms units
+ */
+static bool cmd_settings_txdelay(Serial* pSer, char* value, size_t valueLen){
+	return _settings_rf_param(pSer,value,valueLen,&g_settings.rf.txdelay,PSTR("TXDELAY"));
+}
+
+/*
+ * AT+TXTAIL=8, trailer length in 10ms units
+ */
+static bool cmd_settings_txtail(Serial* pSer, char* value, size_t valueLen){
+	return _settings_rf_param(pSer,value,valueLen,&g_settings.rf.txtail,PSTR("TXTAIL"));
+}
+
+/*
+ * AT+PERSIST=63, CSMA persistence
+ */
+static bool cmd_settings_persistence(Serial* pSer, char* value, size_t valueLen){
+	return _settings_rf_param(pSer,value,valueLen,&g_settings.rf.persistence,PSTR("PERSIST"));
+}
+
+/*
+ * AT+SLOT=10, CSMA slot time in 10ms units
+ */
+static bool cmd_settings_slot_time(Serial* pSer, char* value, size_t valueLen){
+	return _settings_rf_param(pSer,value,valueLen,&g_settings.rf.slot_time,PSTR("SLOT"));
+}
+
+/*
+ * AT+DUPLEX=[0|1], 1 to transmit without waiting for a clear channel
+ */
+static bool cmd_settings_duplex(Serial* pSer, char* value, size_t valueLen){
+	if(valueLen > 0 && value[0] != '0' && value[0] != '1'){
+		return false;
+	}
+	return _settings_rf_param(pSer,value,valueLen,&g_settings.rf.duplex,PSTR("DUPLEX"));
+}
+
 /*
  * enable/disable smart beacon
  */
@@ -402,6 +514,62 @@ static bool cmd_settings_beacon_interval(Serial* pSer, char* value, size_t value
 
 #endif // end of #if ENABLE_CONSOLE_AT_COMMANDS
 
+#if CONFIG_AFSK_CHANNEL_LOAD
+static void _print_channel_load(Serial* pSer, PGM_P port, Afsk *af){
+	SERIAL_PRINTF_P(pSer, PSTR("%SLoad 1s/1m/10m: energy %u/%u/%u%%, sync %u/%u/%u%%\r\n"),port,
+			afsk_channelLoad(af, AFSK_LOAD_ENERGY, AFSK_LOAD_1S),
+			afsk_channelLoad(af, AFSK_LOAD_ENERGY, AFSK_LOAD_1MIN),
+			afsk_channelLoad(af, AFSK_LOAD_ENERGY, AFSK_LOAD_10MIN),
+			afsk_channelLoad(af, AFSK_LOAD_SYNC, AFSK_LOAD_1S),
+			afsk_channelLoad(af, AFSK_LOAD_SYNC, AFSK_LOAD_1MIN),
+			afsk_channelLoad(af, AFSK_LOAD_SYNC, AFSK_LOAD_10MIN));
+}
+
+/*
+ * AT+LOAD, time the channel is busy with a signal (energy) and with frames (sync)
+ */
+static bool cmd_channel_load(Serial* pSer, char* value, size_t len){
+	(void)value;
+	(void)len;
+	_print_channel_load(pSer, PSTR(""), &g_afsk);
+#if MOD_PORT2
+	_print_channel_load(pSer, PSTR("Port2 "), &g_afsk2);
+#endif
+	return true;
+}
+#endif
+
+#if CONFIG_AFSK_EQ
+/*
+ * AT+TWIST, mark/space twist measured by the equalizer on each port,
+ * AT+TWIST=1 saves it to start from after a reset, AT+TWIST=0 forgets it
+ */
+static bool cmd_twist(Serial* pSer, char* value, size_t len){
+	int8_t twist[SETTINGS_TWIST_PORTS];
+	settings_get_twist(twist);
+	if(len > 0){
+		if(value[0] == '1'){
+			twist[0] = afsk_twist(&g_afsk);
+#if MOD_PORT2
+			twist[1] = afsk_twist(&g_afsk2);
+#endif
+			settings_set_twist(twist);
+		}else if(value[0] == '0'){
+			twist[0] = twist[1] = 0;
+			settings_set_twist(twist);
+			settings_apply_twist();
+		}else{
+			return false;
+		}
+	}
+	SERIAL_PRINTF_P(pSer, PSTR("Twist: %d dB, saved %d dB\r\n"), afsk_twist(&g_afsk), twist[0]);
+#if MOD_PORT2
+	SERIAL_PRINTF_P(pSer, PSTR("Port2 Twist: %d dB, saved %d dB\r\n"), afsk_twist(&g_afsk2), twist[1]);
+#endif
+	return true;
+}
+#endif
+
 #if MOD_BEACON && CFG_BEACON_TEST
 /*
  * !{n} - send {n} test packets
@@ -466,12 +634,26 @@ void console_init(){
 	#if SETTINGS_SUPPORT_BEACON_TEXT
     console_add_command(PSTR("TEXT"),cmd_settings_beacon_text);
 	#endif
+
+    console_add_command(PSTR("TXDELAY"),cmd_settings_txdelay);	// radio keying time
+    console_add_command(PSTR("TXTAIL"),cmd_settings_txtail);
+    console_add_command(PSTR("PERSIST"),cmd_settings_persistence);	// CSMA parameters
+    console_add_command(PSTR("SLOT"),cmd_settings_slot_time);
+    console_add_command(PSTR("DUPLEX"),cmd_settings_duplex);
 #endif
 
 #if CONSOLE_SEND_COMMAND_ENABLED
     console_add_command(PSTR("SEND"),cmd_send);
 #endif
 
+#if CONFIG_AFSK_CHANNEL_LOAD
+    console_add_command(PSTR("LOAD"),cmd_channel_load);		// channel load
+#endif
+
+#if CONFIG_AFSK_EQ
+    console_add_command(PSTR("TWIST"),cmd_twist);		// mark/space twist
+#endif
+
 	// Initialization done, display the welcome banner and settings info
 	cmd_info(&g_serial,0,0);
 }
@@ -15,6 +15,7 @@
  */
 
 #include "digi.h"
+#include "digi_dup.h"
 
 #include <net/afsk.h>
 #include <net/ax25.h>
@@ -26,169 +27,251 @@
 #include "settings.h"
 #include "utils.h"
 
-typedef struct CacheEntry{
-	uint16_t hash;
-	uint32_t timestamp; // in seconds
-}CacheEntry;
-
 #define DIGI_DEBUG CFG_DIGI_DEBUG
-#define DUP_CHECK_INTERVAL CFG_DIGI_DUP_CHECK_INTERVAL
-#define CURRENT_TIME_SECONDS() (ticks_to_ms(timer_clock()) / 1000)
-#define CACHE_SIZE CFG_DIGI_DUP_CHECK_CACHE_SIZE
-static CacheEntry cache[CACHE_SIZE];
-static uint8_t cacheIndex;
+#define DUP_TICK_MS 1000L // coarse tick of the duplicate table
+static DigiDup dupTable;
+
+#if CFG_DIGI_VISCOUS_DELAY
+// the copies heard after the hold must still be found as duplicates
+STATIC_ASSERT(CFG_DIGI_VISCOUS_DELAY < CFG_DIGI_DUP_CHECK_INTERVAL);
+#define DIGI_HOLD_MS (CFG_DIGI_VISCOUS_DELAY * 1000L)
+#else
+#define DIGI_HOLD_MS CFG_DIGI_DELAY
+#endif
+
+#if CFG_DIGI_PENDING
+/*
+ * Frame waiting to be repeated by digi_poll(), its path already updated
+ */
+typedef struct DigiPending{
+	AX25Frame *frame;	// reference held until repeated or cancelled, NULL if the slot is free
+	uint16_t len;		// FCS excluded
+	uint16_t key;		// key in the duplicate table
+	ticks_t time;		// when it was heard
+}DigiPending;
+
+static DigiPending pending[CFG_DIGI_PENDING];
+#endif
+static uint16_t delayed, cancelled;
 
 void digi_init(void){
-	memset(&cache,0,sizeof(CacheEntry) * CACHE_SIZE);
-	cacheIndex = 0;
+	digi_dup_init(&dupTable);
+#if CFG_DIGI_PENDING
+	memset(pending, 0, sizeof(pending));
+#endif
+	delayed = cancelled = 0;
 }
 
+/*
+ * Counters of the duplicate table
+ */
+void digi_dup_stat(uint16_t *hits, uint16_t *misses, uint16_t *evicts){
+	*hits = dupTable.hits;
+	*misses = dupTable.misses;
+	*evicts = dupTable.evicts;
+}
+
+/*
+ * Counters of the frames held before being repeated, and of those
+ * cancelled as another digi repeated them first
+ */
+void digi_pending_stat(uint16_t *held, uint16_t *cancels){
+	*held = delayed;
+	*cancels = cancelled;
+}
 
-//FIXME - CSMA check ?
+
+/*
+ * Bits of the SSID byte of an address field
+ */
+#define DIGI_SSID_LAST	0x01	// extension bit, set on the last address
+#define DIGI_SSID_H		0x80	// has-been-repeated bit of a repeater
+#define DIGI_SSID_HOP	0x02	// SSID unit, the SSID is in bits 4:1
+
+/*
+ * "WIDE" as in the address field, followed by "1" to "3" and a space
+ */
+static const uint8_t digiAlias[] = { 'W' << 1, 'I' << 1, 'D' << 1, 'E' << 1 };
+
+static bool _digi_is_alias(const uint8_t *addr){
+	return memcmp(addr, digiAlias, sizeof(digiAlias)) == 0
+			&& addr[4] >= ('1' << 1) && addr[4] <= ('3' << 1)
+			&& addr[5] == (' ' << 1);
+}
 
 static uint32_t c = 1;
-static bool _digi_repeat_message(AX25Msg *msg){
-	// force delay 150ms
-	timer_delay(150);
+static bool _digi_repeat_frame(AX25Frame *frame, uint16_t len){
 #if DIGI_DEBUG
-	kfile_printf_P(&g_serial.fd,PSTR(">[%d]digipeat:\r\n"),c++);
-	ax25_print(&g_serial.fd, msg);
+	{
+		AX25Msg msg;
+		kfile_printf_P(&g_serial.fd,PSTR(">[%d]digipeat:\r\n"),c++);
+		if(ax25_frameDecode(frame, &msg)){
+			ax25_print(&g_serial.fd, &msg);
+		}
+	}
 #endif
-	ax25_sendMsg(&g_ax25, msg);
+	// the frame goes as it is, the FCS is computed again while sending it
+#if CONFIG_AX25_TX_QUEUE
+	// queued to wait for the channel, false if the queue is full
+	return ax25_queueFrame(&g_ax25, frame, 0, len, NULL, NULL);
+#else
+	ax25_sendRaw(&g_ax25, frame->buf, len);
 	return true;
+#endif
 }
 
 
 /*
- * Calculate the digi message hashcode
+ * Keep the frame until digi_poll() repeats it. If all the slots are
+ * taken it is repeated right away, or dropped if the queue is full.
  */
-static uint16_t _digi_calc_hash(AX25Msg *msg){
-	uint16_t hash = 0;
-	size_t i = 0;
-
-	for(i = 0;i < 6;i++){	//APRS src/dst call size is fixed to 6 bytes
-		hash = hash * 31 +  msg->src.call[i];
-	}
-	hash = hash * 31 + msg->src.ssid;
-
-	for(i = 0;i < 6;i++){
-		hash = hash * 31 +  msg->dst.call[i];
-	}
-	hash = hash * 31 + msg->dst.ssid;
-
-	for(i = 0;i < msg->len;i++){
-		hash = hash * 31 + msg->info[i];
+static bool _digi_hold_frame(AX25Frame *frame, uint16_t len, uint16_t key){
+#if CFG_DIGI_PENDING
+	for(uint8_t i = 0; i < CFG_DIGI_PENDING; i++){
+		DigiPending *p = &pending[i];
+		if(!p->frame){
+			p->frame = ax25_frameRef(frame);
+			p->len = len;
+			p->key = key;
+			p->time = timer_clock();
+			delayed++;
+			return true;
+		}
 	}
-	return hash;
+#else
+	(void)key;
+#endif
+	return _digi_repeat_frame(frame, len);
 }
 
+#if CFG_DIGI_VISCOUS_DELAY
 /*
- * duplication checks
+ * Drop the pending frame with \a key, another digi has repeated it.
  */
-static bool _digi_check_is_duplicated(AX25Msg *msg){
-	bool dup = false;
-	uint16_t hash = _digi_calc_hash(msg);
-	// check starts from the latest cache entry
-	for(uint8_t i = CACHE_SIZE ;cacheIndex > 0 &&  i >0 ;i--){
-		uint8_t j = (cacheIndex - 1 + i) % CACHE_SIZE;
-		if((cache[j].hash == hash) && (CURRENT_TIME_SECONDS() - cache[j].timestamp) < DUP_CHECK_INTERVAL ){
-			dup = true;
-			break;
+static void _digi_cancel_frame(uint16_t key){
+	for(uint8_t i = 0; i < CFG_DIGI_PENDING; i++){
+		DigiPending *p = &pending[i];
+		if(p->frame && p->key == key){
+			ax25_frameRelease(p->frame);
+			p->frame = NULL;
+			cancelled++;
 		}
 	}
-	if(!dup){
-		cacheIndex++;
-		if(cacheIndex > CACHE_SIZE) cacheIndex = cacheIndex - CACHE_SIZE;
-		cache[cacheIndex - 1].hash = hash;
-		cache[cacheIndex - 1].timestamp = ticks_to_ms(timer_clock()) / 1000;
-	}
-	return dup;
 }
+#endif
 
-#define copy_rpt_sta(src,dst) \
-	memset(&(dst->call),0,6); \
-	memcpy(&(dst->call),&(src->call),5); \
-	dst->ssid = src->ssid;
-
-#define rpt_required(rpt) \
-
-
-bool digi_handle_aprs_message(struct AX25Msg *msg){
-	/*
-	AX25Call rptd[AX25_MAX_RPT];
-	uint8_t i = 0,j=0;
-	BOOL changed = false;
-	for(;i < msg->rpt_cnt;i++,j++){
-		AX25Call *rpt = msg->rpt_lst + i;
-		if( ((strncasecmp_P(rpt->call,PSTR("WIDE1"),5) == 0) || (strncasecmp_P(rpt->call,PSTR("WIDE2"),5) == 0) || (strncasecmp_P(rpt->call,PSTR("WIDE3"),5) == 0))
-				&& (rpt->ssid > 0)
-				&& !(AX25_REPEATED(msg,i)) ){
+/*
+ * Digipeat a frame, FCS included, working on its address field in place.
+ *
+ * The next hop is the first repeater not repeated yet. If it is WIDEn-N
+ * with N > 1, MYCALL* is inserted before it and N decreased; the last hop
+ * WIDEn-1 is replaced by MYCALL*. The other repeaters, before and after
+ * it, are kept as they are.
+ *
+ * The frame is repeated by digi_poll() after CFG_DIGI_DELAY ms, or in
+ * viscous mode after CFG_DIGI_VISCOUS_DELAY s unless another digi is
+ * heard repeating it first. Without pending slots (CFG_DIGI_PENDING 0)
+ * it is repeated right away.
+ */
+bool digi_handle_frame(AX25Frame *frame){
+	uint8_t *buf = frame->buf;
+	uint16_t len = frame->len - 2; // FCS excluded
 
-			if(_digi_check_is_duplicated(msg)){
-				// seems duplicated in cache, drop
-				return false;
-			}
+	// find the end of the address field, CTRL and PID follow
+	uint16_t end = 2 * AX25_CALL_LEN;
+	if(frame->len < AX25_MIN_FRAME_LEN){
+		return false;
+	}
+	while(!(buf[end - 1] & DIGI_SSID_LAST)){
+		end += AX25_CALL_LEN;
+		if(end > (2 + AX25_MAX_RPT) * AX25_CALL_LEN || end + 2 > len){
+			return false;
+		}
+	}
+	if(buf[end] != AX25_CTRL_UI || buf[end + 1] != AX25_PID_NOLAYER3){
+		return false;
+	}
 
-			// insert mycall
-			if()
+	// key in the duplicate table, the path excluded
+	uint16_t key = digi_dup_key(buf, end, len);
+	uint8_t *rpt = buf + 2 * AX25_CALL_LEN;
+#if CFG_DIGI_VISCOUS_DELAY
+	if(rpt < buf + end && (rpt[AX25_CALL_LEN - 1] & DIGI_SSID_H)){
+		// repeated by a digi, a frame we hold is not needed anymore
+		_digi_cancel_frame(key);
+	}
+#endif
+	while(rpt < buf + end && (rpt[AX25_CALL_LEN - 1] & DIGI_SSID_H)){
+		rpt += AX25_CALL_LEN;
+	}
+	if(rpt == buf + end || !_digi_is_alias(rpt)){
+		return false;
+	}
 
+	uint8_t *ssid = rpt + AX25_CALL_LEN - 1;
+	uint8_t hops = (*ssid >> 1) & 0x0f;
+	if(hops == 0){
+		return false;
+	}
+	if(hops > 1 && (end == (2 + AX25_MAX_RPT) * AX25_CALL_LEN
+			|| (size_t)frame->len + AX25_CALL_LEN > sizeof(frame->buf))){
+		// no space left for the new digi call, drop;
+		return false;
+	}
 
-			changed = true;
-			continue;
-		}
-		// just copy
-		copy_rpt_sta(&(msg->rpt_lst + i), &(rptd + j));
+	// check duplications
+	if(digi_dup_check(&dupTable, key, len - end, timer_clock() / ms_to_ticks(DUP_TICK_MS))){
+		// seems duplicated in cache, drop
+		return false;
 	}
-	*/
-#if 1
-	// A quick-n-dirty digipeat logic based on the assumption: WIDE2-2 is always the last element in the path.
 #if DIGI_DEBUG
-	bool prt = false;
+	{
+		AX25Msg msg;
+		kfile_printf_P(&g_serial.fd,PSTR(">[%d]original:\r\n"),c);
+		if(ax25_frameDecode(frame, &msg)){
+			ax25_print(&g_serial.fd, &msg);
+		}
+	}
 #endif
 
-	for(int i = 0;i < msg->rpt_cnt;i++){
-		AX25Call *sta = msg->rpt_lst + i;
-		if( ((strncasecmp_P(sta->call,PSTR("WIDE1"),5) == 0) || (strncasecmp_P(sta->call,PSTR("WIDE2"),5) == 0) || (strncasecmp_P(sta->call,PSTR("WIDE3"),5) == 0))
-				&& (sta->ssid > 0)
-				&& !(AX25_REPEATED(msg,i)) ){
-
-			// check duplications;
-			if(_digi_check_is_duplicated(msg)){
-				// seems duplicated in cache, drop
-				return false;
-			}
-#if DIGI_DEBUG
-			if(!prt){
-				kfile_printf_P(&g_serial.fd,PSTR(">[%d]original:\r\n"),c);
-				ax25_print(&g_serial.fd, msg);
-				prt = true;
-			}
+	AX25Call mycall;
+	settings_get_mycall(&mycall);
+	if(hops > 1){
+		// case: WIDE2-2, becomes MYCALL*,WIDE2-1
+		memmove(rpt + AX25_CALL_LEN, rpt, frame->len - (rpt - buf));
+		frame->len += AX25_CALL_LEN;
+		len += AX25_CALL_LEN;
+		ssid[AX25_CALL_LEN] -= DIGI_SSID_HOP;
+		ax25_encodeCall(rpt, &mycall, false, true);
+	}else{
+		// case: WIDE2-1, becomes MYCALL*
+		ax25_encodeCall(rpt, &mycall, *ssid & DIGI_SSID_LAST, true);
+	}
+	return _digi_hold_frame(frame, len, key);
+}
 
-#endif
+/*
+ * Repeat the pending frames held long enough, from the main loop.
+ * While the queue is full they are tried again, for up to
+ * DIGI_RETRY_MS: a later copy would only add to the channel load.
+ */
+#define DIGI_RETRY_MS 2000L
 
-			if(sta->ssid >1){ //    case: WIDE2-2
-				sta->ssid--; // subtract: WIDE2-1
-				if(i < AX25_MAX_RPT - 1){
-					AX25Call *c = sta + 1; // the next element in path to be copied/overwritten to
-					memset(&c->call,0,6);
-					memcpy(&c->call,&sta->call,5);
-					c->ssid = sta->ssid;
-					AX25_SET_REPEATED(msg,i+1,0);
-					if(i == msg->rpt_cnt-1){ // increase count if current element[i] is the last one in path list
-						msg->rpt_cnt++; //
-					} // otherwise the next element is overwritten :(
-				}else{
-					// no space left for the new digi call, drop;
-					return false;
-				}
-			}
-			// current element[i] will be replaced by THIS digi call and mark repeated.
-			settings_get_mycall(sta);
-			AX25_SET_REPEATED(msg,i,1);
-			return _digi_repeat_message(msg);
+void digi_poll(void){
+#if CFG_DIGI_PENDING
+	for(uint8_t i = 0; i < CFG_DIGI_PENDING; i++){
+		DigiPending *p = &pending[i];
+		if(!p->frame){
+			continue;
+		}
+		ticks_t held = timer_clock() - p->time;
+		if(held < ms_to_ticks(DIGI_HOLD_MS)){
+			continue;
+		}
+		if(_digi_repeat_frame(p->frame, p->len) || held >= ms_to_ticks(DIGI_HOLD_MS + DIGI_RETRY_MS)){
+			ax25_frameRelease(p->frame);
+			p->frame = NULL;
 		}
-	}// end for
+	}
 #endif
-	return false;
 }
-
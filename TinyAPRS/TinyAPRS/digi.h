@@ -19,11 +19,15 @@
 
 #include "cfg/cfg_digi.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 void digi_init(void);
 
-struct AX25Msg *msg;
-bool digi_handle_aprs_message(struct AX25Msg *msg);
+struct AX25Frame;
+bool digi_handle_frame(struct AX25Frame *frame);
+void digi_poll(void);
+void digi_dup_stat(uint16_t *hits, uint16_t *misses, uint16_t *evicts);
+void digi_pending_stat(uint16_t *held, uint16_t *cancels);
 
 
 #endif /* DIGI_H_ */
@@ -0,0 +1,153 @@
+/*
+ * \file digi_dup.h
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Duplicate suppression table of the digipeater.
+ *
+ * A frame is keyed by the CRC of its source, destination and payload,
+ * the digi path excluded, so the copies digipeated by other stations
+ * match the original. The keys go in an open addressed table, each one
+ * searched in DIGI_DUP_PROBES slots from its hash: a lookup costs the
+ * same whatever the table size. The slot is picked by some bits of the
+ * CRC, which are then the same for the keys compared: the length of the
+ * hashed part is stored too, so that different frames seldom match.
+ *
+ * Entries are stamped with 8-bit coarse ticks (e.g. seconds) and live
+ * for the window; expired ones are reused, the whole table is swept
+ * once per window so that no live stamp is old enough to wrap around.
+ *
+ * Free of hardware dependencies, so that it can be benchmarked on the host.
+ */
+
+#ifndef DIGI_DUP_H_
+#define DIGI_DUP_H_
+
+#include <cfg/compiler.h>
+#include <cfg/macros.h>
+#include <algo/crc_ccitt.h>
+
+#include <string.h>
+
+#ifndef DIGI_DUP_SIZE
+	#include "cfg/cfg_digi.h"
+	#define DIGI_DUP_SIZE   CFG_DIGI_DUP_CHECK_CACHE_SIZE
+	#define DIGI_DUP_WINDOW CFG_DIGI_DUP_CHECK_INTERVAL
+#endif
+
+// slots searched for a key, the oldest entry among them is evicted when all are live
+#define DIGI_DUP_PROBES 4
+
+STATIC_ASSERT(DIGI_DUP_SIZE >= DIGI_DUP_PROBES && DIGI_DUP_SIZE <= 128 && !(DIGI_DUP_SIZE & (DIGI_DUP_SIZE - 1)));
+// entries are swept at most a window after expiring, before their stamp wraps around
+STATIC_ASSERT(DIGI_DUP_WINDOW > 0 && DIGI_DUP_WINDOW < 128);
+
+typedef struct DigiDupEntry{
+	uint16_t key;		// CRC of the frame
+	uint8_t len;		// length of the hashed part, low byte
+	uint8_t tick;		// coarse tick when it was first heard
+}DigiDupEntry;
+
+typedef struct DigiDup{
+	DigiDupEntry entries[DIGI_DUP_SIZE];
+	uint8_t used[(DIGI_DUP_SIZE + 7) / 8];	// slots holding an entry
+	uint32_t sweepTick;		// last sweep
+	uint16_t hits;			// duplicates found
+	uint16_t misses;		// new frames
+	uint16_t evicts;		// live entries replaced for lack of room
+}DigiDup;
+
+INLINE void digi_dup_init(DigiDup *d){
+	memset(d, 0, sizeof(*d));
+}
+
+/*
+ * Key of the frame in buf, FCS excluded: CRC of the destination and source
+ * callsigns and SSIDs, the H/extension/reserved bits masked out, and of the
+ * control, PID and payload from ctrl on
+ */
+INLINE uint16_t digi_dup_key(const uint8_t *buf, uint16_t ctrl, uint16_t len){
+	uint16_t crc = CRC_CCITT_INIT_VAL;
+	for(uint8_t i = 0; i < 14; i++){
+		uint8_t c = buf[i];
+		if(i == 6 || i == 13){
+			c &= 0x1e;
+		}
+		crc = updcrc_ccitt(c, crc);
+	}
+	for(uint16_t i = ctrl; i < len; i++){
+		crc = updcrc_ccitt(buf[i], crc);
+	}
+	return crc;
+}
+
+INLINE bool digi_dup_used(const DigiDup *d, uint8_t i){
+	return d->used[i >> 3] & BV(i & 7);
+}
+
+INLINE void digi_dup_set_used(DigiDup *d, uint8_t i, bool used){
+	if(used){
+		d->used[i >> 3] |= BV(i & 7);
+	}else{
+		d->used[i >> 3] &= ~BV(i & 7);
+	}
+}
+
+INLINE bool digi_dup_live(const DigiDup *d, uint8_t i, uint8_t now){
+	return digi_dup_used(d, i) && (uint8_t)(now - d->entries[i].tick) < DIGI_DUP_WINDOW;
+}
+
+/*
+ * Check if the frame with \a key, and \a len bytes from the control field
+ * on, has been heard within the window, otherwise remember it.
+ * \a now counts the coarse ticks.
+ */
+INLINE bool digi_dup_check(DigiDup *d, uint16_t key, uint8_t len, uint32_t now){
+	uint8_t now8 = (uint8_t)now;
+
+	if(now - d->sweepTick >= DIGI_DUP_WINDOW){
+		d->sweepTick = now;
+		for(uint8_t i = 0; i < DIGI_DUP_SIZE; i++){
+			if(!digi_dup_live(d, i, now8)){
+				digi_dup_set_used(d, i, false);
+			}
+		}
+	}
+
+	uint8_t h = (key ^ (key >> 8)) & (DIGI_DUP_SIZE - 1);
+	uint8_t slot = DIGI_DUP_SIZE, oldest = h;
+	for(uint8_t n = 0; n < DIGI_DUP_PROBES; n++){
+		uint8_t i = (h + n) & (DIGI_DUP_SIZE - 1);
+		if(!digi_dup_live(d, i, now8)){
+			if(slot == DIGI_DUP_SIZE){
+				slot = i;
+			}
+			continue;
+		}
+		if(d->entries[i].key == key && d->entries[i].len == len){
+			d->hits++;
+			return true;
+		}
+		if((uint8_t)(now8 - d->entries[i].tick) > (uint8_t)(now8 - d->entries[oldest].tick)){
+			oldest = i;
+		}
+	}
+
+	d->misses++;
+	if(slot == DIGI_DUP_SIZE){
+		d->evicts++;
+		slot = oldest;
+	}
+	d->entries[slot].key = key;
+	d->entries[slot].len = len;
+	d->entries[slot].tick = now8;
+	digi_dup_set_used(d, slot, true);
+	return false;
+}
+
+#endif /* DIGI_DUP_H_ */
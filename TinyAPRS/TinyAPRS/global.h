@@ -29,6 +29,17 @@ extern struct AX25Ctx g_ax25;
 struct Afsk;
 extern struct Afsk g_afsk;
 
+/*
+ * Radio ports, each with its own modem. KISS port 0 is g_afsk/g_ax25,
+ * port 1 is g_afsk2/g_ax25_2 (PORT2=1 builds).
+ */
+#define TNC_PORTS (1 + MOD_PORT2)
+
+#if MOD_PORT2
+extern struct AX25Ctx g_ax25_2;
+extern struct Afsk g_afsk2;
+#endif
+
 struct GPS;
 extern struct GPS g_gps;
 
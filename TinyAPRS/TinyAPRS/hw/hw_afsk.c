@@ -39,41 +39,76 @@
 
 #include "hw_afsk.h"
 
+#include "global.h"
+
 #include <net/afsk.h>
 #include <cpu/irq.h>
+#include <cpu/detect.h>
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
+#if MOD_PORT2 && CPU_AVR_ATMEGA328P
+	#error "The second port does not fit in the ATmega328P, build with PORT2=1 for the ATmega644P"
+#endif
+
+#if CONFIG_AFSK_SLICERS > 1 && CPU_AVR_ATMEGA328P
+	#error "The additional slicers do not fit in the ATmega328P, build with SLICERS=n for the ATmega644P"
+#endif
+
+/* Port of the ADC inputs */
+#if CPU_AVR_ATMEGA644P
+	#define ADC_DDR  DDRA
+	#define ADC_PORT PORTA
+#else
+	#define ADC_DDR  DDRC
+	#define ADC_PORT PORTC
+#endif
 
 /*
- * Here we are using only one modem. If you need to receive
- * from multiple modems, you need to define an array of contexts.
+ * One modem context per port. With two ports the conversions alternate
+ * between their ADC channels, each sampled at 9600Hz.
  */
-static Afsk *ctx;
+static Afsk *ctx[TNC_PORTS];
+#if MOD_PORT2
+static uint8_t adc_mux[TNC_PORTS];
+static uint8_t adc_ports;
+static uint8_t adc_cur;
+#endif
 
 void hw_afsk_adcInit(int ch, Afsk *_ctx)
 {
-	ctx = _ctx;
 	ASSERT(ch <= 5);
 
-	/* Set prescaler to clk/8 (2 MHz), CTC, top = ICR1 */
-	TCCR1A = 0;
-	TCCR1B = BV(CS11) | BV(WGM13) | BV(WGM12);
-	/* Set max value to obtain a 9600Hz freq */
-	ICR1 = ((CPU_FREQ / 8) / 9600) - 1;
-
 	/* Set reference to AVCC (5V), select CH */
 	//#define CONFIG_AFSK_ADC_USE_EXTERNAL_AREF 0 - See cfg_afsk.h
 #if defined(CONFIG_AFSK_ADC_USE_EXTERNAL_AREF) && (CONFIG_AFSK_ADC_USE_EXTERNAL_AREF==1)
-	ADMUX = ch;
+	uint8_t mux = ch;
 #else
-	ADMUX = BV(REFS0) | ch; // by default we'll use VCC as AREF
+	uint8_t mux = BV(REFS0) | ch; // by default we'll use VCC as AREF
 #endif
-	DDRC &= ~BV(ch);
-	PORTC &= ~BV(ch);
+	ADC_DDR &= ~BV(ch);
+	ADC_PORT &= ~BV(ch);
 	DIDR0 |= BV(ch); // Digital Input Disable Register is enabled on pin(ch)
 
+#if MOD_PORT2
+	ASSERT(adc_ports < TNC_PORTS);
+	adc_mux[adc_ports] = mux;
+	ctx[adc_ports] = _ctx;
+	if (adc_ports++)
+		return;
+#else
+	ctx[0] = _ctx;
+#endif
+
+	/* Set prescaler to clk/8 (2 MHz), CTC, top = ICR1 */
+	TCCR1A = 0;
+	TCCR1B = BV(CS11) | BV(WGM13) | BV(WGM12);
+	/* Set max value to obtain a 9600Hz freq on each port */
+	ICR1 = ((CPU_FREQ / 8) / (9600 * TNC_PORTS)) - 1;
+
+	ADMUX = mux;
+
 	/* Set autotrigger on Timer1 Input capture flag */
 	ADCSRB = BV(ADTS2) | BV(ADTS1) | BV(ADTS0);
 	/* Enable ADC, autotrigger, 1MHz, IRQ enabled */
@@ -83,17 +118,102 @@ void hw_afsk_adcInit(int ch, Afsk *_ctx)
 }
 
 
-bool hw_afsk_dac_isr;
+void hw_afsk_dacInit(int ch, Afsk *_ctx)
+{
+	(void)_ctx;
+
+#if MOD_PORT2
+	if (ch)
+	{
+		DDRB |= BV(AFSK_PTT2_PIN);
+	#if CONFIG_AFSK_DAC_PWM
+		/* Timer2 fast PWM on OC2A, set up with the first port */
+		DDRD |= BV(7);
+		OCR2A = 128;
+		TCCR2A |= BV(COM2A1);
+	#else
+		DDRC |= 0xF0; /* PC4-PC7 as data */
+	#endif
+		return;
+	}
+#else
+	(void)ch;
+#endif
+
+	DDRB |= BV(AFSK_PTT_PIN); /* D8 as PTT */
+
+#if CONFIG_AFSK_DAC_PWM
+	/* Timer2 fast PWM on OC2B (D3, PD6 on the ATmega644P), no prescaler: 62.5kHz */
+	#if CPU_AVR_ATMEGA644P
+	DDRD |= BV(6);
+	#else
+	DDRD |= BV(3);
+	#endif
+	OCR2B = 128;
+	TCCR2A = BV(COM2B1) | BV(WGM21) | BV(WGM20);
+	TCCR2B = BV(CS20);
+#else
+	DDRD |= 0xF0; /* D4-D7 as data */
+#endif
+}
+
+/*
+ * Put a sample out on the DAC of a port
+ */
+#if CONFIG_AFSK_DAC_PWM
+	#define DAC_OUT(val)  (OCR2B = (val))
+	#define DAC2_OUT(val) (OCR2A = (val))
+#else
+	#define DAC_OUT(val)  (PORTD = (val) & 0xF0)
+	#define DAC2_OUT(val) (PORTC = ((val) & 0xF0) | (PORTC & 0x0F))
+#endif
+
+bool hw_afsk_dac_isr[TNC_PORTS];
+
+/*
+ * ADC conversion centered on 0: the whole 10 bits when the demodulator
+ * removes the DC offset itself, the 8 high ones otherwise
+ */
+#if CONFIG_AFSK_AGC
+	#define ADC_SAMPLE() ((int16_t)ADC - 512)
+#else
+	#define ADC_SAMPLE() ((int16_t)((ADC) >> 2) - 128)
+#endif
 
 /*
  * This is how you declare an ISR.
+ *
+ * With two ports the ISR runs at twice the rate, so it must finish in half
+ * the time: 832 cycles at 16MHz instead of 1664, for the demodulator and the
+ * modulator of one port.
  */
 DECLARE_ISR(ADC_vect)
 {
 	TIFR1 = BV(ICF1);
-	afsk_adc_isr(ctx, ((int16_t)((ADC) >> 2) - 128));
-	if (hw_afsk_dac_isr)
-		PORTD = afsk_dac_isr(ctx) & 0xF0;
+#if MOD_PORT2
+	uint8_t i = adc_cur;
+	/* The next conversion, started by Timer1, samples the other port */
+	adc_cur = !i;
+	ADMUX = adc_mux[adc_cur];
+
+	Afsk *af = ctx[i];
+	if (!af)
+		return;
+	afsk_adc_isr(af, ADC_SAMPLE());
+	if (i)
+	{
+		if (hw_afsk_dac_isr[1])
+			DAC2_OUT(afsk_dac_isr(af));
+		else
+			DAC2_OUT(128);
+		return;
+	}
+#else
+	Afsk *af = ctx[0];
+	afsk_adc_isr(af, ADC_SAMPLE());
+#endif
+	if (hw_afsk_dac_isr[0])
+		DAC_OUT(afsk_dac_isr(af));
 	else
-		PORTD = 128;
+		DAC_OUT(128);
 }
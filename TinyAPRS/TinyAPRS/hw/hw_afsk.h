@@ -53,9 +53,18 @@ void hw_afsk_dacInit(int ch, struct Afsk *_ctx);
  *    D8     -->  PTT OUT
  *    D9     -->  TX(RED) LED OUT
  *    D10    -->  RX(GRN) LED OUT
+ *
+ *  Second port (PORT2=1 builds, ATmega644P):
+ *    ADC1      -->  Audio IN
+ *    PC4-PC7   -->  Data OUT (OC2A with CONFIG_AFSK_DAC_PWM)
+ *    PB3       -->  PTT OUT
+ *  The TX/RX LEDs are shared by both ports.
  * ------------------------------------------------------------------------
  */
 
+#define AFSK_PTT_PIN  0 /* PB0, D8 */
+#define AFSK_PTT2_PIN 3 /* PB3 */
+
 /**
  * Initialize the specified channel of the ADC for AFSK needs.
  * The adc should be configured to have a continuos stream of convertions.
@@ -107,18 +116,25 @@ void hw_afsk_dacInit(int ch, struct Afsk *_ctx);
  * \param ctx AFSK context (\see Afsk).  This parameter must be saved and
  *             passed back to afsk_dac_isr() for every convertion.
  */
-#define AFSK_DAC_INIT(ch, ctx)   do { (void)ch, (void)ctx; DDRD |= 0xF0/*D4-D7 as data*/; DDRB |= BV(0)/*D8 as PTT*/; } while (0)
+#define AFSK_DAC_INIT(ch, ctx)   hw_afsk_dacInit(ch, ctx)
+
+/*
+ * Each port has its own PTT pin, set with a single sbi/cbi so that the
+ * ISR stopping one port can't undo the other one starting.
+ */
+#define AFSK_PTT_ON(ch)   do { if (ch) PORTB |= BV(AFSK_PTT2_PIN); else PORTB |= BV(AFSK_PTT_PIN); } while (0)
+#define AFSK_PTT_OFF(ch)  do { if (ch) PORTB &= ~BV(AFSK_PTT2_PIN); else PORTB &= ~BV(AFSK_PTT_PIN); } while (0)
 
 /**
  * Start DAC convertions on channel \a ch.
  * \param ch DAC channel.
  */
-#define AFSK_DAC_IRQ_START(ch)   do { (void)ch; extern bool hw_afsk_dac_isr; PORTB |= BV(0)/*PTT on*/; hw_afsk_dac_isr = true; } while (0)
+#define AFSK_DAC_IRQ_START(ch)   do { extern bool hw_afsk_dac_isr[]; AFSK_PTT_ON(ch); hw_afsk_dac_isr[(ch) ? 1 : 0] = true; } while (0)
 
 /**
  * Stop DAC convertions on channel \a ch.
  * \param ch DAC channel.
  */
-#define AFSK_DAC_IRQ_STOP(ch)    do { (void)ch; extern bool hw_afsk_dac_isr; PORTB &= ~BV(0)/*PTT off*/; hw_afsk_dac_isr = false; } while (0)
+#define AFSK_DAC_IRQ_STOP(ch)    do { extern bool hw_afsk_dac_isr[]; AFSK_PTT_OFF(ch); hw_afsk_dac_isr[(ch) ? 1 : 0] = false; } while (0)
 
 #endif /* HW_AFSK_H */
@@ -68,12 +68,36 @@
 
 Afsk g_afsk;
 AX25Ctx g_ax25;
+#if MOD_PORT2
+Afsk g_afsk2;
+AX25Ctx g_ax25_2;
+#endif
 Serial g_serial;
 SerialReader g_serialreader;
 
+#if CPU_AVR_ATMEGA328P
+/*
+ * RAM budget of the ATmega328P: the modem, the AX25 layer with its frame
+ * buffers and the serial port must leave RAM_RESERVE bytes for the data
+ * of the other modules (duplicate table, KISS, console, settings: ~300
+ * in the DIGI build) and for the stack. Each frame buffer takes ~340
+ * bytes: a profile that doesn't fit has to drop one, see
+ * CONFIG_AX25_FRAMES, which counts the one of the serial input.
+ */
+#define RAM_RESERVE 640
+STATIC_ASSERT(sizeof(Afsk) + sizeof(AX25Ctx) + CONFIG_AX25_FRAMES * sizeof(AX25Frame)
+		+ sizeof(Serial) + CONFIG_UART0_RXBUFSIZE + CONFIG_UART0_TXBUFSIZE
+		+ sizeof(SerialReader) + RAM_RESERVE <= RAMEND - RAMSTART + 1);
+#endif
+
 #define ADC_CH 0
 #define DAC_CH 0
 
+#if MOD_PORT2
+#define ADC_CH2 1
+#define DAC_CH2 1
+#endif
+
 // DEBUG FLAGS
 #define DEBUG_FREE_RAM 0
 #define DEBUG_SOFT_SER 0
@@ -103,13 +127,14 @@ static void ax25_msg_callback(struct AX25Msg *msg){
 
 #if MOD_KISS
 	case MODE_KISS:
-		kiss_send_to_serial(0x00/*kiss port id*/,0x00,g_ax25.buf,g_ax25.frm_len - 2);
+		kiss_send_to_serial(0x00/*kiss port id*/,0x00,g_ax25.frame->buf,g_ax25.frame->len - 2);
 		break;
 #endif
 
 #if MOD_DIGI
 	case MODE_DIGI:
-		digi_handle_aprs_message(msg);
+		// pass through, the frame is digipeated as it is
+		digi_handle_frame(g_ax25.frame);
 		break;
 #endif
 
@@ -119,6 +144,39 @@ static void ax25_msg_callback(struct AX25Msg *msg){
 	}
 }
 
+#if MOD_PORT2
+/*
+ * callback when ax25 message received from the second radio port
+ */
+static void ax25_msg_callback_port2(struct AX25Msg *msg){
+	switch(currentMode){
+	case MODE_CFG:
+		ax25_print(&(g_serial.fd),msg);
+		break;
+
+#if MOD_KISS
+	case MODE_KISS:
+		kiss_send_to_serial(0x01/*kiss port id*/,0x00,g_ax25_2.frame->buf,g_ax25_2.frame->len - 2);
+		break;
+#endif
+
+	default:
+		// the digipeater and tracker work on the first port only
+		break;
+	}
+}
+#endif
+
+/*
+ * parse the frames received on all the ports, or pass them through as they are
+ */
+static void set_pass_through(bool pass_through){
+	g_ax25.pass_through = pass_through;
+#if MOD_PORT2
+	g_ax25_2.pass_through = pass_through;
+#endif
+}
+
 /*
  * callback when kiss mode is end
  */
@@ -161,7 +219,7 @@ static bool cmd_switch_mode(Serial* pSer, char* value, size_t len){
 		case MODE_CFG:
 			// Enter COMMAND/CONFIG MODE
 			currentMode = MODE_CFG;
-			g_ax25.pass_through = 0;		// parse ax25 frames
+			set_pass_through(false);		// parse ax25 frames
 			ser_purge(pSer);  			// clear all rx/tx buffer
 			SERIAL_PRINT_P(pSer,PSTR("Enter Config mode\r\n"));
 			break;
@@ -169,7 +227,7 @@ static bool cmd_switch_mode(Serial* pSer, char* value, size_t len){
 		case MODE_KISS:
 			// Enter KISS MODE
 			currentMode = MODE_KISS;
-			g_ax25.pass_through = 1;		// don't parse ax25 frames
+			set_pass_through(true);		// don't parse ax25 frames
 			ser_purge(pSer);  			// clear serial rx/tx buffer
 			SERIAL_PRINT_P(pSer,PSTR("Enter KISS mode\r\n"));
 			break;
@@ -190,7 +248,7 @@ static bool cmd_switch_mode(Serial* pSer, char* value, size_t len){
 		case MODE_DIGI:
 			// DIGI MODE
 			currentMode = MODE_DIGI;
-			g_ax25.pass_through = 0;		// need parse ax25 frames
+			set_pass_through(true);		// digipeat the raw frames
 			SERIAL_PRINT_P(pSer,PSTR("Enter Digi mode\r\n"));
 			break;
 #endif
@@ -276,6 +334,11 @@ static void init(void)
 	 * We do not need transmission for now, so we set transmission DAC channel to 0.
 	 */
 	afsk_init(&g_afsk, ADC_CH, DAC_CH);
+#if MOD_PORT2
+	afsk_init(&g_afsk2, ADC_CH2, DAC_CH2);
+#endif
+	settings_apply_rf();
+	settings_apply_twist();
 
 	/*
 	 * Here we initialize AX25 context, the channel (KFile) we are going to read messages
@@ -284,10 +347,48 @@ static void init(void)
 	ax25_init(&g_ax25, &g_afsk.fd, ax25_msg_callback);
 	g_ax25.pass_through = false;
 
+#if CONFIG_AX25_CRC_FIX && CONFIG_AFSK_WEAK_BITS
+	g_ax25.weak_bits = afsk_weakBits;
+#endif
+
+	// Queued frames are written as the modem has room for them, once the channel is clear
+#if CONFIG_AX25_TX_QUEUE
+	g_ax25.tx_room = afsk_txRoom;
+	g_ax25.tx_frames = afsk_txFrames;
+	g_ax25.tx_clear = afsk_txClear;
+#endif
+
+	// The second port has its own AX25 context, so its own stats and transmit queue
+#if MOD_PORT2
+	ax25_init(&g_ax25_2, &g_afsk2.fd, ax25_msg_callback_port2);
+	g_ax25_2.pass_through = false;
+#if CONFIG_AX25_TX_QUEUE
+	g_ax25_2.tx_room = afsk_txRoom;
+	g_ax25_2.tx_frames = afsk_txFrames;
+	g_ax25_2.tx_clear = afsk_txClear;
+#endif
+#endif
+
+	// Frames from the additional demodulator slicers, if any
+#if CONFIG_AFSK_SLICERS > 1
+	STATIC_ASSERT(CONFIG_AX25_RX_CHANNELS >= CONFIG_AFSK_SLICERS);
+	for (int i = 0; i < CONFIG_AFSK_SLICERS - 1; i++)
+		ax25_addRxChannel(&g_ax25, afsk_slicerChannel(&g_afsk, i));
+#endif
+
+	// Frames recovered by the FX.25 decoder
+#if CONFIG_AFSK_FX25
+	STATIC_ASSERT(CONFIG_AX25_RX_CHANNELS >= CONFIG_AFSK_SLICERS + 1);
+	ax25_addRxChannel(&g_ax25, afsk_fx25Channel(&g_afsk));
+#endif
+
 	// Initialize the kiss module
-	// NOTE - use shared memory buffer
+	// NOTE - the serial input is decoded in the frame buffers of the AX25 arena
 #if MOD_KISS
 	kiss_init(&g_serialreader,&g_ax25);
+#if MOD_PORT2
+	kiss_add_port(&g_ax25_2);
+#endif
 #endif
 
 #if MOD_BEACON
@@ -332,9 +433,24 @@ int main(void){
 		 * If there's nothing to do, this function will call cpu_relax()
 		 */
 		ax25_poll(&g_ax25);
+#if MOD_PORT2
+		ax25_poll(&g_ax25_2);
+#endif
+#if CONFIG_AX25_RX_QUEUE
+		// the frames received are passed to the callbacks here, out of ax25_poll()
+		ax25_rxDeliver(&g_ax25);
+#if MOD_PORT2
+		ax25_rxDeliver(&g_ax25_2);
+#endif
+#endif
 
 		check_run_mode();
 
+#if MOD_DIGI
+		// repeat the frames held by the digi, also flushed after leaving the digi mode
+		digi_poll();
+#endif
+
 		switch(currentMode){
 			case MODE_CFG:
 #if MOD_CONSOLE
@@ -1,7 +1,6 @@
 #include "kiss.h"
 
 #include <cfg/compiler.h>
-#include <algo/rand.h>
 
 #define LOG_LEVEL  KISS_LOG_LEVEL
 #define LOG_FORMAT KISS_LOG_FORMAT
@@ -25,11 +24,6 @@
 #include <algo/crc_ccitt.h>
 
 
-#define KISS_FEND  0xc0
-#define KISS_FESC  0xdb
-#define KISS_TFEND 0xdc
-#define KISS_TFESC 0xdd
-
 enum {
 	KISS_CMD_DATA = 0,
 	KISS_CMD_TXDELAY,
@@ -40,96 +34,202 @@ enum {
 	KISS_CMD_SetHardware,
 	KISS_CMD_CONFIG_TEXT = 0x0B,
 	KISS_CMD_CONFIG_CALL = 0x0C,
+	KISS_CMD_ACKMODE = 0x0C, // same as CONFIG_CALL, once enabled with KISS_HW_ACKMODE
 	KISS_CMD_CONFIG_PARAMS = 0x0D,
 	KISS_CMD_CONFIG_ERROR = 0x0E,
 	KISS_CMD_CONFIG_MAGIC = 0x0F,
 	KISS_CMD_Return = 0xFF
 };
 
-enum {
-	KISS_QUEUE_IDLE = 0,
-	KISS_QUEUE_DELAYED,
-};
-
 static KissCtx kiss;
 
+#if CONFIG_AFSK_CHANNEL_LOAD
+// SetHardware request of the channel load, replied with the load in percent:
+// energy and sync over 1s, 1min and 10min
+#define KISS_HW_LOAD 'L'
+#endif
+// SetHardware request to save the rf parameters set by the KISS commands
+// to the EEPROM, replied with 'S'
+#define KISS_HW_SAVE 'S'
+// SetHardware request 'A' 1 to take the KISS_CMD_ACKMODE frames as ACKMODE
+// until 'A' 0 or the Return command, instead of KISS_CMD_CONFIG_CALL;
+// replied with 'A' and the state
+#define KISS_HW_ACKMODE 'A'
+static void kiss_handle_hardware_cmd(uint8_t port, const uint8_t *data, uint16_t size);
+
+#if CONFIG_KISS_QUEUE
+#if !CONFIG_AX25_TX_QUEUE
+	#error "The KISS queue needs CONFIG_AX25_TX_QUEUE"
+#endif
+
+static void kiss_queue_frame(uint16_t len);
+static void kiss_poll_queue(void);
+#endif
+
 static bool verify_config_data(uint8_t *frame,uint16_t size);
 static void kiss_handle_frame(uint8_t *frame, uint16_t size);
 static void kiss_handle_config_params_cmd(uint8_t *frame, uint16_t size);
 static void kiss_handle_config_text_cmd(uint8_t *frame, uint16_t size);
 static void kiss_handle_config_call_cmd(uint8_t *frame, uint16_t size);
 static void kiss_handle_config_magic_cmd(uint8_t *frame, uint16_t size);
+static void kiss_handle_rf_param_cmd(uint8_t cmd, uint8_t value);
+static bool kiss_is_ackmode_frame(const uint8_t *frame, uint16_t size);
+static bool kiss_is_modem_frame(const uint8_t *frame, uint16_t size);
+static void kiss_send_to_modem_ack(uint8_t port, uint8_t *buf, size_t len);
 
 static void _send_to_serial_begin(uint8_t port, uint8_t cmd);
-static void _send_to_serial(uint8_t *buf, size_t len);
+static void _send_to_serial(const uint8_t *buf, size_t len);
 static void _send_to_serial_end(void);
 
 
 void kiss_init(struct SerialReader *serialReader,struct AX25Ctx *modem){
 	memset(&kiss,0,sizeof(KissCtx));
 	kiss.serialReader = serialReader;
-	kiss.modem = modem;
+	kiss.modem[0] = modem;
+	// the serial input is decoded in the frame buffers, see kiss_rx_ready()
+	kiss_decoder_init(&kiss.rx, NULL, CONFIG_AX25_FRAME_BUF_LEN);
+#if CONFIG_KISS_QUEUE
+	LIST_INIT(&kiss.txQueue);
+#endif
 
 	//kiss.serial = serialReader->ser;
-	//NOTE - Atmega328P has limited 2048 RAM, so here we have to use shared read buffer to save memory
-	//kiss.rxBuf = serialReader->buf;			// Shared buffer in SerialReader
-	//kiss.rxBufLen = serialReader->bufLen; 	// buffer length, should be >= CONFIG_AX25_FRAME_BUF_LEN
 }
 
-static void kiss_poll_serial(void){
-	SerialReader *reader = kiss.serialReader;
+/*
+ * The modem of the next KISS port
+ */
+void kiss_add_port(struct AX25Ctx *modem){
+	for(uint8_t i = 0; i < TNC_PORTS; i++){
+		if(!kiss.modem[i]){
+			kiss.modem[i] = modem;
+			return;
+		}
+	}
+}
 
-	int c = ser_getchar(reader->ser); // Make sure CONFIG_SERIAL_RXTIMEOUT = 0
-	if (c == EOF) {
-		return;
+INLINE void kiss_decode(uint8_t c){
+	uint16_t len = kiss_decoder_put(&kiss.rx, c);
+	if (len > 0) {
+#if CONFIG_KISS_QUEUE
+		if (kiss_is_modem_frame(kiss.rx.buf, len)) {
+			kiss_queue_frame(len);
+			return;
+		}
+#endif
+		kiss_handle_frame(kiss.rx.buf, len);
 	}
+}
+
+/*
+ * Frame buffers KISS may hold, its share of CONFIG_AX25_FRAMES: the
+ * serial input's and the ones of the queue. The queued frames are
+ * counted until they have been sent, so that a burst from the host
+ * doesn't take the buffers of the receivers.
+ */
+#define KISS_FRAMES (1 + CONFIG_KISS_QUEUE)
+
+/*
+ * Get a frame buffer of the arena to decode the serial input in, once
+ * there is some. Without one the serial input is left in the receive
+ * ring: the serial port has no flow control, so the input that doesn't
+ * fit there is lost, and the frames it belonged to are dropped and
+ * counted (see kiss_rx_drops()). Hosts keep within the queue with ACKMODE.
+ */
+static bool kiss_rx_ready(Serial *ser){
+	if(!kiss.rxFrame){
+		if(ser_fifo_isempty_locked(&ser->rxfifo) || kiss.frames == KISS_FRAMES
+				|| !(kiss.rxFrame = ax25_frameAlloc())){
+			return false;
+		}
+		kiss.frames++;
+		kiss.rx.buf = kiss.rxFrame->buf;
+	}
+	return true;
+}
 
-	static bool escaped = false;
-	// sanity checks
-	// no serial input in last 2 secs?
-	if ((reader->readLen != 0)
+/*
+ * Decode all the input waiting in the serial receive ring, so that it
+ * does not overrun while the main loop is busy with the modem.
+ * The ring is left as it is while there is no frame buffer to decode
+ * it in, and the buffer goes back to the arena between frames.
+ */
+static void kiss_poll_serial(void){
+	Serial *ser = kiss.serialReader->ser;
+	int c;
+
+	// no serial input in last 2 secs? drop the partial frame
+	if ((kiss.rx.len != 0)
 			&& (timer_clock() - kiss.rxTick > ms_to_ticks(2000L))) {
 		LOG_INFO("Serial - Timeout\n");
-		reader->readLen = 0;
+		kiss_decoder_reset(&kiss.rx);
 	}
 
-	// about to overflow buffer? reset
-	if (reader->readLen >= (reader->bufLen - 2)) {
-		LOG_INFO("Serial - Packet too long %d >= %d\n", reader->readLen,
-				reader->bufLen - 2);
-		reader->readLen = 0;
+	// ser_getchar() returns EOF until the errors are cleared
+	int err = ser_getstatus(ser) & SERRF_RX;
+	if (err) {
+		if (err & (SERRF_RXFIFOOVERRUN | SERRF_RXSROVERRUN)) {
+			kiss.rxOverruns++;
+			LOG_INFO("Serial - Overrun %u\n", kiss.rxOverruns);
+		}
+
+		// The bytes lost came after the ones in the ring, decode these
+		// before dropping the frame they belong to
+#if CONFIG_SER_SPSC
+		ptrdiff_t n = ser_fifo_count(&ser->rxfifo);
+#else
+		FIFOBuffer *fifo = &ser->rxfifo;
+		ptrdiff_t n;
+		ATOMIC(n = fifo->tail - fifo->head);
+		if (n < 0) {
+			n += fifo->end - fifo->begin + 1;
+		}
+#endif
+		kfile_clearerr(&ser->fd);
+		if (kiss.rxLost) {
+			// lost again before the ring was decoded: drop it all
+			ser_purgeRx(ser);
+			n = 0;
+		}
+		kiss.rxKeep = n;
+		kiss.rxLost = true;
 	}
 
-	if (c == KISS_FEND) {
-		if ((!escaped) && (reader->readLen > 0)) {
-			kiss_handle_frame(reader->buf, reader->readLen);
+	while (kiss_rx_ready(ser)) {
+		if (kiss.rxLost && kiss.rxKeep == 0) {
+			kiss_decoder_drop(&kiss.rx);
+			kiss.rxDrops++;
+			kiss.rxLost = false;
 		}
-		reader->readLen = 0;
-		escaped = false;
-		return;
-	} else if (c == KISS_FESC) {
-		escaped = true;
-		return;
-	} else if (c == KISS_TFESC) {
-		if (escaped) {
-			escaped = false;
-			c = KISS_FESC;
+		if ((c = ser_getchar(ser)) == EOF) { // Make sure CONFIG_SERIAL_RXTIMEOUT = 0
+			break;
 		}
-	} else if (c == KISS_TFEND) {
-		if (escaped) {
-			escaped = false;
-			c = KISS_FEND;
+		if (kiss.rxLost) {
+			kiss.rxKeep--;
 		}
-	} else if (escaped) {
-		escaped = false;
+		kiss.rxTick = timer_clock();
+		kiss_decode(c);
 	}
 
-	reader->buf[reader->readLen++] = c & 0xff;
-	kiss.rxTick = timer_clock();
+	if (kiss.rxFrame && kiss.rx.len == 0) {
+		ax25_frameRelease(kiss.rxFrame);
+		kiss.rxFrame = NULL;
+		kiss.frames--;
+	}
 }
 
 void kiss_poll() {
 	kiss_poll_serial();
+#if CONFIG_KISS_QUEUE
+	kiss_poll_queue();
+#endif
+}
+
+uint16_t kiss_rx_overruns(void) {
+	return kiss.rxOverruns;
+}
+
+uint16_t kiss_rx_drops(void) {
+	return kiss.rxDrops;
 }
 
 static void kiss_handle_frame(uint8_t *frame, uint16_t size) {
@@ -139,6 +239,7 @@ static void kiss_handle_frame(uint8_t *frame, uint16_t size) {
 	// Check return command
 	if (size == 1 && frame[0] == KISS_CMD_Return) {
 		//LOG_INFO("Kiss - exiting");
+		kiss.ackMode = false;
 		return;
 	}
 
@@ -152,17 +253,35 @@ static void kiss_handle_frame(uint8_t *frame, uint16_t size) {
 	uint8_t port = frame[0] >> 4 & 0x0f;
 	uint8_t *payload = frame + 1;
 
-	if (port > 0) {
-		//WARN: ignore the port id ?
+	if (port >= TNC_PORTS || !kiss.modem[port]) {
+		LOG_INFO("Kiss - discarding packet - no port %d\n", port);
 		return;
 	}
 
-	switch (cmd) {
-	case KISS_CMD_DATA:
+	if (cmd == KISS_CMD_DATA) {
 		//LOG_INFO("Kiss - handle frame message\n");
-		kiss_send_to_modem(payload, size - 1);
-		break;
+		kiss_send_to_modem(port, payload, size - 1);
+		return;
+	}
+
+	if (cmd == KISS_CMD_ACKMODE && kiss.ackMode) {
+		if (kiss_is_ackmode_frame(payload, size - 1)) {
+			kiss_send_to_modem_ack(port, payload, size - 1);
+		}
+		return;
+	}
+
+	if (cmd == KISS_CMD_SetHardware) {
+		kiss_handle_hardware_cmd(port, payload, size - 1);
+		return;
+	}
+
+	// The config and rf parameters are shared by the ports, set them on the first one only
+	if (port > 0) {
+		return;
+	}
 
+	switch (cmd) {
 	case KISS_CMD_CONFIG_PARAMS:
 		if(verify_config_data(payload,size -1)){
 			kiss_handle_config_params_cmd(payload, size - 2);
@@ -186,41 +305,13 @@ static void kiss_handle_frame(uint8_t *frame, uint16_t size) {
 			kiss_handle_config_magic_cmd(payload, size - 2);
 		}
 		break;
-		/*
-		 case KISS_CMD_TXDELAY:{
-		 //LOG_INFO("Kiss - setting txdelay %d\n", k->buf[1]);
-		 if(kiss.rxBuf[1] > 0){
-		 kiss_txdelay = kiss.rxBuf[1];
-		 }
-		 break;
-		 }
-		 case KISS_CMD_P:{
-		 //LOG_INFO("Kiss - setting persistence %d\n", k->buf[1]);
-		 if(kiss.rxBuf[1] > 0){
-		 kiss_persistence = kiss.rxBuf[1];
-		 }
-		 break;
-		 }
-		 case KISS_CMD_SlotTime:{
-		 //LOG_INFO("Kiss - setting slot_time %d\n", k->buf[1]);
-		 if(kiss.rxBuf[1] > 0){
-		 kiss_slot_time = kiss.rxBuf[1];
-		 }
-		 break;
-		 }
-		 case KISS_CMD_TXtail:{
-		 LOG_INFO("Kiss - setting txtail %d\n", k->buf[1]);
-		 if(k->buf[1] > 0){
-		 kiss_txtail = k->buf[1];
-		 }
-		 break;
-		 }
-		 case KISS_CMD_FullDuplex:{
-		 LOG_INFO("Kiss - setting duplex %d\n", k->buf[1]);
-		 kiss_duplex = k->buf[1];
-		 break;
-		 }
-		 */
+	case KISS_CMD_TXDELAY:
+	case KISS_CMD_P:
+	case KISS_CMD_SlotTime:
+	case KISS_CMD_TXtail:
+	case KISS_CMD_FullDuplex:
+		kiss_handle_rf_param_cmd(cmd, payload[0]);
+		break;
 
 	default:
 		// Unsupported command
@@ -229,53 +320,233 @@ static void kiss_handle_frame(uint8_t *frame, uint16_t size) {
 }
 
 /*
- * send to modem/rf
+ * Set a rf parameter, applied to the modem only: hosts send them with
+ * every connection, so they are saved on a KISS_HW_SAVE request.
+ */
+static void kiss_handle_rf_param_cmd(uint8_t cmd, uint8_t value){
+	RfParams *rf = &g_settings.rf;
+	switch(cmd){
+	case KISS_CMD_TXDELAY:
+		rf->txdelay = value;
+		break;
+	case KISS_CMD_P:
+		rf->persistence = value;
+		break;
+	case KISS_CMD_SlotTime:
+		rf->slot_time = value;
+		break;
+	case KISS_CMD_TXtail:
+		rf->txtail = value;
+		break;
+	case KISS_CMD_FullDuplex:
+		rf->duplex = value ? RF_DUPLEX_FULL : RF_DUPLEX_HALF;
+		break;
+	default:
+		return;
+	}
+	settings_apply_rf();
+}
+
+/*
+ * Save the settings, or reply the channel load of the port modem
+ */
+static void kiss_handle_hardware_cmd(uint8_t port, const uint8_t *data, uint16_t size){
+	if(size < 1){
+		return;
+	}
+	if(data[0] == KISS_HW_SAVE){
+		uint8_t reply = KISS_HW_SAVE;
+		settings_save();
+		kiss_send_to_serial(port, KISS_CMD_SetHardware, &reply, 1);
+		return;
+	}
+	if(data[0] == KISS_HW_ACKMODE){
+		if(size > 1){
+			kiss.ackMode = data[1] != 0;
+		}
+		uint8_t reply[2] = { KISS_HW_ACKMODE, kiss.ackMode };
+		kiss_send_to_serial(port, KISS_CMD_SetHardware, reply, sizeof(reply));
+		return;
+	}
+#if CONFIG_AFSK_CHANNEL_LOAD
+	if(data[0] != KISS_HW_LOAD){
+		return;
+	}
+	Afsk *af = AFSK_CAST(kiss.modem[port]->ch);
+	uint8_t reply[1 + AFSK_LOAD_KINDS * 3];
+	uint8_t *p = reply;
+	*p++ = KISS_HW_LOAD;
+	for(uint8_t kind = 0; kind < AFSK_LOAD_KINDS; kind++){
+		*p++ = afsk_channelLoad(af, kind, AFSK_LOAD_1S);
+		*p++ = afsk_channelLoad(af, kind, AFSK_LOAD_1MIN);
+		*p++ = afsk_channelLoad(af, kind, AFSK_LOAD_10MIN);
+	}
+	kiss_send_to_serial(port, KISS_CMD_SetHardware, reply, sizeof(reply));
+#endif
+}
+
+/*
+ * Receive and send on all the modems
+ */
+static void kiss_poll_modems(void){
+	for(uint8_t i = 0; i < TNC_PORTS; i++){
+		if(kiss.modem[i]){
+			ax25_poll(kiss.modem[i]);
+#if CONFIG_AX25_RX_QUEUE
+			ax25_rxDeliver(kiss.modem[i]);
+#endif
+		}
+	}
+}
+
+/*
+ * Wait for the channel of a modem to be clear, receiving meanwhile so
+ * that the receive buffers don't overrun
  */
-void kiss_send_to_modem(/*channel = 0*/uint8_t *buf, size_t len) {
-	bool sent = false;
-	Afsk *afsk = AFSK_CAST(kiss.modem->ch);
+static void kiss_wait_clear(AX25Ctx *modem){
+	while(!afsk_txClear(modem->ch)){
+		kiss_poll_modems();
+	}
+}
 
-	if (g_settings.rf.duplex == RF_DUPLEX_FULL) {
-		ax25_sendRaw(kiss.modem, buf, len);
+/*
+ * send to modem/rf
+ *
+ * The frame is queued to wait for the channel (see afsk_txClear()), so that
+ * the serial port, beacon and digipeater are still polled meanwhile.
+ * If there is no room in the queue, wait for the channel here.
+ */
+void kiss_send_to_modem(uint8_t port, uint8_t *buf, size_t len) {
+	AX25Ctx *modem = kiss.modem[port];
+#if CONFIG_AX25_TX_QUEUE
+	if(ax25_queueRaw(modem, buf, len, NULL, NULL)){
 		return;
 	}
+#endif
+	kiss_wait_clear(modem);
+	ax25_sendRaw(modem, buf, len);
+}
 
-	// Perform CSMA check under HALF_DUPLEX mode,
-	// FIXME - blocking send currently.
-	while (!sent) {
-		if (!/*ctx->dcd*/(afsk)->hdlc.rxstart) {
-			uint16_t i = rand();
-			uint8_t tp = ((i >> 8) ^ (i & 0xff));
-			if (tp < g_settings.rf.persistence) {
-				ax25_sendRaw(kiss.modem, buf, len);
-				sent = true;
-			} else {
-				//TEST ONLY -
-#if 0
-				kfile_printf_P(kiss.serial,PSTR("send backoff 100ms, because %d > persistence \n"),tp);
+/*
+ * ACKMODE frames are the ID (2 bytes) followed by the AX25 frame.
+ * They share the command with KISS_CMD_CONFIG_CALL, whose frames are the
+ * CallData and the checksum: the host picks which one with KISS_HW_ACKMODE.
+ * Shorter frames are discarded.
+ */
+#define KISS_ACK_ID_LEN 2
+
+static bool kiss_is_ackmode_frame(const uint8_t *frame, uint16_t size){
+	(void)frame;
+	return kiss.ackMode && size >= KISS_ACK_ID_LEN + AX25_MIN_FRAME_LEN - 2/*FCS*/;
+}
+
+/*
+ * Data and ACKMODE frames, for the modem of an existing port
+ */
+static bool kiss_is_modem_frame(const uint8_t *frame, uint16_t size){
+	uint8_t cmd = frame[0] & 0x0f;
+	uint8_t port = frame[0] >> 4 & 0x0f;
+	if(size < 2 || port >= TNC_PORTS || !kiss.modem[port]){
+		return false;
+	}
+	return cmd == KISS_CMD_DATA
+			|| (cmd == KISS_CMD_ACKMODE && kiss_is_ackmode_frame(frame + 1, size - 1));
+}
+
+/*
+ * Echo the ID of an ACKMODE frame once it has been sent
+ */
+static void kiss_ack_sent(struct AX25Ctx *modem, void *user){
+	uint16_t id = (uint16_t)(uintptr_t)user;
+	uint8_t buf[KISS_ACK_ID_LEN] = { id >> 8, id & 0xff };
+	uint8_t port = 0;
+	for(uint8_t i = 1; i < TNC_PORTS; i++){
+		if(kiss.modem[i] == modem){
+			port = i;
+		}
+	}
+	kiss_send_to_serial(port, KISS_CMD_ACKMODE, buf, sizeof(buf));
+}
+
+/*
+ * Send the frame of an ACKMODE command, its ID is echoed to the host
+ * after the closing flag of the frame has started on air.
+ */
+static void kiss_send_to_modem_ack(uint8_t port, uint8_t *buf, size_t len){
+	AX25Ctx *modem = kiss.modem[port];
+	void *user = (void *)(uintptr_t)((buf[0] << 8) | buf[1]);
+	buf += KISS_ACK_ID_LEN;
+	len -= KISS_ACK_ID_LEN;
+#if CONFIG_AX25_TX_QUEUE
+	if(ax25_queueRaw(modem, buf, len, kiss_ack_sent, user)){
+		return;
+	}
 #endif
-				timer_delay(g_settings.rf.slot_time * 10); // block waiting 100ms by default.
-			}
-		} else {
-			while (!sent && /*kiss_ax25->dcd*/(afsk)->hdlc.rxstart) {
-				// Continously poll the modem for data
-				// while waiting, so we don't overrun
-				// receive buffers
-				ax25_poll(kiss.modem);
-				if ((afsk)->status != 0) {
-					// If an overflow or other error
-					// occurs, we'll back off and drop
-					// this packet silently.
-					(afsk)->status = 0;
-					sent = true;
-				}
-			}
+	kiss_wait_clear(modem);
+	// returns once the frame is sent
+	ax25_sendRaw(modem, buf, len);
+	kiss_ack_sent(modem, user);
+}
+
+#if CONFIG_KISS_QUEUE
+/*
+ * Queue the frame just decoded, its buffer joins the queue.
+ */
+static void kiss_queue_frame(uint16_t len){
+	AX25Frame *f = kiss.rxFrame;
+	kiss.rxFrame = NULL;
+	f->len = len;
+	ADDTAIL(&kiss.txQueue, &f->link);
+}
+
+/*
+ * A queued frame has been sent, its buffer is back to the arena
+ */
+static void kiss_queued_sent(struct AX25Ctx *modem, void *user){
+	(void)modem;
+	(void)user;
+	kiss.frames--;
+}
+
+static void kiss_queued_ack_sent(struct AX25Ctx *modem, void *user){
+	kiss.frames--;
+	kiss_ack_sent(modem, user);
+}
+
+/*
+ * Hand a queued frame to its modem, if there is room for it in the queue
+ * of the modem. The buffer is queued as it is, past the command byte and
+ * the ACKMODE ID.
+ */
+static bool kiss_send_queued(AX25Frame *frame){
+	uint8_t cmd = frame->buf[0] & 0x0f;
+	AX25Ctx *modem = kiss.modem[frame->buf[0] >> 4 & 0x0f];
+	uint8_t ofs = 1;
+	ax25_sent_t sent = kiss_queued_sent;
+	void *user = NULL;
+	if(cmd == KISS_CMD_ACKMODE){
+		sent = kiss_queued_ack_sent;
+		user = (void *)(uintptr_t)((frame->buf[1] << 8) | frame->buf[2]);
+		ofs += KISS_ACK_ID_LEN;
+	}
+	return ax25_queueFrame(modem, frame, ofs, frame->len - ofs, sent, user);
+}
+
+static void kiss_poll_queue(void){
+	while(!LIST_EMPTY(&kiss.txQueue)){
+		AX25Frame *f = (AX25Frame *)LIST_HEAD(&kiss.txQueue);
+		if(!kiss_send_queued(f)){
+			break;
 		}
+		// the modem queue holds its own reference
+		REMOVE(&f->link);
+		ax25_frameRelease(f);
 	}
 }
+#endif
 
 #if 0
-void kiss_send_to_serial(uint8_t port, uint8_t cmd, uint8_t *buf, size_t len) {
+void kiss_send_to_serial(uint8_t port, uint8_t cmd, const uint8_t *buf, size_t len) {
 	size_t i;
 
 	kfile_putc(KISS_FEND, kiss.serial);
@@ -308,7 +579,7 @@ INLINE void _send_to_serial_begin(uint8_t port, uint8_t cmd){
 	ser_putchar(((port << 4) & 0xf0) | (cmd & 0x0f), serial);
 }
 
-static void _send_to_serial(uint8_t *buf, size_t len){
+static void _send_to_serial(const uint8_t *buf, size_t len){
 	Serial *serial = kiss.serialReader->ser;
 	size_t i;
 	for (i = 0; i < len; i++) {
@@ -330,7 +601,7 @@ INLINE void _send_to_serial_end(void){
 	//kfile_flush((KFile*)kiss.serialReader->ser);
 }
 
-void kiss_send_to_serial(uint8_t port, uint8_t cmd, uint8_t *buf, size_t len) {
+void kiss_send_to_serial(uint8_t port, uint8_t cmd, const uint8_t *buf, size_t len) {
 	_send_to_serial_begin(port,cmd);
 	_send_to_serial(buf,len);
 	_send_to_serial_end();
@@ -418,21 +689,24 @@ INLINE void kiss_handle_config_params_cmd(uint8_t *data, uint16_t len) {
 	}else if(len == sizeof(SettingsData)){
 		// set g_settings
 		settings_set_params_bytes(data,len);
+		settings_apply_rf();
 		settings_save();
 		KISS_SERIAL_RESPOND_OK();
 	}
 }
 
+STATIC_ASSERT(SETTINGS_BEACON_TEXT_MAX_LEN + 1 <= CONFIG_AX25_FRAME_BUF_LEN);
+
 INLINE void kiss_handle_config_text_cmd(uint8_t *data, uint16_t len) {
 	if(len == 0){
 		// read beacon text and write to serial
-		// NOTE: *TRICK* here: reuse the serial reader buffer, so assuming kiss.serialReader->readLen == 0
-		kiss.serialReader->readLen = 0; // force discard the received data in buffer as we'll use the buffer now.
-		uint8_t len = settings_get_beacon_text((char*)kiss.serialReader->buf,kiss.serialReader->bufLen);
+		// NOTE: reuse the buffer of the request, which is done with
+		uint8_t *buf = kiss.rx.buf;
+		uint8_t len = settings_get_beacon_text((char*)buf,SETTINGS_BEACON_TEXT_MAX_LEN + 1);
 		if(len > 0){
-			uint8_t crc = calc_crc(kiss.serialReader->buf,len);
+			uint8_t crc = calc_crc(buf,len);
 			_send_to_serial_begin(0,KISS_CMD_CONFIG_TEXT);
-			_send_to_serial(kiss.serialReader->buf,len);
+			_send_to_serial(buf,len);
 			_send_to_serial(&crc,1);
 			_send_to_serial_end();
 		}
@@ -5,7 +5,11 @@
 #include <string.h>
 #include <drv/timer.h>
 
+#include <struct/list.h>
+
 #include "cfg/cfg_kiss.h"
+#include "kiss_decoder.h"
+#include "global.h"
 
 struct Serial;
 struct SerialReader;
@@ -13,9 +17,17 @@ struct AX25Ctx;
 
 typedef struct KissCtx{
 	struct SerialReader *serialReader;
-	struct AX25Ctx *modem;
-
-	ticks_t  rxTick;
+	struct AX25Ctx *modem[TNC_PORTS];	// modem of each KISS port
+
+	KissDecoder rx;			// decoder of the serial input
+	struct AX25Frame *rxFrame;	// buffer the serial input is decoded in, NULL when idle or none is free
+	ticks_t  rxTick;		// last time serial input was received
+	uint16_t rxOverruns;	// serial input lost because the receive ring was full
+	uint16_t rxDrops;		// frames of the serial input dropped, some of their bytes lost
+	uint16_t rxKeep;		// bytes in the ring received before the last input lost
+	bool rxLost;			// drop the frame being decoded after rxKeep bytes
+	uint8_t frames;			// frame buffers held: decoding, queued and in the modem queues
+	bool ackMode;			// KISS_CMD_ACKMODE frames are ACKMODE, not CONFIG_CALL
 #if 0
 	struct Serial  *serial;
 	uint8_t *rxBuf;
@@ -23,19 +35,19 @@ typedef struct KissCtx{
 	uint16_t rxPos;
 #endif
 
-#if 0 // TX Buffering Enabled
-	uint8_t *txBuf;
-	uint16_t txBufLen;
-	uint16_t txPos;
-	ticks_t txTick;
+#if CONFIG_KISS_QUEUE
+	List txQueue;					// frames waiting for the modems
 #endif
 
 }KissCtx;
 
 void kiss_init(struct SerialReader *serialReader,struct AX25Ctx *modem);
+void kiss_add_port(struct AX25Ctx *modem);
 void kiss_poll(void);
-void kiss_send_to_modem(uint8_t *buf, size_t len);
-void kiss_send_to_serial(uint8_t port, uint8_t cmd, uint8_t *buf, size_t len);
+uint16_t kiss_rx_overruns(void);
+uint16_t kiss_rx_drops(void);
+void kiss_send_to_modem(uint8_t port, uint8_t *buf, size_t len);
+void kiss_send_to_serial(uint8_t port, uint8_t cmd, const uint8_t *buf, size_t len);
 
 #endif
 
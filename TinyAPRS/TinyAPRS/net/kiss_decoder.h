@@ -0,0 +1,96 @@
+/*
+ * \file kiss_decoder.h
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief KISS framing decoder, FEND/FESC unescaping of the serial input.
+ *
+ * Free of hardware dependencies, so that it can be benchmarked on the host.
+ */
+
+#ifndef KISS_DECODER_H_
+#define KISS_DECODER_H_
+
+#include <cfg/compiler.h>
+
+#define KISS_FEND  0xc0
+#define KISS_FESC  0xdb
+#define KISS_TFEND 0xdc
+#define KISS_TFESC 0xdd
+
+typedef struct KissDecoder{
+	uint8_t *buf;		// frame buffer
+	uint16_t bufLen;	// frame buffer length
+	uint16_t len;		// bytes of the frame being received
+	bool escaped;		// last byte was a FESC
+	bool drop;			// discard the frame being received, up to the next FEND
+}KissDecoder;
+
+/*
+ * Restart from an empty frame
+ */
+INLINE void kiss_decoder_reset(KissDecoder *d){
+	d->len = 0;
+	d->escaped = false;
+	d->drop = false;
+}
+
+INLINE void kiss_decoder_init(KissDecoder *d, uint8_t *buf, uint16_t bufLen){
+	d->buf = buf;
+	d->bufLen = bufLen;
+	kiss_decoder_reset(d);
+}
+
+/*
+ * Discard the frame being received, up to the next FEND, e.g. when bytes of it have been lost
+ */
+INLINE void kiss_decoder_drop(KissDecoder *d){
+	d->len = 0;
+	d->escaped = false;
+	d->drop = true;
+}
+
+/*
+ * Decode a byte of the serial input.
+ * returns:
+ *   n  when a frame of n bytes is complete in d->buf, valid until the next call
+ *   0  otherwise
+ */
+INLINE uint16_t kiss_decoder_put(KissDecoder *d, uint8_t c){
+	if(c == KISS_FEND){
+		uint16_t len = (d->escaped || d->drop) ? 0 : d->len;
+		d->len = 0;
+		d->escaped = false;
+		d->drop = false;
+		return len;
+	}
+
+	if(c == KISS_FESC){
+		d->escaped = true;
+		return 0;
+	}
+
+	if(d->escaped){
+		d->escaped = false;
+		if(c == KISS_TFEND){
+			c = KISS_FEND;
+		}else if(c == KISS_TFESC){
+			c = KISS_FESC;
+		}
+	}
+
+	if(d->len >= d->bufLen){
+		// frame too long
+		d->drop = true;
+		return 0;
+	}
+	d->buf[d->len++] = c;
+	return 0;
+}
+
+#endif /* KISS_DECODER_H_ */
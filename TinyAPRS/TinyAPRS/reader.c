@@ -20,30 +20,37 @@
 #include <drv/timer.h>
 #include "global.h"
 #include <drv/ser.h>
-#include <cfg/cfg_ax25.h>
+#include <net/ax25.h>
 
-#if MOD_KISS
-#define READER_BUF_LEN CONFIG_AX25_FRAME_BUF_LEN //shared buffer is 330 bytes for KISS module reading received AX25 frame.
-#else
-#define READER_BUF_LEN 128
-#endif
-static uint8_t read_buffer[READER_BUF_LEN];
+STATIC_ASSERT(READER_LINE_LEN <= CONFIG_AX25_FRAME_BUF_LEN && READER_LINE_LEN <= UINT8_MAX);
 
 void serialreader_init(SerialReader *reader, Serial *ser){
 	memset(reader, 0, sizeof(SerialReader));
 	reader->ser = ser;
-	reader->buf = read_buffer;
-	reader->bufLen = READER_BUF_LEN;
+}
+
+/*
+ * Give the line buffer back to the arena
+ */
+static void _release_buffer(SerialReader *reader){
+	if(reader->frame){
+		ax25_frameRelease(reader->frame);
+		reader->frame = NULL;
+	}
 }
 
 void serialreader_reset(SerialReader *reader){
 	reader->dataLen = 0;
 	reader->readLen = 0;
+	_release_buffer(reader);
 	kfile_clearerr((struct KFile*)reader->ser);
 }
 
 int serialreader_readline(SerialReader *reader){
-	uint8_t *readBuffer = reader->buf;
+	// the line returned by the last call is over
+	if(reader->readLen == 0){
+		_release_buffer(reader);
+	}
 
 #if CFG_READER_READ_TIMEOUT > 0
 	// discard the buffer if read timeout;
@@ -53,6 +60,14 @@ int serialreader_readline(SerialReader *reader){
 	}
 #endif
 
+	// borrow a buffer once there is some input, without one it waits in the ring
+	if(!reader->frame){
+		if(ser_fifo_isempty_locked(&reader->ser->rxfifo) || !(reader->frame = ax25_frameAlloc())){
+			return 0;
+		}
+	}
+	uint8_t *readBuffer = reader->frame->buf;
+
 	//Check the "cfg_ser.h" file for CONFIG_SER_RXTIMEOUT = 0
 	int c = ser_getchar(reader->ser);
 	if(c == EOF)  return 0;
@@ -60,7 +75,7 @@ int serialreader_readline(SerialReader *reader){
 	if(c != '\r' && c != '\n'){
 		readBuffer[reader->readLen++] = c;
 		// check if buffer is full
-		if(reader->readLen < reader->bufLen - 1){
+		if(reader->readLen < READER_LINE_LEN - 1){
 	#if CFG_READER_READ_TIMEOUT > 0
 			reader->lastReadTick = timer_clock();
 	#endif
@@ -71,7 +86,7 @@ int serialreader_readline(SerialReader *reader){
 	// if run here, we got \r \n or buffer is full
 	if(reader->readLen > 0){
 		readBuffer[reader->readLen] = 0; // complete the buffered string
-		reader->data = reader->buf;
+		reader->data = readBuffer;
 		reader->dataLen = reader->readLen;
 		reader->readLen = 0; // reset the counter!
 		return reader->dataLen;
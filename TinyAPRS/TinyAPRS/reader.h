@@ -24,12 +24,16 @@
 //Reader parameters
 #define CFG_READER_READ_TIMEOUT 0
 
+// Longest line read, the buffer is a frame of the AX25 arena
+#define READER_LINE_LEN 128
+
 typedef void (*ReaderCallback)(char* line, uint8_t len);
 
+struct AX25Frame;
+
 typedef struct SerialReader{
 	Serial *ser;
-	uint8_t* buf;
-	uint16_t bufLen; // The total buffer length;
+	struct AX25Frame *frame; // buffer of the line, borrowed from the AX25 arena while it is read
 	uint8_t readLen; // Counter for counting length of data from serial;
 	uint8_t* data;
 	uint16_t dataLen;
@@ -48,10 +52,10 @@ void serialreader_init(SerialReader *reader, Serial *ser);
 void serialreader_reset(SerialReader *reader);
 
 /*
- * read a line from the underlying serial
+ * read a line from the underlying serial, valid until the next call
  * returns:
  *   n  bytes
- *   0  no data
+ *   0  no data, or no free frame buffer to read it in
  *  -1  error
  */
 int serialreader_readline(SerialReader *reader);
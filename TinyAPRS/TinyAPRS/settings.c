@@ -17,8 +17,10 @@
 #include "settings.h"
 
 #include <cpu/irq.h>
+#include <net/afsk.h>
 #include <net/ax25.h>
 #include "utils.h"
+#include "global.h"
 
 #define DEFAULT_BEACON_INTERVAL 20 * 60 // 20 minutes of beacon send interval
 
@@ -61,9 +63,9 @@ SettingsData g_settings = {
 			//.comments="TinyAPRS Rocks!",
 		},
 		.rf = {
-			.txdelay = 50,
+			.txdelay = CONFIG_AFSK_PREAMBLE_LEN / 10,
 			.persistence = 63,
-			.txtail = 5,
+			.txtail = DIV_ROUND(CONFIG_AFSK_TRAILER_LEN, 10),
 			.slot_time = 10,
 			.duplex = RF_DUPLEX_HALF
 		},
@@ -91,6 +93,11 @@ uint8_t EEMEM nvCallData[sizeof(CallData)];
 uint8_t EEMEM nvBeaconTextHeadByte;
 uint8_t EEMEM nvBeaconText[SETTINGS_BEACON_TEXT_MAX_LEN];
 
+// twist of the equalizer, out of SettingsData to keep its layout
+#define NV_TWIST_HEAD_BYTE_VALUE 0xAA
+uint8_t EEMEM nvTwistHeadByte;
+int8_t EEMEM nvTwist[SETTINGS_TWIST_PORTS];
+
 /*
  * Copy the data into settings and save to eeprom
  */
@@ -147,6 +154,7 @@ void settings_clear(void){
 	eeprom_update_byte((void*)&nvSetHeadByte, 0xFF);
 	eeprom_update_byte((void*)&nvCallDataHeadByte, 0xFF);
 	eeprom_update_byte((void*)&nvBeaconTextHeadByte, 0xFF);
+	eeprom_update_byte((void*)&nvTwistHeadByte, 0xFF);
 	eeprom_update_byte((void*)&nvSetCrcByte, 0xFF);
 }
 
@@ -196,6 +204,45 @@ void settings_set_params(SettingsParamKey type, void* value, uint8_t valueLen){
 	}
 }
 
+static void settings_apply_rf_port(Afsk *af){
+	afsk_setTxDelay(af, g_settings.rf.txdelay * 10, g_settings.rf.txtail * 10);
+	afsk_setCsma(af, g_settings.rf.persistence, g_settings.rf.slot_time * 10, g_settings.rf.duplex == RF_DUPLEX_FULL);
+}
+
+/*
+ * The rf parameters are shared by all the ports
+ */
+void settings_apply_rf(void){
+	settings_apply_rf_port(&g_afsk);
+#if MOD_PORT2
+	settings_apply_rf_port(&g_afsk2);
+#endif
+}
+
+void settings_apply_twist(void){
+#if CONFIG_AFSK_EQ
+	int8_t twist[SETTINGS_TWIST_PORTS];
+	settings_get_twist(twist);
+	afsk_setTwist(&g_afsk, twist[0]);
+#if MOD_PORT2
+	afsk_setTwist(&g_afsk2, twist[1]);
+#endif
+#endif
+}
+
+void settings_get_twist(int8_t twist[SETTINGS_TWIST_PORTS]){
+	memset(twist,0,SETTINGS_TWIST_PORTS);
+	uint8_t head = eeprom_read_byte((void*)&nvTwistHeadByte);
+	if(head == NV_TWIST_HEAD_BYTE_VALUE){
+		eeprom_read_block((void*)twist,(void*)nvTwist,SETTINGS_TWIST_PORTS);
+	}
+}
+
+void settings_set_twist(const int8_t twist[SETTINGS_TWIST_PORTS]){
+	eeprom_update_block((void*)twist,(void*)nvTwist,SETTINGS_TWIST_PORTS);
+	eeprom_update_byte((void*)&nvTwistHeadByte,NV_TWIST_HEAD_BYTE_VALUE);
+}
+
 void settings_set_call_data(CallData *callData){
 	eeprom_update_block((void*)callData,(void*)nvCallData,sizeof(CallData));
 	eeprom_update_byte((void*)&nvCallDataHeadByte,NV_SETTINGS_HEAD_BYTE_VALUE);
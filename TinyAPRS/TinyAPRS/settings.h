@@ -28,6 +28,7 @@
 
 #define SETTINGS_SUPPORT_BEACON_TEXT 1
 #define SETTINGS_BEACON_TEXT_MAX_LEN 128
+#define SETTINGS_TWIST_PORTS 2
 
 typedef struct CallData{
 	AX25Call destCall;
@@ -63,11 +64,11 @@ typedef struct BeaconParams{
 }BeaconParams;
 
 typedef struct RfParams{
-	uint8_t txdelay;
-	uint8_t txtail;
-	uint8_t persistence;
-	uint8_t slot_time;
-	uint8_t duplex;
+	uint8_t txdelay;		// Preamble length, in 10ms units
+	uint8_t txtail;			// Trailer length, in 10ms units
+	uint8_t persistence;	// CSMA persistence, transmit with probability (p+1)/256
+	uint8_t slot_time;		// CSMA slot time, in 10ms units
+	uint8_t duplex;			// RF_DUPLEX_HALF or RF_DUPLEX_FULL
 }RfParams;
 
 typedef struct{
@@ -117,6 +118,26 @@ void settings_set_params(SettingsParamKey type, void* value, uint8_t valueLen);
  */
 bool settings_set_params_bytes(uint8_t *bytes, uint16_t size);
 
+/**
+ * Apply the rf parameters (TXDELAY, TXtail and CSMA) to the modem
+ */
+void settings_apply_rf(void);
+
+/**
+ * Start the twist equalizer of each port from its saved twist
+ */
+void settings_apply_twist(void);
+
+/*
+ * get the mark/space twist saved for each port, in dB, 0 if none
+ */
+void settings_get_twist(int8_t twist[SETTINGS_TWIST_PORTS]);
+
+/*
+ * save the mark/space twist of each port, in dB
+ */
+void settings_set_twist(const int8_t twist[SETTINGS_TWIST_PORTS]);
+
 /*
  * get the beacon text
  */
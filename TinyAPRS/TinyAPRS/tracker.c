@@ -177,7 +177,8 @@ static void tracker_update_location(struct GPS *gps){
 		shouldSend = _fixed_interval_beacon_check();
 	}
 
-	if(shouldSend){
+	// the next check sends it once the channel is less busy
+	if(shouldSend && !beacon_channel_busy()){
 		// prepare payload and send
 		char payload[64];
 		char s1 = g_settings.beacon.symbol[0];
@@ -200,7 +201,10 @@ static void tracker_update_location(struct GPS *gps){
 
 		len += snprintf_P((char*)payload + len, 63 - len, PSTR(" TinyAPRS Rocks!"));
 
-		beacon_send(payload,len);
+		if(!beacon_send(payload,len)){
+			// the queue is full, try again with the next location
+			return;
+		}
 #if CFG_BEACON_SMART // heading support
 		// save current position & time stamp
 		memcpy(&lastLocation,&location,sizeof(Location));
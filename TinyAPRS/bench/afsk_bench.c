@@ -0,0 +1,448 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Host benchmark of the AFSK1200 demodulator.
+ *
+ * Feeds the firmware demodulator with audio, either read from .au files
+ * (8 bit linear PCM, 9600Hz, mono) or synthesized by the firmware
+ * modulator with added noise and twist, then reports how many frames
+ * each demodulator slicer and the FX.25 decoder received, how many the
+ * additional slicers add to the main one and how many frames the CRC
+ * repair recovered. Synthesized frames are sent as FX.25 frames with
+ * \c check parity bytes if -x is given, and back to back through the
+ * AX25 transmit queue if -q is given. With -c, the frames are queued
+ * by the receiving station, waiting with p-persistent CSMA for the
+ * channel used by another station (no CSMA with a negative persistence).
+ *
+ * Usage: afsk_bench [-f frames] [-n noise] [-t twist_db] [-p preamble_ms] [-x check] [-q] [-c persistence] [file.au ...]
+ */
+
+#include "cfg/cfg_afsk.h"
+#include "cfg/cfg_ax25.h"
+
+#include <net/afsk.h>
+#include <net/ax25.h>
+#include <drv/timer.h>
+#include <cfg/debug.h>
+#include <cpu/byteorder.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static Afsk rx_afsk;
+static AX25Ctx rx_ax25;
+
+static Afsk tx_afsk;
+static AX25Ctx tx_ax25;
+
+static unsigned long samples;
+static uint16_t mark_inc;
+static unsigned long lock_sum;
+static unsigned long tx_samples;
+
+static void bench_hook(struct AX25Msg *msg)
+{
+	(void)msg;
+}
+
+/* Samples received by the ADC ISR between two main loop iterations */
+#define BENCH_POLL_SAMPLES 32
+
+/* Samples are given on the 8 bit scale, the ADC input may have more bits */
+#define BENCH_ADC_SCALE (1L << (AFSK_SAMPLE_BITS - 8))
+
+/*
+ * Feed a sample to the ADC ISR, then let the main loop poll the
+ * frames every few samples. The timer ISR is simulated to keep the
+ * clock going at the sample rate.
+ */
+static void bench_sample(double s)
+{
+	afsk_adc_isr(&rx_afsk, (afsk_sample_t)MINMAX(-128 * BENCH_ADC_SCALE, lrint(s * BENCH_ADC_SCALE), 128 * BENCH_ADC_SCALE - 1));
+	if (samples % BENCH_POLL_SAMPLES == 0)
+	{
+		ax25_poll(&rx_ax25);
+#if CONFIG_AX25_RX_QUEUE
+		while (ax25_rxDeliver(&rx_ax25))
+			;
+#endif
+	}
+
+	if (++samples % (SAMPLERATE / TIMER_TICKS_PER_SEC) == 0)
+		_clock++;
+}
+
+static void bench_reset(void)
+{
+	afsk_init(&rx_afsk, 0, 0);
+	ax25_init(&rx_ax25, &rx_afsk.fd, bench_hook);
+#if CONFIG_AX25_CRC_FIX
+	rx_ax25.weak_bits = afsk_weakBits;
+#endif
+	for (int i = 0; i < CONFIG_AFSK_SLICERS - 1; i++)
+		ax25_addRxChannel(&rx_ax25, afsk_slicerChannel(&rx_afsk, i));
+	ax25_addRxChannel(&rx_ax25, afsk_fx25Channel(&rx_afsk));
+	samples = 0;
+}
+
+static void bench_report(const char *name)
+{
+	ax25_poll(&rx_ax25);
+#if CONFIG_AX25_RX_QUEUE
+	while (ax25_rxDeliver(&rx_ax25))
+		;
+#endif
+	printf("%s: %lu samples, %lu frames, %lu dups, %lu crc errors, %u samples lost\n", name, samples,
+		(unsigned long)rx_ax25.stat.rx_ok, (unsigned long)rx_ax25.stat.rx_dup,
+		(unsigned long)rx_ax25.stat.rx_err, rx_afsk.sample_overrun);
+	for (int i = 0; i < CONFIG_AFSK_SLICERS; i++)
+		printf("  slicer %d: %lu frames\n", i, (unsigned long)rx_ax25.stat.rx_chan[i]);
+	printf("  fx25: %lu frames, %u codewords, %u bytes corrected, %u not corrected\n",
+		(unsigned long)rx_ax25.stat.rx_chan[CONFIG_AFSK_SLICERS], rx_afsk.fx25.rx_blocks,
+		rx_afsk.fx25.rx_fixed, rx_afsk.fx25.rx_bad);
+	printf("  slicers and fx25 add %ld frames to slicer 0\n",
+		(long)rx_ax25.stat.rx_ok - (long)rx_ax25.stat.rx_chan[0]);
+#if CONFIG_AX25_CRC_FIX
+	printf("  crc repaired: %lu frames\n", (unsigned long)rx_ax25.stat.rx_fixed);
+#endif
+#if CONFIG_AFSK_EQ
+	printf("  equalizer twist: %+d dB\n", afsk_twist(&rx_afsk));
+#endif
+#if CONFIG_AX25_RX_QUEUE
+	printf("  receive queue: %u high-water, %lu dropped, %lu without a buffer\n", rx_ax25.stat.rx_qmax,
+		(unsigned long)rx_ax25.stat.rx_qdrop, (unsigned long)rx_ax25.stat.rx_nobuf);
+#endif
+}
+
+static uint32_t au_read32(FILE *fp)
+{
+	uint32_t val = 0;
+	if (fread(&val, 1, sizeof(val), fp) != sizeof(val))
+		return 0;
+	return be32_to_cpu(val);
+}
+
+static int bench_file(const char *name)
+{
+	FILE *fp = fopen(name, "rb");
+	if (!fp)
+	{
+		perror(name);
+		return -1;
+	}
+
+	char snd[4];
+	if (fread(snd, 1, 4, fp) != 4 || memcmp(snd, ".snd", 4) != 0)
+	{
+		fprintf(stderr, "%s: not an .au file\n", name);
+		fclose(fp);
+		return -1;
+	}
+
+	uint32_t offset = au_read32(fp);
+	au_read32(fp); // data size
+	uint32_t encoding = au_read32(fp);
+	uint32_t sample_rate = au_read32(fp);
+	uint32_t channels = au_read32(fp);
+
+	if (encoding != 2 || sample_rate != SAMPLERATE || channels != 1)
+	{
+		fprintf(stderr, "%s: only 8 bit linear PCM, %d Hz, mono is supported\n", name, SAMPLERATE);
+		fclose(fp);
+		return -1;
+	}
+	fseek(fp, offset, SEEK_SET);
+
+	bench_reset();
+	int c;
+	while ((c = fgetc(fp)) != EOF)
+		bench_sample((int8_t)c);
+	fclose(fp);
+
+	bench_report(name);
+	return 0;
+}
+
+/* Rms of the modulated signal, the DAC sine scaled by 1/2 */
+#define BENCH_SIGNAL_RMS (127.0 / 2 / M_SQRT2)
+
+/* Gaussian noise, Box-Muller */
+static double bench_noise(void)
+{
+	double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static const AX25Call bench_path[] = AX25_PATH(AX25_CALL("APZTA", 0), AX25_CALL("BENCH", 1), AX25_CALL("WIDE1", 1));
+
+static int bench_info(char *info, size_t size, int seq)
+{
+	return snprintf(info, size, "!3011.54N/12007.35E>TinyAPRS bench frame #%d", seq);
+}
+
+/*
+ * Feed the demodulator with a sample of the firmware modulator, adding
+ * white noise of \a noise rms and scaling the space tone by \a space_gain
+ * (twist, as after the deemphasis of a radio).
+ */
+static void bench_txSample(double noise, double space_gain)
+{
+	double s = ((int)afsk_dac_isr(&tx_afsk) - 128) / 2.0;
+	if (tx_afsk.phase_inc != mark_inc)
+		s *= space_gain;
+	bench_sample(s + noise * bench_noise());
+}
+
+/*
+ * Some silence between the transmissions, with a random length
+ * so that every frame starts at a different bit phase.
+ */
+static void bench_gap(double noise)
+{
+	int gap = SAMPLERATE / 10 + rand() % SAMPLEPERBIT;
+	for (int i = 0; i < gap; i++)
+		bench_sample(noise * bench_noise());
+}
+
+/*
+ * Modulate a frame with the firmware modulator and feed the demodulator with it.
+ */
+static void bench_frame(int seq, double noise, double twist_db)
+{
+	char info[64];
+	int len = bench_info(info, sizeof(info), seq);
+	double space_gain = pow(10, -twist_db / 20);
+
+	ax25_sendVia(&tx_ax25, bench_path, countof(bench_path), info, len);
+
+	for (; tx_afsk.sending; tx_samples++)
+		bench_txSample(noise, space_gain);
+	lock_sum += afsk_pllLock(&rx_afsk.pll);
+
+	bench_gap(noise);
+}
+
+static unsigned long sent_frames;
+
+static void bench_sent(struct AX25Ctx *ctx, void *user)
+{
+	(void)ctx;
+	(void)user;
+	sent_frames++;
+}
+
+/*
+ * Send \a frames frames through the transmit queue, topping it up from
+ * the main loop: they should go out back to back, keying the modulator once.
+ */
+static void bench_queue(int frames, double noise, double twist_db)
+{
+	unsigned long keyups = 0, main_loops = 0;
+	double space_gain = pow(10, -twist_db / 20);
+	bool sending = false;
+	int seq = 0;
+
+	do
+	{
+		char info[64];
+		while (seq < frames && ax25_txPending(&tx_ax25) < CONFIG_AX25_TX_QUEUE)
+		{
+			int len = bench_info(info, sizeof(info), seq);
+			if (!ax25_queueVia(&tx_ax25, bench_path, countof(bench_path), info, len, bench_sent, NULL))
+				break;
+			seq++;
+		}
+
+		for (int i = 0; i < BENCH_POLL_SAMPLES && tx_afsk.sending; i++, tx_samples++)
+			bench_txSample(noise, space_gain);
+
+		if (tx_afsk.sending && !sending)
+			keyups++;
+		sending = tx_afsk.sending;
+
+		ax25_poll(&tx_ax25);
+		main_loops++;
+	} while (seq < frames || ax25_txPending(&tx_ax25) || tx_afsk.sending);
+
+	bench_gap(noise);
+	printf("queue: %d frames, %lu sent callbacks, %lu keyups, %.2fs on air, %lu main loop iterations\n",
+		frames, sent_frames, keyups, (double)tx_samples / CONFIG_AFSK_DAC_SAMPLERATE, main_loops);
+}
+
+/*
+ * Channel access: both the bench station (the receiving modem) and
+ * another station (the transmitting modem) send a frame 0 to 2 seconds
+ * after their previous one, the other station without waiting for the
+ * channel. The bench station queues its frames, to wait for the channel
+ * with p-persistent CSMA, or not at all if \a persistence is negative.
+ */
+static void bench_csma(int frames, double noise, int persistence)
+{
+	unsigned long dcd_on = 0, dcd_off = 0, on = 0, off = 0;
+	unsigned long keyups = 0, busy_keyups = 0, wait = 0, queued = 0;
+	unsigned long gap = 0, bench_gap = 0;
+	bool sending = false;
+	int seq = 0, other = 0;
+
+	rx_ax25.tx_room = afsk_txRoom;
+	rx_ax25.tx_frames = afsk_txFrames;
+	rx_ax25.tx_clear = afsk_txClear;
+	afsk_setCsma(&rx_afsk, (persistence < 0) ? 0 : persistence, 100, persistence < 0);
+
+	while ((int)sent_frames < frames)
+	{
+		char info[64];
+		if (!ax25_txPending(&rx_ax25) && !rx_afsk.sending && !bench_gap--)
+		{
+			int len = bench_info(info, sizeof(info), seq++);
+			ax25_queueVia(&rx_ax25, bench_path, countof(bench_path), info, len, bench_sent, NULL);
+			queued = samples;
+			bench_gap = rand() % (2 * SAMPLERATE);
+		}
+
+		if (!tx_afsk.sending && !gap--)
+		{
+			int len = bench_info(info, sizeof(info), other++);
+			ax25_sendVia(&tx_ax25, bench_path, countof(bench_path), info, len);
+			gap = rand() % (2 * SAMPLERATE);
+		}
+
+		/* The bench station receiver is not muted while it transmits */
+		double s = noise * bench_noise();
+		if (tx_afsk.sending)
+		{
+			s += ((int)afsk_dac_isr(&tx_afsk) - 128) / 2.0;
+			dcd_on += afsk_dcd(&rx_afsk);
+			on++;
+		}
+		else
+		{
+			dcd_off += afsk_dcd(&rx_afsk);
+			off++;
+		}
+		if (rx_afsk.sending)
+			afsk_dac_isr(&rx_afsk);
+		bench_sample(s);
+
+		if (rx_afsk.sending && !sending)
+		{
+			keyups++;
+			busy_keyups += tx_afsk.sending;
+			wait += samples - queued;
+		}
+		sending = rx_afsk.sending;
+	}
+
+	printf("csma persistence %d: %lu frames in %lu keyups, %lu on a busy channel, %.0fms average wait, %u deferred slots\n",
+		persistence, sent_frames, keyups, busy_keyups, 1000.0 * wait / SAMPLERATE / MAX(keyups, 1UL), rx_afsk.csma.defers);
+	printf("  dcd on %.1f%% of the other station transmissions, %.1f%% of the rest\n",
+		100.0 * dcd_on / MAX(on, 1UL), 100.0 * dcd_off / MAX(off, 1UL));
+#if CONFIG_AFSK_CHANNEL_LOAD
+	printf("  channel busy %.1f%%, load 1s/1m/10m: energy %u/%u/%u%%, sync %u/%u/%u%%\n",
+		100.0 * on / MAX(on + off, 1UL),
+		afsk_channelLoad(&rx_afsk, AFSK_LOAD_ENERGY, AFSK_LOAD_1S),
+		afsk_channelLoad(&rx_afsk, AFSK_LOAD_ENERGY, AFSK_LOAD_1MIN),
+		afsk_channelLoad(&rx_afsk, AFSK_LOAD_ENERGY, AFSK_LOAD_10MIN),
+		afsk_channelLoad(&rx_afsk, AFSK_LOAD_SYNC, AFSK_LOAD_1S),
+		afsk_channelLoad(&rx_afsk, AFSK_LOAD_SYNC, AFSK_LOAD_1MIN),
+		afsk_channelLoad(&rx_afsk, AFSK_LOAD_SYNC, AFSK_LOAD_10MIN));
+#endif
+	printf("  other station: %d frames, %lu received\n", other, (unsigned long)rx_ax25.stat.rx_ok);
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 100;
+	double noise = 0, twist_db = 0;
+	int preamble_ms = CONFIG_AFSK_PREAMBLE_LEN;
+	int fx25_check = 0;
+	bool queue = false;
+	bool csma = false;
+	int persistence = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:n:t:p:x:qc:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f':
+			frames = atoi(optarg);
+			break;
+		case 'n':
+			noise = atof(optarg);
+			break;
+		case 't':
+			twist_db = atof(optarg);
+			break;
+		case 'p':
+			preamble_ms = atoi(optarg);
+			break;
+		case 'x':
+			fx25_check = atoi(optarg);
+			break;
+		case 'q':
+			queue = true;
+			break;
+		case 'c':
+			csma = true;
+			persistence = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-f frames] [-n noise] [-t twist_db] [-p preamble_ms] [-x check] [-q] [-c persistence] [file.au ...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind < argc)
+	{
+		for (int i = optind; i < argc; i++)
+			if (bench_file(argv[i]) < 0)
+				return 1;
+		return 0;
+	}
+
+	bench_reset();
+	afsk_init(&tx_afsk, 0, 0);
+	ax25_init(&tx_ax25, &tx_afsk.fd, bench_hook);
+	tx_ax25.tx_room = afsk_txRoom;
+	tx_ax25.tx_frames = afsk_txFrames;
+	afsk_setTxDelay(&tx_afsk, preamble_ms, CONFIG_AFSK_TRAILER_LEN);
+	mark_inc = tx_afsk.phase_inc;
+	tx_afsk.fx25.tx_check = fx25_check;
+
+	srand(1);
+	if (csma)
+	{
+		bench_csma(frames, noise, persistence);
+		return 0;
+	}
+	if (queue)
+		bench_queue(frames, noise, twist_db);
+	else
+		for (int i = 0; i < frames; i++)
+			bench_frame(i, noise, twist_db);
+
+	char name[100];
+	snprintf(name, sizeof(name), "synth noise %.1f twist %.1fdB preamble %dms fx25 %d", noise, twist_db,
+		preamble_ms, fx25_check);
+	bench_report(name);
+	printf("  lost: %d/%d\n", frames - (int)rx_ax25.stat.rx_ok, frames);
+	printf("  on air: %.2fs, %.0fms per frame\n", (double)tx_samples / CONFIG_AFSK_DAC_SAMPLERATE,
+		1000.0 * tx_samples / CONFIG_AFSK_DAC_SAMPLERATE / MAX(frames, 1));
+	if (noise > 0)
+		printf("  snr: %.1f dB, packet error rate: %.3f\n", 20 * log10(BENCH_SIGNAL_RMS / noise),
+			(double)(frames - (int)rx_ax25.stat.rx_ok) / MAX(frames, 1));
+	printf("  slicer 0 clock lock at frame end: %lu/255\n", lock_sum / MAX(frames, 1));
+	return 0;
+}
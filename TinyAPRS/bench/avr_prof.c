@@ -0,0 +1,383 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Cycle count profile of the firmware under simavr.
+ *
+ * Runs the firmware ELF in the simavr AVR simulator, feeding the ADC
+ * with a recording (any file bench_audio reads, resampled to 9600Hz per
+ * port) and capturing the serial output, then reports:
+ * \li the cycles of each interrupt handler: min, average, max, from the
+ *     jump to the vector to the end of its RETI plus the 4 cycles of the
+ *     interrupt response, and the share of the CPU they take;
+ * \li for the ADC handler, the max against its budget, the cycles
+ *     between two samples (1666 at 16MHz, half with two ports);
+ * \li the main loop iteration time, between two calls of the function
+ *     at \c loop_addr (e.g. ax25_poll(), -k 2 if it is called twice per
+ *     iteration);
+ * \li the windows with the interrupts disabled out of the handlers,
+ *     which delay the ADC interrupt as much as they last.
+ *
+ * The interrupts are tracked from the program counter, one instruction
+ * at a time: a handler starts when the CPU jumps to a vector slot and
+ * ends with the matching RETI.
+ *
+ * The conversions are started by Timer1, as on the board. Simulators
+ * without the Timer1 capture auto trigger of the ADC need -T, starting
+ * them at the sample rate from the profiler instead.
+ *
+ * See bench/avr_prof.sh to profile the firmware build profiles.
+ *
+ * Usage: avr_prof [-m mcu] [-f cpu_freq] [-p ports] [-l loop_addr] [-k calls] [-s seconds] [-g gain_db] [-T] [-u uart_out] firmware.elf audio_file
+ */
+
+#include "bench_audio.h"
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_core.h>
+#include <sim_cycle_timers.h>
+#include <avr_adc.h>
+#include <avr_uart.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Modem sample rate, per port */
+#define PROF_SAMPLERATE 9600
+/* Cycles of the interrupt response, before the jump to the vector */
+#define PROF_INT_RESPONSE 4
+/* Opcode of RETI */
+#define PROF_RETI 0x9518
+/* Data address of ADCSRA and its start conversion bit, the same on the ATmega328P and 644P */
+#define PROF_ADCSRA 0x7a
+#define PROF_ADSC   6
+/* Nested interrupts tracked */
+#define PROF_DEPTH 8
+#define PROF_VECTORS 64
+
+typedef struct ProfStat
+{
+	unsigned long count;
+	uint64_t sum;
+	uint32_t min, max;
+} ProfStat;
+
+static void prof_add(ProfStat *st, uint32_t cycles)
+{
+	if (!st->count || cycles < st->min)
+		st->min = cycles;
+	if (cycles > st->max)
+		st->max = cycles;
+	st->sum += cycles;
+	st->count++;
+}
+
+static const char * const vectors_328p[] =
+{
+	"RESET", "INT0", "INT1", "PCINT0", "PCINT1", "PCINT2", "WDT",
+	"TIMER2_COMPA", "TIMER2_COMPB", "TIMER2_OVF", "TIMER1_CAPT", "TIMER1_COMPA",
+	"TIMER1_COMPB", "TIMER1_OVF", "TIMER0_COMPA", "TIMER0_COMPB", "TIMER0_OVF",
+	"SPI_STC", "USART_RX", "USART_UDRE", "USART_TX", "ADC", "EE_READY",
+	"ANALOG_COMP", "TWI", "SPM_READY",
+};
+
+static const char * const vectors_644p[] =
+{
+	"RESET", "INT0", "INT1", "INT2", "PCINT0", "PCINT1", "PCINT2", "PCINT3",
+	"WDT", "TIMER2_COMPA", "TIMER2_COMPB", "TIMER2_OVF", "TIMER1_CAPT",
+	"TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF", "TIMER0_COMPA", "TIMER0_COMPB",
+	"TIMER0_OVF", "SPI_STC", "USART0_RX", "USART0_UDRE", "USART0_TX",
+	"ANALOG_COMP", "ADC", "EE_READY", "TWI", "SPM_READY", "USART1_RX",
+	"USART1_UDRE", "USART1_TX",
+};
+
+static const char * const *vector_names;
+static int vector_cnt;
+static int adc_vector = -1;
+
+static ProfStat isr_stat[PROF_VECTORS];
+static ProfStat loop_stat;
+static ProfStat cli_stat;
+
+/* Audio at the ADC input, in millivolts, and the next sample */
+static uint16_t *audio;
+static size_t audio_len, audio_size, audio_pos;
+static double gain = 1;
+
+static void prof_audio(double s, void *user)
+{
+	(void)user;
+	if (audio_len == audio_size)
+	{
+		audio_size = audio_size ? 2 * audio_size : 65536;
+		audio = realloc(audio, audio_size * sizeof(*audio));
+	}
+	/* AVCC reference, centered at half scale */
+	audio[audio_len++] = (uint16_t)lrint(2500 + 2500 * fmax(-1, fmin(s * gain, 0.999)));
+}
+
+static avr_irq_t *adc_irq;
+static unsigned long conversions;
+
+/*
+ * A conversion starts: put the next sample on ADC0, the other
+ * ports see silence.
+ */
+static void prof_adcTrigger(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	union { avr_adc_mux_t mux; uint32_t v; } e = { .v = value };
+	(void)irq;
+	(void)param;
+
+	conversions++;
+	if (e.mux.src == 0 && audio_pos < audio_len)
+		avr_raise_irq(adc_irq, audio[audio_pos++]);
+}
+
+static avr_cycle_count_t adc_period;
+
+/* Start a conversion, as Timer1 does on the board */
+static avr_cycle_count_t prof_adcStart(struct avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	(void)param;
+	avr_core_watch_write(avr, PROF_ADCSRA, avr->data[PROF_ADCSRA] | (1 << PROF_ADSC));
+	return when + adc_period;
+}
+
+static FILE *uart_out;
+static unsigned long uart_bytes;
+
+static void prof_uart(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	(void)irq;
+	(void)param;
+	uart_bytes++;
+	if (uart_out)
+		fputc(value, uart_out);
+}
+
+static void prof_report(const char *name, const ProfStat *st, double freq)
+{
+	printf("  %-14s %8lu, min %5u, avg %7.1f, max %5u cycles, max %7.1fus\n", name, st->count, st->min,
+		(double)st->sum / (st->count ? st->count : 1), st->max, st->max * 1e6 / freq);
+}
+
+static void prof_usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-m mcu] [-f cpu_freq] [-p ports] [-l loop_addr] [-k calls] [-s seconds] [-g gain_db] [-T] [-u uart_out] firmware.elf audio_file\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *mcu = NULL, *uart_name = NULL;
+	uint32_t freq = 16000000, loop_addr = 0;
+	int ports = 1, loop_calls = 1;
+	double seconds = 0;
+	bool trigger = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:f:p:l:k:s:g:Tu:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm':
+			mcu = optarg;
+			break;
+		case 'f':
+			freq = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			ports = atoi(optarg);
+			break;
+		case 'l':
+			loop_addr = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			loop_calls = atoi(optarg);
+			break;
+		case 's':
+			seconds = atof(optarg);
+			break;
+		case 'g':
+			gain = pow(10, atof(optarg) / 20);
+			break;
+		case 'T':
+			trigger = true;
+			break;
+		case 'u':
+			uart_name = optarg;
+			break;
+		default:
+			prof_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (argc - optind != 2 || ports < 1 || ports > 2 || loop_calls < 1 || freq == 0)
+	{
+		prof_usage(argv[0]);
+		return 1;
+	}
+
+	elf_firmware_t fw;
+	memset(&fw, 0, sizeof(fw));
+	if (elf_read_firmware(argv[optind], &fw))
+	{
+		fprintf(stderr, "%s: can't read the firmware\n", argv[optind]);
+		return 1;
+	}
+	/* BertOS images have no .mmcu section */
+	if (!mcu)
+		mcu = fw.mmcu[0] ? fw.mmcu : "atmega328p";
+
+	BenchAudio au;
+	if (bench_audioOpen(&au, argv[optind + 1]) < 0)
+		return 1;
+	bench_audioConvert(&au, PROF_SAMPLERATE, prof_audio, NULL);
+	bench_audioClose(&au);
+	if (seconds == 0)
+		seconds = (double)audio_len / PROF_SAMPLERATE + 1;
+
+	if (uart_name && !(uart_out = fopen(uart_name, "wb")))
+	{
+		perror(uart_name);
+		return 1;
+	}
+
+	avr_t *avr = avr_make_mcu_by_name(mcu);
+	if (!avr)
+	{
+		fprintf(stderr, "%s: unknown mcu %s\n", argv[0], mcu);
+		return 1;
+	}
+	avr_init(avr);
+	avr_load_firmware(avr, &fw);
+	avr->frequency = freq;
+	avr->vcc = avr->avcc = avr->aref = 5000;
+
+	if (!strcmp(mcu, "atmega644p") || !strcmp(mcu, "atmega644pa"))
+	{
+		vector_names = vectors_644p;
+		vector_cnt = sizeof(vectors_644p) / sizeof(*vectors_644p);
+		adc_vector = 24;
+	}
+	else
+	{
+		vector_names = vectors_328p;
+		vector_cnt = sizeof(vectors_328p) / sizeof(*vectors_328p);
+		adc_vector = 21;
+	}
+
+	adc_irq = avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_OUT_TRIGGER),
+		prof_adcTrigger, NULL);
+	avr_raise_irq(adc_irq, 2500);
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC1), 2500);
+
+	uint32_t flags = 0;
+	avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+	flags &= ~AVR_UART_FLAG_STDIO;
+	avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), prof_uart, NULL);
+
+	adc_period = freq / (PROF_SAMPLERATE * ports);
+	if (trigger)
+		avr_cycle_timer_register(avr, adc_period, prof_adcStart, NULL);
+
+	/* Handlers running, innermost last */
+	int stack[PROF_DEPTH], depth = 0;
+	avr_cycle_count_t start[PROF_DEPTH];
+	avr_cycle_count_t end = (avr_cycle_count_t)(seconds * freq);
+	avr_cycle_count_t loop_start = 0, cli_start = 0;
+	bool sei_seen = false, cli = false;
+	int loop_hits = 0;
+	int state = cpu_Running;
+
+	while (avr->cycle < end && state != cpu_Done && state != cpu_Crashed)
+	{
+		uint16_t op = avr->flash[avr->pc] | (avr->flash[avr->pc + 1] << 8);
+		bool reti = op == PROF_RETI && depth > 0;
+
+		state = avr_run(avr);
+
+		if (reti)
+		{
+			depth--;
+			if (stack[depth] >= 0)
+				prof_add(&isr_stat[stack[depth]], avr->cycle - start[depth] + PROF_INT_RESPONSE);
+		}
+
+		/* A jump to a vector slot, the interrupt was taken */
+		if (avr->pc && avr->pc % avr->vector_size == 0 && avr->pc / avr->vector_size < (unsigned)vector_cnt)
+		{
+			if (depth < PROF_DEPTH)
+			{
+				stack[depth] = avr->pc / avr->vector_size;
+				start[depth] = avr->cycle;
+			}
+			depth++;
+		}
+
+		if (depth)
+			continue;
+
+		/* Interrupts disabled by the main loop, once they have been enabled */
+		bool i_flag = avr->sreg[S_I];
+		sei_seen |= i_flag;
+		if (sei_seen && !i_flag && !cli)
+			cli_start = avr->cycle;
+		else if (i_flag && cli)
+			prof_add(&cli_stat, avr->cycle - cli_start);
+		cli = sei_seen && !i_flag;
+
+		if (loop_addr && avr->pc == loop_addr && ++loop_hits % loop_calls == 0)
+		{
+			if (loop_start)
+				prof_add(&loop_stat, avr->cycle - loop_start);
+			loop_start = avr->cycle;
+		}
+	}
+
+	double elapsed = (double)avr->cycle / freq;
+	printf("%s on %s at %u Hz: %.2fs simulated, %lu conversions, %zu/%zu samples fed, %lu bytes of serial output\n",
+		argv[optind], mcu, freq, elapsed, conversions, audio_pos, audio_len, uart_bytes);
+	if (state == cpu_Crashed)
+		printf("  the firmware crashed at pc 0x%05x\n", (unsigned)avr->pc);
+	if (conversions == 0)
+		printf("  no ADC conversion: try -T if the simulator lacks the Timer1 auto trigger\n");
+
+	printf("interrupt handlers:\n");
+	for (int v = 1; v < vector_cnt; v++)
+	{
+		const ProfStat *st = &isr_stat[v];
+		if (!st->count)
+			continue;
+		prof_report(vector_names[v], st, freq);
+		printf("  %-14s %.1f%% of the CPU\n", "", 100.0 * st->sum / avr->cycle);
+	}
+	if (isr_stat[adc_vector].count)
+		printf("  ADC budget: %lu cycles per sample, max %.1f%%, average %.1f%%\n", (unsigned long)adc_period,
+			100.0 * isr_stat[adc_vector].max / adc_period,
+			100.0 * isr_stat[adc_vector].sum / isr_stat[adc_vector].count / adc_period);
+
+	if (loop_addr)
+	{
+		printf("main loop:\n");
+		prof_report("iterations", &loop_stat, freq);
+	}
+	printf("interrupts disabled out of the handlers:\n");
+	prof_report("windows", &cli_stat, freq);
+
+	if (uart_out)
+		fclose(uart_out);
+	avr_terminate(avr);
+	return 0;
+}
@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# Cycle count profile of each firmware build profile under simavr:
+# interrupt handlers against the ADC budget, main loop iteration time
+# and interrupts disabled windows, while decoding a recording.
+# Needs simavr (with its headers) and the AVR toolchain, no hardware.
+#
+# The firmware is rebuilt for each profile ("make clean" first), extra
+# build options go in MAKEFLAGS_EXTRA (e.g. "SLICERS=3", or "PORT2=1" then
+# -p 2 and -k 2 in PROF_FLAGS), the profiler options in PROF_FLAGS (e.g. -T).
+#
+# Usage: bench/avr_prof.sh audio_file [profile...]
+#
+
+AUDIO=$1
+[ -n "$AUDIO" ] || { echo "Usage: $0 audio_file [profile...]" >&2; exit 1; }
+shift
+PROFILES=${*:-TNC TRACKER DIGI ALL}
+NM=${NM:-avr-nm}
+
+WORK=$(mktemp -d)
+trap 'rm -rf $WORK' EXIT
+
+make BENCH=1 SIMAVR=1 >/dev/null || exit 1
+cp images/avr_prof $WORK/ || exit 1
+
+for PROFILE in $PROFILES; do
+	make clean >/dev/null
+	make $PROFILE=1 $MAKEFLAGS_EXTRA >/dev/null || exit 1
+	cp images/TinyAPRS.elf $WORK/$PROFILE.elf
+
+	# the main loop polls the modem first thing in each iteration
+	LOOP=$($NM $WORK/$PROFILE.elf | awk '$3 == "ax25_poll" { print "0x" $1 }')
+	# the larger MCU of TinyAPRS_user.mk for the options that need it
+	case "$MAKEFLAGS_EXTRA" in
+	*PORT2=1*|*FX25=1*|*SLICERS=*) MCU=atmega644p ;;
+	*) MCU=atmega328p ;;
+	esac
+
+	echo "== $PROFILE $MAKEFLAGS_EXTRA"
+	$WORK/avr_prof -m $MCU -l $LOOP $PROF_FLAGS $WORK/$PROFILE.elf "$AUDIO" || exit 1
+done
+make clean >/dev/null
@@ -0,0 +1,209 @@
+#
+# Host benchmarks of the TinyAPRS modem stack.
+# Build with "make BENCH=1", binaries are put in images/.
+# Extra defines go in BENCH_CPPFLAGS (run "make BENCH=1 clean" first).
+#
+
+TRG += afsk_bench
+
+afsk_bench_HOSTED = 1
+
+afsk_bench_SRC_PATH = bench
+
+# afsk_bench: decode AFSK1200 audio through the firmware demodulator.
+afsk_bench_CSRC = \
+	$(afsk_bench_SRC_PATH)/afsk_bench.c \
+	bertos/algo/crc_ccitt.c \
+	bertos/algo/rs.c \
+	bertos/drv/kdebug.c \
+	bertos/drv/timer.c \
+	bertos/io/kfile.c \
+	bertos/mware/formatwr.c \
+	bertos/mware/hex.c \
+	bertos/net/afsk.c \
+	bertos/net/ax25.c \
+	bertos/net/fx25.c \
+	bertos/os/hptime.c \
+	#
+
+afsk_bench_CPPFLAGS = -D'ARCH=(ARCH_EMUL)' -I$(afsk_bench_SRC_PATH) $(BENCH_CPPFLAGS)
+afsk_bench_CFLAGS = -O2
+afsk_bench_LDFLAGS = -lm
+
+TRG += dac_bench
+
+dac_bench_HOSTED = 1
+
+dac_bench_SRC_PATH = bench
+
+# dac_bench: cost and spectrum of the AFSK1200 modulator output.
+dac_bench_CSRC = \
+	$(dac_bench_SRC_PATH)/dac_bench.c \
+	bertos/algo/crc_ccitt.c \
+	bertos/algo/rs.c \
+	bertos/drv/kdebug.c \
+	bertos/drv/timer.c \
+	bertos/io/kfile.c \
+	bertos/mware/formatwr.c \
+	bertos/mware/hex.c \
+	bertos/net/afsk.c \
+	bertos/net/ax25.c \
+	bertos/net/fx25.c \
+	bertos/os/hptime.c \
+	#
+
+dac_bench_CPPFLAGS = $(afsk_bench_CPPFLAGS)
+dac_bench_CFLAGS = -O2
+dac_bench_LDFLAGS = -lm
+
+TRG += kiss_bench
+
+kiss_bench_HOSTED = 1
+
+kiss_bench_SRC_PATH = bench
+
+# kiss_bench: throughput of the KISS serial input.
+kiss_bench_CSRC = \
+	$(kiss_bench_SRC_PATH)/kiss_bench.c \
+	#
+
+kiss_bench_CPPFLAGS = $(afsk_bench_CPPFLAGS)
+kiss_bench_CFLAGS = -O2
+
+TRG += fifo_bench
+
+fifo_bench_HOSTED = 1
+
+fifo_bench_SRC_PATH = bench
+
+# fifo_bench: cost per byte of the modem and serial FIFOs.
+fifo_bench_CSRC = \
+	$(fifo_bench_SRC_PATH)/fifo_bench.c \
+	#
+
+fifo_bench_CPPFLAGS = $(afsk_bench_CPPFLAGS)
+fifo_bench_CFLAGS = -O2
+
+# No firmware image to measure here
+print_size:
+	@true
+
+TRG += dup_bench
+
+dup_bench_HOSTED = 1
+
+dup_bench_SRC_PATH = bench
+
+# dup_bench: accuracy and cost of the digipeater duplicate check.
+dup_bench_CSRC = \
+	$(dup_bench_SRC_PATH)/dup_bench.c \
+	bertos/algo/crc_ccitt.c \
+	#
+
+dup_bench_CPPFLAGS = $(afsk_bench_CPPFLAGS) -ITinyAPRS
+dup_bench_CFLAGS = -O2
+
+TRG += decode_bench decode_bench_butterworth decode_bench_fir decode_bench_8bit
+
+# decode_bench: frames decoded from .wav/.au recordings, one binary per
+# discriminator filter (the firmware one, Chebyshev, has no suffix), and
+# one on the 8 bit ADC input without the AGC.
+decode_bench_CSRC = \
+	bench/decode_bench.c \
+	bench/bench_audio.c \
+	bertos/algo/crc_ccitt.c \
+	bertos/algo/rs.c \
+	bertos/drv/kdebug.c \
+	bertos/drv/timer.c \
+	bertos/io/kfile.c \
+	bertos/mware/formatwr.c \
+	bertos/mware/hex.c \
+	bertos/net/afsk.c \
+	bertos/net/ax25.c \
+	bertos/net/fx25.c \
+	bertos/os/hptime.c \
+	#
+
+decode_bench_HOSTED = 1
+decode_bench_CPPFLAGS = $(afsk_bench_CPPFLAGS)
+decode_bench_CFLAGS = -O2
+decode_bench_LDFLAGS = -lm
+
+decode_bench_butterworth_HOSTED = 1
+decode_bench_butterworth_CSRC = $(decode_bench_CSRC)
+decode_bench_butterworth_CPPFLAGS = $(afsk_bench_CPPFLAGS) -DBENCH_AFSK_FILTER=AFSK_BUTTERWORTH
+decode_bench_butterworth_CFLAGS = -O2
+decode_bench_butterworth_LDFLAGS = -lm
+
+decode_bench_fir_HOSTED = 1
+decode_bench_fir_CSRC = $(decode_bench_CSRC)
+decode_bench_fir_CPPFLAGS = $(afsk_bench_CPPFLAGS) -DBENCH_AFSK_FILTER=AFSK_FIR
+decode_bench_fir_CFLAGS = -O2
+decode_bench_fir_LDFLAGS = -lm
+
+decode_bench_8bit_HOSTED = 1
+decode_bench_8bit_CSRC = $(decode_bench_CSRC)
+decode_bench_8bit_CPPFLAGS = $(afsk_bench_CPPFLAGS) -DBENCH_AFSK_AGC=0
+decode_bench_8bit_CFLAGS = -O2
+decode_bench_8bit_LDFLAGS = -lm
+
+TRG += snr_bench snr_bench_butterworth snr_bench_fir snr_bench_simple
+
+# snr_bench: packet error rate vs Eb/N0 of the firmware modem, one binary
+# per discriminator filter and clock recovery loop (the firmware ones,
+# Chebyshev and PI, have no suffix).
+snr_bench_CSRC = \
+	bench/snr_bench.c \
+	bertos/algo/crc_ccitt.c \
+	bertos/algo/rs.c \
+	bertos/drv/kdebug.c \
+	bertos/drv/timer.c \
+	bertos/io/kfile.c \
+	bertos/mware/formatwr.c \
+	bertos/mware/hex.c \
+	bertos/net/afsk.c \
+	bertos/net/ax25.c \
+	bertos/net/fx25.c \
+	bertos/os/hptime.c \
+	#
+
+snr_bench_HOSTED = 1
+snr_bench_CPPFLAGS = $(afsk_bench_CPPFLAGS)
+snr_bench_CFLAGS = -O2
+snr_bench_LDFLAGS = -lm
+
+snr_bench_butterworth_HOSTED = 1
+snr_bench_butterworth_CSRC = $(snr_bench_CSRC)
+snr_bench_butterworth_CPPFLAGS = $(afsk_bench_CPPFLAGS) -DBENCH_AFSK_FILTER=AFSK_BUTTERWORTH
+snr_bench_butterworth_CFLAGS = -O2
+snr_bench_butterworth_LDFLAGS = -lm
+
+snr_bench_fir_HOSTED = 1
+snr_bench_fir_CSRC = $(snr_bench_CSRC)
+snr_bench_fir_CPPFLAGS = $(afsk_bench_CPPFLAGS) -DBENCH_AFSK_FILTER=AFSK_FIR
+snr_bench_fir_CFLAGS = -O2
+snr_bench_fir_LDFLAGS = -lm
+
+snr_bench_simple_HOSTED = 1
+snr_bench_simple_CSRC = $(snr_bench_CSRC)
+snr_bench_simple_CPPFLAGS = $(afsk_bench_CPPFLAGS) -DBENCH_AFSK_PLL=AFSK_PLL_SIMPLE
+snr_bench_simple_CFLAGS = -O2
+snr_bench_simple_LDFLAGS = -lm
+
+# avr_prof: cycle count profile of the firmware ELF under simavr, see
+# bench/avr_prof.sh. Needs libsimavr, built with "make BENCH=1 SIMAVR=1".
+ifeq ($(SIMAVR),1)
+TRG += avr_prof
+
+SIMAVR_PREFIX ?= /usr
+
+avr_prof_HOSTED = 1
+avr_prof_CSRC = \
+	bench/avr_prof.c \
+	bench/bench_audio.c \
+	#
+
+avr_prof_CPPFLAGS = $(afsk_bench_CPPFLAGS) -I$(SIMAVR_PREFIX)/include/simavr
+avr_prof_CFLAGS = -O2
+avr_prof_LDFLAGS = -L$(SIMAVR_PREFIX)/lib -lsimavr -lelf -lm
+endif
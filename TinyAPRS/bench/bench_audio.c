@@ -0,0 +1,297 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Audio files for the host benchmarks.
+ */
+
+#include "bench_audio.h"
+
+#include <cfg/macros.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Sample formats of the audio files
+ */
+enum BenchFormat
+{
+	FMT_U8,       // wav 8 bit
+	FMT_S8,       // au 8 bit
+	FMT_S16LE,
+	FMT_S16BE,
+	FMT_F32LE,
+	FMT_F32BE,
+	FMT_ULAW,
+};
+
+static const uint8_t fmt_bytes[] = { 1, 1, 2, 2, 4, 4, 1 };
+
+static double bench_ulaw(uint8_t u)
+{
+	u = ~u;
+	int t = (((u & 0x0f) << 3) + 0x84) << ((u & 0x70) >> 4);
+	return ((u & 0x80) ? 0x84 - t : t - 0x84) / 32768.0;
+}
+
+bool bench_audioRead(BenchAudio *au, double *s)
+{
+	uint8_t buf[4 * 16];
+	size_t size = fmt_bytes[au->format] * au->channels;
+
+	if (au->frames == 0 || size > sizeof(buf) || fread(buf, 1, size, au->fp) != size)
+		return false;
+	au->frames--;
+
+	union { uint32_t u; float f; } f;
+	switch (au->format)
+	{
+	case FMT_U8:
+		*s = (buf[0] - 128) / 128.0;
+		break;
+	case FMT_S8:
+		*s = (int8_t)buf[0] / 128.0;
+		break;
+	case FMT_S16LE:
+		*s = (int16_t)(buf[0] | buf[1] << 8) / 32768.0;
+		break;
+	case FMT_S16BE:
+		*s = (int16_t)(buf[1] | buf[0] << 8) / 32768.0;
+		break;
+	case FMT_F32LE:
+		f.u = buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+		*s = f.f;
+		break;
+	case FMT_F32BE:
+		f.u = buf[3] | buf[2] << 8 | buf[1] << 16 | (uint32_t)buf[0] << 24;
+		*s = f.f;
+		break;
+	default:
+		*s = bench_ulaw(buf[0]);
+		break;
+	}
+	return true;
+}
+
+static uint32_t read_be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static uint32_t read_le32(const uint8_t *p)
+{
+	return (uint32_t)p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+static uint16_t read_le16(const uint8_t *p)
+{
+	return p[1] << 8 | p[0];
+}
+
+static const char *bench_openAu(BenchAudio *au)
+{
+	uint8_t hdr[20];
+
+	if (fread(hdr, 1, sizeof(hdr), au->fp) != sizeof(hdr))
+		return "truncated .au header";
+
+	uint32_t offset = read_be32(hdr);
+	uint32_t size = read_be32(hdr + 4);
+	uint32_t encoding = read_be32(hdr + 8);
+	au->rate = read_be32(hdr + 12);
+	au->channels = read_be32(hdr + 16);
+
+	switch (encoding)
+	{
+	case 1: au->format = FMT_ULAW; break;
+	case 2: au->format = FMT_S8; break;
+	case 3: au->format = FMT_S16BE; break;
+	case 6: au->format = FMT_F32BE; break;
+	default: return "unsupported .au encoding";
+	}
+	if (au->channels == 0)
+		return "no channels";
+	/* The size may be unknown (~0) */
+	au->frames = size / (fmt_bytes[au->format] * au->channels);
+	return fseek(au->fp, offset, SEEK_SET) ? "bad .au data offset" : NULL;
+}
+
+static const char *bench_openWav(BenchAudio *au)
+{
+	uint8_t hdr[8];
+	bool fmt = false;
+
+	if (fread(hdr, 1, 4, au->fp) != 4 || memcmp(hdr, "WAVE", 4))
+		return "not a WAVE file";
+
+	while (fread(hdr, 1, sizeof(hdr), au->fp) == sizeof(hdr))
+	{
+		uint32_t size = read_le32(hdr + 4);
+
+		if (!memcmp(hdr, "fmt ", 4))
+		{
+			uint8_t f[40];
+			if (size < 16 || size > sizeof(f) || fread(f, 1, size, au->fp) != size)
+				return "bad fmt chunk";
+
+			uint16_t tag = read_le16(f);
+			au->channels = read_le16(f + 2);
+			au->rate = read_le32(f + 4);
+			uint16_t bits = read_le16(f + 14);
+			/* WAVE_FORMAT_EXTENSIBLE, the format is in the subformat GUID */
+			if (tag == 0xfffe && size >= 26)
+				tag = read_le16(f + 24);
+
+			if (tag == 1 && bits == 8)
+				au->format = FMT_U8;
+			else if (tag == 1 && bits == 16)
+				au->format = FMT_S16LE;
+			else if (tag == 3 && bits == 32)
+				au->format = FMT_F32LE;
+			else if (tag == 7 && bits == 8)
+				au->format = FMT_ULAW;
+			else
+				return "unsupported WAVE format";
+			if (au->channels == 0)
+				return "no channels";
+			fmt = true;
+		}
+		else if (!memcmp(hdr, "data", 4))
+		{
+			if (!fmt)
+				return "data before the fmt chunk";
+			au->frames = size / (fmt_bytes[au->format] * au->channels);
+			return NULL;
+		}
+		else if (fseek(au->fp, size + (size & 1), SEEK_CUR))
+			break;
+	}
+	return "no data chunk";
+}
+
+/* Taps of the resampling filter on each side, at the lower of the two rates */
+#define BENCH_TAPS 16
+/* Cutoff, below the 4800Hz Nyquist frequency of the modem rate, lower for lower rates */
+#define BENCH_CUTOFF 4000.0
+/* Output positions between two input samples the filter is computed for */
+#define BENCH_PHASES 256
+
+/*
+ * Windowed sinc resampler: the input samples are kept in a sliding
+ * window, each output sample is computed at its position in the input,
+ * rounded to 1/BENCH_PHASES of a sample, with the Blackman windowed
+ * sinc taps precomputed for each of these phases.
+ */
+static void bench_resample(BenchAudio *au, uint32_t rate, bench_audio_out_t out, void *user)
+{
+	double step = (double)au->rate / rate;
+	/* Cutoff as a fraction of the input rate, the filter is wider when downsampling */
+	double fc = MIN(BENCH_CUTOFF, MIN(au->rate, rate) * 0.45) / au->rate;
+	int half = (int)ceil(BENCH_TAPS * MAX(step, 1.0));
+	int taps = 2 * half;
+	double *h = malloc((BENCH_PHASES + 1) * taps * sizeof(*h));
+
+	/* Tap j of phase p weights input c - half + 1 + j for the output at c + p / BENCH_PHASES */
+	for (int p = 0; p <= BENCH_PHASES; p++)
+		for (int j = 0; j < taps; j++)
+		{
+			double x = (double)p / BENCH_PHASES + half - 1 - j;
+			double w = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2 * M_PI * x / half);
+			h[p * taps + j] = w * ((x == 0) ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x));
+		}
+
+	size_t size = 4 * taps + 4096;
+	double *in = calloc(size, sizeof(*in));
+	size_t len = half;   // leading silence, before the first input sample
+	long base = -half;   // input index of in[0]
+	double t = 0;        // position of the next output, in input samples
+	bool eof = false;
+
+	for (;;)
+	{
+		long c = (long)floor(t);
+
+		/* Input needed up to c + half */
+		while (!eof && base + (long)len <= c + half)
+		{
+			if (len == size)
+			{
+				size_t drop = c - half + 1 - base;
+				memmove(in, in + drop, (len - drop) * sizeof(*in));
+				len -= drop;
+				base += drop;
+			}
+			eof = !bench_audioRead(au, &in[len]);
+			if (!eof)
+				len++;
+		}
+		if (eof && c >= base + (long)len)
+			break;
+
+		/* Past the end the input is silence */
+		const double *taps_p = &h[lrint((t - c) * BENCH_PHASES) * taps];
+		const double *x = &in[c - half + 1 - base];
+		int n = MIN(taps, (int)(base + (long)len - (c - half + 1)));
+		double acc = 0;
+		for (int j = 0; j < n; j++)
+			acc += x[j] * taps_p[j];
+		out(acc, user);
+		t += step;
+	}
+	free(in);
+	free(h);
+}
+
+int bench_audioOpen(BenchAudio *au, const char *name)
+{
+	const char *err = "unknown file type";
+	char magic[4];
+
+	memset(au, 0, sizeof(*au));
+	au->fp = fopen(name, "rb");
+	if (!au->fp)
+	{
+		perror(name);
+		return -1;
+	}
+	if (fread(magic, 1, 4, au->fp) == 4)
+	{
+		if (!memcmp(magic, ".snd", 4))
+			err = bench_openAu(au);
+		else if (!memcmp(magic, "RIFF", 4) && fseek(au->fp, 4, SEEK_CUR) == 0)
+			err = bench_openWav(au);
+	}
+	if (err)
+	{
+		fprintf(stderr, "%s: %s\n", name, err);
+		bench_audioClose(au);
+		return -1;
+	}
+	return 0;
+}
+
+void bench_audioConvert(BenchAudio *au, uint32_t rate, bench_audio_out_t out, void *user)
+{
+	if (au->rate == rate)
+	{
+		double s;
+		while (bench_audioRead(au, &s))
+			out(s, user);
+	}
+	else
+		bench_resample(au, rate, out, user);
+}
+
+void bench_audioClose(BenchAudio *au)
+{
+	fclose(au->fp);
+	au->fp = NULL;
+}
@@ -0,0 +1,57 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Audio files for the host benchmarks.
+ *
+ * Reads .wav and .au recordings of any sample rate, 8 or 16 bit PCM,
+ * 32 bit float or mu-law, the first channel only, and resamples them
+ * to the rate of the modem with a windowed sinc filter, cutting off
+ * above 4kHz.
+ */
+
+#ifndef BENCH_AUDIO_H
+#define BENCH_AUDIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct BenchAudio
+{
+	FILE *fp;
+	int format;
+	uint32_t rate;
+	uint16_t channels;
+	uint32_t frames;  // sample frames left, all the channels
+} BenchAudio;
+
+/* Called with each sample converted, in [-1, 1) */
+typedef void (*bench_audio_out_t)(double s, void *user);
+
+/*
+ * Open the file \a name and read its header.
+ * \return 0, or -1 after printing the error.
+ */
+int bench_audioOpen(BenchAudio *au, const char *name);
+
+/*
+ * Read the first channel of the next sample frame, in [-1, 1).
+ * \return false at the end of the file.
+ */
+bool bench_audioRead(BenchAudio *au, double *s);
+
+/*
+ * Pass all the samples of the file to \a out, resampled to \a rate.
+ */
+void bench_audioConvert(BenchAudio *au, uint32_t rate, bench_audio_out_t out, void *user);
+
+void bench_audioClose(BenchAudio *au);
+
+#endif /* BENCH_AUDIO_H */
@@ -0,0 +1,78 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief AFSK modem configuration for the host benchmarks.
+ *
+ * Same setup of the firmware, with the options the benchmarks
+ * need to exercise overridden.
+ */
+
+#ifndef BENCH_CFG_AFSK_H
+#define BENCH_CFG_AFSK_H
+
+#include "../../TinyAPRS/cfg/cfg_afsk.h"
+
+/*
+ * Whole frames are queued for modulation without a running DAC ISR,
+ * on rings wider than the 8-bit ones of the AVR.
+ */
+#define SPSC_WIDE_INDEX 1
+#undef CONFIG_AFSK_TX_BUFLEN
+#define CONFIG_AFSK_TX_BUFLEN 1024
+
+/* Demodulate in the main loop, as on a busy KISS TNC */
+#undef CONFIG_AFSK_SAMPLE_BUFLEN
+#define CONFIG_AFSK_SAMPLE_BUFLEN 128
+
+/* Compare the discriminator filters with BENCH_CPPFLAGS=-DBENCH_AFSK_FILTER=... */
+#ifdef BENCH_AFSK_FILTER
+	#undef CONFIG_AFSK_FILTER
+	#define CONFIG_AFSK_FILTER BENCH_AFSK_FILTER
+#endif
+
+/* The additional slicers run on the IIR discriminator only */
+#undef CONFIG_AFSK_SLICERS
+#if CONFIG_AFSK_FILTER == AFSK_FIR
+	#define CONFIG_AFSK_SLICERS 1
+#else
+	#define CONFIG_AFSK_SLICERS 5
+#endif
+
+/* Compare the clock recovery loops with BENCH_CPPFLAGS=-DBENCH_AFSK_PLL=... */
+#undef CONFIG_AFSK_PLL
+#ifdef BENCH_AFSK_PLL
+	#define CONFIG_AFSK_PLL BENCH_AFSK_PLL
+#else
+	#define CONFIG_AFSK_PLL AFSK_PLL_PI
+#endif
+
+/* Compare with the 8 bit ADC input with BENCH_CPPFLAGS=-DBENCH_AFSK_AGC=0 */
+#ifdef BENCH_AFSK_AGC
+	#undef CONFIG_AFSK_AGC
+	#define CONFIG_AFSK_AGC BENCH_AFSK_AGC
+#endif
+
+/* Without the twist equalizer with BENCH_CPPFLAGS=-DBENCH_AFSK_EQ=0, it needs the AGC */
+#undef CONFIG_AFSK_EQ
+#ifdef BENCH_AFSK_EQ
+	#define CONFIG_AFSK_EQ BENCH_AFSK_EQ
+#else
+	#define CONFIG_AFSK_EQ CONFIG_AFSK_AGC
+#endif
+
+/* Mark the low confidence bits for the AX25 CRC repair */
+#undef CONFIG_AFSK_WEAK_BITS
+#define CONFIG_AFSK_WEAK_BITS 16
+
+/* FX.25 decoding always on, sending selected with the -x option */
+#undef CONFIG_AFSK_FX25
+#define CONFIG_AFSK_FX25 1
+
+#endif /* BENCH_CFG_AFSK_H */
@@ -0,0 +1,41 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief AX25 configuration for the host benchmarks.
+ */
+
+#ifndef BENCH_CFG_AX25_H
+#define BENCH_CFG_AX25_H
+
+#include "../../TinyAPRS/cfg/cfg_ax25.h"
+
+/* The slicers and the FX.25 decoder */
+#undef CONFIG_AX25_RX_CHANNELS
+#define CONFIG_AX25_RX_CHANNELS 6
+
+/* Disable the CRC repair with BENCH_CPPFLAGS=-DBENCH_AX25_CRC_FIX=0 */
+#undef CONFIG_AX25_CRC_FIX
+#ifdef BENCH_AX25_CRC_FIX
+	#define CONFIG_AX25_CRC_FIX BENCH_AX25_CRC_FIX
+#else
+	#define CONFIG_AX25_CRC_FIX 1
+#endif
+
+/* Room for a few full frames in the transmit queue */
+#undef CONFIG_AX25_TX_QUEUE
+#define CONFIG_AX25_TX_QUEUE 4
+#undef CONFIG_AX25_TX_BUF_LEN
+#define CONFIG_AX25_TX_BUF_LEN 1024
+
+/* One buffer per receive channel, the receive queue and the queued frames that don't fit */
+#undef CONFIG_AX25_FRAMES
+#define CONFIG_AX25_FRAMES (CONFIG_AX25_RX_CHANNELS + CONFIG_AX25_RX_QUEUE + CONFIG_AX25_TX_QUEUE)
+
+#endif /* BENCH_CFG_AX25_H */
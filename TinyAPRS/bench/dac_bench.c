@@ -0,0 +1,255 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Host benchmark of the AFSK1200 modulator output.
+ *
+ * Counts the CPU cycles spent by afsk_dac_isr() for each sample while
+ * sending frames, and compares the sine lookup of the modulator with
+ * the previous one (quarter wave table, modulo on the phase). Then
+ * reports the SINAD of the tones as output by a 4 bit R-2R ladder and
+ * by an 8 bit PWM.
+ *
+ * Cycles are counted with the TSC of the host CPU: they show the
+ * relative cost, not what an AVR spends.
+ *
+ * Usage: dac_bench [-f frames]
+ */
+
+#include "cfg/cfg_afsk.h"
+#include "cfg/cfg_ax25.h"
+
+#include <net/afsk.h>
+#include <net/ax25.h>
+#include <cfg/debug.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define bench_cycles() __rdtsc()
+	#define CYCLES "cycles"
+#else
+	static uint64_t bench_cycles(void)
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+	#define CYCLES "ns"
+#endif
+
+static Afsk afsk;
+static AX25Ctx ax25;
+
+/* The previous modulator lookup: quarter wave table, 512 samples period */
+#define OLD_SIN_LEN 512
+
+static const uint8_t old_table[OLD_SIN_LEN / 4] =
+{
+	128, 129, 131, 132, 134, 135, 137, 138, 140, 142, 143, 145, 146, 148, 149, 151,
+	152, 154, 155, 157, 158, 160, 162, 163, 165, 166, 167, 169, 170, 172, 173, 175,
+	176, 178, 179, 181, 182, 183, 185, 186, 188, 189, 190, 192, 193, 194, 196, 197,
+	198, 200, 201, 202, 203, 205, 206, 207, 208, 210, 211, 212, 213, 214, 215, 217,
+	218, 219, 220, 221, 222, 223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 233,
+	234, 234, 235, 236, 237, 238, 238, 239, 240, 241, 241, 242, 243, 243, 244, 245,
+	245, 246, 246, 247, 248, 248, 249, 249, 250, 250, 250, 251, 251, 252, 252, 252,
+	253, 253, 253, 253, 254, 254, 254, 254, 254, 255, 255, 255, 255, 255, 255, 255,
+};
+
+static uint8_t old_sample(uint16_t idx)
+{
+	uint16_t new_idx = idx % (OLD_SIN_LEN / 2);
+	new_idx = (new_idx >= (OLD_SIN_LEN / 4)) ? (OLD_SIN_LEN / 2 - new_idx - 1) : new_idx;
+
+	uint8_t data = old_table[new_idx];
+
+	return (idx >= (OLD_SIN_LEN / 2)) ? (255 - data) : data;
+}
+
+/* Mark and space phase increments of the previous modulator */
+#define OLD_MARK_INC  DIV_ROUND(OLD_SIN_LEN * 1200, SAMPLERATE)
+#define OLD_SPACE_INC DIV_ROUND(OLD_SIN_LEN * 2200, SAMPLERATE)
+
+/* The current modulator lookup, as in afsk_dac_isr() */
+static uint8_t new_table[256];
+
+static void new_init(void)
+{
+	for (int i = 0; i < 128; i++)
+	{
+		new_table[i] = lrint(127.5 + 127.5 * sin(2 * M_PI * (i + 0.5) / 256));
+		new_table[i + 128] = 255 - new_table[i];
+	}
+}
+
+#define NEW_MARK_INC  DIV_ROUND(0x10000UL * 1200, SAMPLERATE)
+#define NEW_SPACE_INC DIV_ROUND(0x10000UL * 2200, SAMPLERATE)
+
+/* Samples of each lookup loop */
+#define BENCH_LOOKUPS 10000000
+
+static volatile uint8_t sink;
+
+/*
+ * Time the sample generation alone, switching tone every 8 samples
+ * as the modulator would at the worst.
+ */
+static void bench_lookup(void)
+{
+	uint16_t acc = 0, inc = OLD_MARK_INC;
+	uint64_t start = bench_cycles();
+	for (long i = 0; i < BENCH_LOOKUPS; i++)
+	{
+		if ((i & 7) == 0)
+			inc = (inc == OLD_MARK_INC) ? OLD_SPACE_INC : OLD_MARK_INC;
+		acc += inc;
+		acc %= OLD_SIN_LEN;
+		sink = old_sample(acc);
+	}
+	double old_cost = (double)(bench_cycles() - start) / BENCH_LOOKUPS;
+
+	acc = 0, inc = NEW_MARK_INC;
+	start = bench_cycles();
+	for (long i = 0; i < BENCH_LOOKUPS; i++)
+	{
+		if ((i & 7) == 0)
+			inc = (inc == NEW_MARK_INC) ? NEW_SPACE_INC : NEW_MARK_INC;
+		acc += inc;
+		sink = new_table[acc >> 8];
+	}
+	double new_cost = (double)(bench_cycles() - start) / BENCH_LOOKUPS;
+
+	printf("sine lookup: quarter wave %.2f " CYCLES "/sample, full wave %.2f " CYCLES "/sample (%.0f%% less)\n",
+		old_cost, new_cost, 100 * (1 - new_cost / old_cost));
+}
+
+/*
+ * Time afsk_dac_isr() while sending frames.
+ */
+static void bench_isr(int frames)
+{
+	static const AX25Call path[] = AX25_PATH(AX25_CALL("APZTA", 0), AX25_CALL("BENCH", 1), AX25_CALL("WIDE1", 1));
+	static const char info[] = "!3011.54N/12007.35E>TinyAPRS DAC bench frame";
+	unsigned long samples = 0;
+	uint64_t cycles = 0;
+
+	afsk_init(&afsk, 0, 0);
+	ax25_init(&ax25, &afsk.fd, NULL);
+
+	for (int i = 0; i < frames; i++)
+	{
+		ax25_sendVia(&ax25, path, countof(path), info, sizeof(info) - 1);
+		while (afsk.sending)
+		{
+			uint64_t start = bench_cycles();
+			sink = afsk_dac_isr(&afsk);
+			cycles += bench_cycles() - start;
+			samples++;
+		}
+	}
+	printf("afsk_dac_isr: %lu samples, %.2f " CYCLES "/sample, timer overhead included\n",
+		samples, (double)cycles / MAX(samples, 1UL));
+}
+
+/*
+ * SINAD of a tone: power at the tone frequency against the power of
+ * everything else, DC excluded.
+ */
+static double bench_sinad(const uint8_t *s, int len, double freq)
+{
+	double mean = 0, total = 0, tone;
+	double xc = 0, xs = 0, cc = 0, ss = 0, cs = 0;
+
+	for (int i = 0; i < len; i++)
+		mean += s[i];
+	mean /= len;
+
+	/* Least squares fit of a sine and a cosine: the tone needs not be an exact number of periods */
+	for (int i = 0; i < len; i++)
+	{
+		double x = s[i] - mean;
+		double c = cos(2 * M_PI * freq * i / SAMPLERATE);
+		double n = sin(2 * M_PI * freq * i / SAMPLERATE);
+		total += x * x;
+		xc += x * c;
+		xs += x * n;
+		cc += c * c;
+		ss += n * n;
+		cs += c * n;
+	}
+	double det = cc * ss - cs * cs;
+	double a = (xc * ss - xs * cs) / det;
+	double b = (xs * cc - xc * cs) / det;
+	tone = a * xc + b * xs;
+	return 10 * log10(tone / (total - tone));
+}
+
+static void bench_spectrum(void)
+{
+	static const struct { const char *name; int freq; } tones[] = { { "mark", 1200 }, { "space", 2200 } };
+	uint8_t buf[SAMPLERATE];
+
+	for (unsigned t = 0; t < countof(tones); t++)
+	{
+		uint16_t old_inc = DIV_ROUND(OLD_SIN_LEN * tones[t].freq, SAMPLERATE);
+		uint16_t new_inc = DIV_ROUND(0x10000UL * tones[t].freq, SAMPLERATE);
+		double old_freq = (double)old_inc * SAMPLERATE / OLD_SIN_LEN;
+		double new_freq = (double)new_inc * SAMPLERATE / 0x10000;
+		double sinad[2][2];
+
+		for (int bits = 0; bits < 2; bits++)
+		{
+			uint8_t mask = bits ? 0xFF : 0xF0;
+			uint16_t old_acc = 0, new_acc = 0;
+
+			for (int i = 0; i < SAMPLERATE; i++)
+				buf[i] = old_sample(old_acc = (old_acc + old_inc) % OLD_SIN_LEN) & mask;
+			sinad[0][bits] = bench_sinad(buf, SAMPLERATE, old_freq);
+
+			for (int i = 0; i < SAMPLERATE; i++)
+				buf[i] = new_table[(new_acc += new_inc) >> 8] & mask;
+			sinad[1][bits] = bench_sinad(buf, SAMPLERATE, new_freq);
+		}
+
+		printf("%s: quarter wave %.2fHz, SINAD %.1fdB (4 bit) %.1fdB (8 bit); "
+			"full wave %.2fHz, SINAD %.1fdB (4 bit) %.1fdB (8 bit)\n", tones[t].name,
+			old_freq, sinad[0][0], sinad[0][1], new_freq, sinad[1][0], sinad[1][1]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 100;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f':
+			frames = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-f frames]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	new_init();
+	bench_lookup();
+	bench_isr(frames);
+	bench_spectrum();
+	return 0;
+}
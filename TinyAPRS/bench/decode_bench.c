@@ -0,0 +1,271 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Host benchmark of the AFSK1200 demodulator on recorded audio.
+ *
+ * Decodes .wav and .au recordings, e.g. the WA8LMF test tracks or off-air
+ * captures, through the firmware demodulator and AX25 receiver, and reports
+ * for each file:
+ * \li the frames received, after the duplicates between the slicers;
+ * \li the unique frames, the same frame heard again (through a digipeater
+ *     with the same path, or a beacon) counted once;
+ * \li the frames with a wrong CRC;
+ * \li the demodulator cost in ns per sample, the AX25 polling included.
+ *
+ * Files can have any sample rate, 8 or 16 bit PCM, 32 bit float or mu-law,
+ * the first channel is used. They are resampled to the modem rate with a
+ * windowed sinc filter, cutting off above 4kHz, and scaled full scale to
+ * full scale on the ADC input, with a gain of -g dB and a DC offset of -o
+ * times the full scale if given.
+ *
+ * The discriminator filter is chosen at build time (CONFIG_AFSK_FILTER):
+ * a binary is built for each one, see bench/decode_corpus.sh to run them
+ * all. decode_bench_8bit is the firmware demodulator on the 8 bit ADC
+ * input, without the DC blocker and the AGC (CONFIG_AFSK_AGC), to compare
+ * the decoding of weak or offset audio. With -m the results are printed as tab separated values, one line
+ * per file, after a header line unless -H is given too.
+ *
+ * Times are measured on the host CPU: they show the relative cost, not
+ * the cycles an AVR spends.
+ *
+ * Usage: decode_bench [-g gain_db] [-o offset] [-m] [-H] file ...
+ */
+
+#include "cfg/cfg_afsk.h"
+#include "cfg/cfg_ax25.h"
+#include "bench_audio.h"
+
+#include <net/afsk.h>
+#include <net/ax25.h>
+#include <drv/timer.h>
+#include <cfg/debug.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static Afsk rx_afsk;
+static AX25Ctx rx_ax25;
+
+static unsigned long samples;
+static double decode_ns;
+
+/* Frames received, as FCS and length, to count the unique ones */
+static uint32_t *heard;
+static size_t heard_cnt, heard_size;
+
+static const char *bench_filter(void)
+{
+#if CONFIG_AFSK_FILTER == AFSK_BUTTERWORTH
+	return "butterworth";
+#elif CONFIG_AFSK_FILTER == AFSK_CHEBYSHEV
+	return "chebyshev";
+#else
+	return "fir";
+#endif
+}
+
+static void bench_hook(struct AX25Msg *msg)
+{
+	const AX25Frame *frame = rx_ax25.frame;
+	(void)msg;
+
+	if (heard_cnt == heard_size)
+	{
+		heard_size = heard_size ? 2 * heard_size : 1024;
+		heard = realloc(heard, heard_size * sizeof(*heard));
+	}
+	heard[heard_cnt++] = ((uint32_t)(frame->buf[frame->len - 2] | (frame->buf[frame->len - 1] << 8)) << 16) | frame->len;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	uint32_t ka = *(const uint32_t *)a, kb = *(const uint32_t *)b;
+	return ka < kb ? -1 : ka > kb;
+}
+
+static size_t bench_unique(void)
+{
+	size_t n = 0;
+
+	qsort(heard, heard_cnt, sizeof(*heard), bench_cmp);
+	for (size_t i = 0; i < heard_cnt; i++)
+		n += (i == 0 || heard[i] != heard[i - 1]);
+	return n;
+}
+
+/* Samples received by the ADC ISR between two main loop iterations */
+#define BENCH_POLL_SAMPLES 32
+
+static void bench_poll(void)
+{
+	ax25_poll(&rx_ax25);
+#if CONFIG_AX25_RX_QUEUE
+	while (ax25_rxDeliver(&rx_ax25))
+		;
+#endif
+}
+
+/*
+ * Feed a sample to the ADC ISR, then let the main loop poll the
+ * frames every few samples. The timer ISR is simulated to keep the
+ * clock going at the sample rate.
+ */
+static void bench_sample(afsk_sample_t sample)
+{
+	afsk_adc_isr(&rx_afsk, sample);
+	if (samples % BENCH_POLL_SAMPLES == 0)
+		bench_poll();
+
+	if (++samples % (SAMPLERATE / TIMER_TICKS_PER_SEC) == 0)
+		_clock++;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Resampled audio is demodulated in blocks, timed apart from the file reading */
+#define BENCH_BLOCK 4096
+
+static afsk_sample_t block[BENCH_BLOCK];
+static size_t block_len;
+
+static void bench_flush(void)
+{
+	double start = bench_now();
+
+	for (size_t i = 0; i < block_len; i++)
+		bench_sample(block[i]);
+	decode_ns += (bench_now() - start) * 1e9;
+	block_len = 0;
+}
+
+static double gain = 1;
+static double offset;
+
+/* Full scale of the ADC input */
+#define BENCH_ADC_FULL (1L << (AFSK_SAMPLE_BITS - 1))
+
+static void bench_output(double s, void *user)
+{
+	(void)user;
+	block[block_len++] = (afsk_sample_t)MINMAX(-BENCH_ADC_FULL, lrint((s * gain + offset) * BENCH_ADC_FULL), BENCH_ADC_FULL - 1);
+	if (block_len == BENCH_BLOCK)
+		bench_flush();
+}
+
+/*
+ * Return the receive buffers of the previous file to the frame arena,
+ * ax25_init() doesn't.
+ */
+static void bench_release(void)
+{
+	if (rx_ax25.rx_frame)
+		ax25_frameRelease(rx_ax25.rx_frame);
+#if CONFIG_AX25_RX_CHANNELS > 1
+	for (int i = 0; i < rx_ax25.rx_cnt; i++)
+		if (rx_ax25.rx[i].rx_frame)
+			ax25_frameRelease(rx_ax25.rx[i].rx_frame);
+#endif
+}
+
+static void bench_reset(void)
+{
+	bench_release();
+	afsk_init(&rx_afsk, 0, 0);
+	ax25_init(&rx_ax25, &rx_afsk.fd, bench_hook);
+#if CONFIG_AX25_CRC_FIX
+	rx_ax25.weak_bits = afsk_weakBits;
+#endif
+#if CONFIG_AFSK_SLICERS > 1
+	for (int i = 0; i < CONFIG_AFSK_SLICERS - 1; i++)
+		ax25_addRxChannel(&rx_ax25, afsk_slicerChannel(&rx_afsk, i));
+#endif
+#if CONFIG_AFSK_FX25
+	ax25_addRxChannel(&rx_ax25, afsk_fx25Channel(&rx_afsk));
+#endif
+	samples = 0;
+	decode_ns = 0;
+	heard_cnt = 0;
+	block_len = 0;
+}
+
+static int bench_file(const char *name, bool tsv)
+{
+	BenchAudio au;
+
+	if (bench_audioOpen(&au, name) < 0)
+		return -1;
+
+	bench_reset();
+	bench_audioConvert(&au, SAMPLERATE, bench_output, NULL);
+	bench_flush();
+	bench_poll();
+	bench_audioClose(&au);
+
+	unsigned long frames = rx_ax25.stat.rx_ok;
+	double ns = decode_ns / MAX(samples, 1UL);
+	if (tsv)
+		printf("%s\t%s\t%u\t%d\t%d\t%lu\t%lu\t%zu\t%lu\t%.1f\n", name, bench_filter(), au.rate,
+			AFSK_SAMPLE_BITS, CONFIG_AFSK_SLICERS, samples, frames, bench_unique(),
+			(unsigned long)rx_ax25.stat.rx_err, ns);
+	else
+		printf("%s: %u Hz, %lu samples, %d bit ADC, filter %s, %d slicers: %lu frames, %zu unique, %lu crc errors, %.1f ns/sample\n",
+			name, au.rate, samples, AFSK_SAMPLE_BITS, bench_filter(), CONFIG_AFSK_SLICERS, frames, bench_unique(),
+			(unsigned long)rx_ax25.stat.rx_err, ns);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	bool tsv = false, header = true;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "g:o:mH")) != -1)
+	{
+		switch (opt)
+		{
+		case 'g':
+			gain = pow(10, atof(optarg) / 20);
+			break;
+		case 'o':
+			offset = atof(optarg);
+			break;
+		case 'm':
+			tsv = true;
+			break;
+		case 'H':
+			header = false;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-g gain_db] [-o offset] [-m] [-H] file ...\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind == argc)
+	{
+		fprintf(stderr, "Usage: %s [-g gain_db] [-o offset] [-m] [-H] file ...\n", argv[0]);
+		return 1;
+	}
+
+	if (tsv && header)
+		printf("file\tfilter\trate\tadc_bits\tslicers\tsamples\tframes\tunique\tcrc_errors\tns_per_sample\n");
+	for (int i = optind; i < argc; i++)
+		if (bench_file(argv[i], tsv) < 0)
+			return 1;
+	return 0;
+}
@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Decode a corpus of WAV/AU recordings with each AFSK filter variant,
+# e.g. the WA8LMF test tracks and off-air recordings, as a TSV table.
+# Build the benches first with "make BENCH=1".
+#
+# With -b, compare with a previous table and fail if any recording
+# decodes fewer frames with any filter: the regression gate of the
+# demodulator changes.
+#
+# Usage: bench/decode_corpus.sh [-b baseline.tsv] file...
+#
+
+BASELINE=
+if [ "$1" = "-b" ]; then
+	BASELINE=$2
+	shift 2
+fi
+if [ $# -eq 0 ]; then
+	echo "Usage: $0 [-b baseline.tsv] file..." >&2
+	exit 1
+fi
+
+OUT=$(mktemp)
+trap 'rm -f $OUT' EXIT
+
+HEADER=
+for BENCH in decode_bench decode_bench_butterworth decode_bench_fir; do
+	images/$BENCH -m $HEADER "$@" >> $OUT || exit 1
+	HEADER=-H
+done
+cat $OUT
+
+[ -z "$BASELINE" ] && exit 0
+
+# frames decoded per file and filter, by column name
+awk -F '\t' '
+	FNR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+	NR == FNR { base[$col["file"] FS $col["filter"]] = $col["frames"]; next }
+	{
+		key = $col["file"] FS $col["filter"]
+		if (key in base && $col["frames"] + 0 < base[key] + 0) {
+			printf("%s %s: %d frames, %d in the baseline\n", $col["file"], $col["filter"], $col["frames"], base[key]) > "/dev/stderr"
+			failed = 1
+		}
+	}
+	END { exit failed }
+' "$BASELINE" $OUT
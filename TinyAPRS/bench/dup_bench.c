@@ -0,0 +1,269 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Host benchmark of the digipeater duplicate check.
+ *
+ * Simulates a busy channel: stations send frames at the given rate, each
+ * heard again a few times within seconds through other digipeaters (the
+ * path differs, the rest doesn't), and some stations beacon the same
+ * payload every few minutes. For the previous cache (8 entries, 15s,
+ * polynomial hash over the whole frame, linear scan) and the open
+ * addressed table it reports:
+ * \li copies missed, digipeated again within the window;
+ * \li false drops, new frames or beacons taken for a recent one;
+ * \li the table counters and the cost per lookup.
+ *
+ * Times are measured on the host CPU: they show the relative cost, not
+ * the cycles an AVR spends.
+ *
+ * Usage: dup_bench [-n frames] [-r frames_per_min] [-s stations]
+ */
+
+#include "../TinyAPRS/digi_dup.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_FRAME_LEN 128
+
+typedef struct BenchFrame{
+	uint8_t buf[BENCH_FRAME_LEN];
+	uint16_t len;
+	uint16_t ctrl;		// end of the address field
+	uint32_t time;		// seconds
+	int orig;			// index of the original frame, of its first copy for a beacon
+}BenchFrame;
+
+static BenchFrame *heard;
+static int heard_cnt;
+
+static void bench_call(uint8_t *buf, const char *call, uint8_t ssid, bool last){
+	for(int i = 0; i < 6; i++){
+		buf[i] = (*call ? *call++ : ' ') << 1;
+	}
+	buf[6] = 0x60 | (ssid << 1) | (last ? 0x01 : 0);
+}
+
+/*
+ * A frame from a station, with a path of 1 or 2 hops: WIDE1-1,WIDE2-1
+ * as sent, or a digipeater call and WIDE2-1 for the copies
+ */
+static void bench_frame(BenchFrame *f, int station, const uint8_t *payload, int len, int copy){
+	char call[12];
+	snprintf(call, sizeof(call), "BG%04d", station);
+	uint8_t *p = f->buf;
+	bench_call(p, "APRS", 0, false);
+	bench_call(p + 7, call, station % 16, false);
+	p += 14;
+	if(copy){
+		char digi[12];
+		snprintf(digi, sizeof(digi), "DG%04d", copy);
+		bench_call(p, digi, 0, false);
+		p[6] |= 0x80;
+	}else{
+		bench_call(p, "WIDE1", 1, false);
+	}
+	bench_call(p + 7, "WIDE2", 1, true);
+	p += 14;
+	f->ctrl = p - f->buf;
+	*p++ = 0x03;
+	*p++ = 0xf0;
+	memcpy(p, payload, len);
+	f->len = p + len - f->buf;
+}
+
+static int bench_cmp(const void *a, const void *b){
+	const BenchFrame *fa = a, *fb = b;
+	return fa->time < fb->time ? -1 : fa->time > fb->time;
+}
+
+/*
+ * The frames heard in \a frames / \a rate minutes, copies included,
+ * in time order
+ */
+static void bench_traffic(int frames, int rate, int stations){
+	heard = malloc(frames * 4 * sizeof(*heard));
+	uint32_t span = frames * 60 / rate;
+
+	for(int i = 0; i < frames; i++){
+		uint8_t payload[80];
+		int station = rand() % stations;
+		int len = 20 + rand() % 60;
+		uint32_t t = rand() % span;
+		bool beacon = station % 4 == 0;
+
+		// a beacon repeats the payload of its station
+		srand(beacon ? station : rand());
+		for(int j = 0; j < (int)sizeof(payload); j++){
+			payload[j] = ' ' + rand() % 95;
+		}
+		srand(t * 7919 + i);
+		if(beacon){
+			len = 20 + station % 60;
+		}
+
+		int copies = 1 + rand() % 4;
+		for(int c = 0; c < copies; c++){
+			BenchFrame *f = &heard[heard_cnt++];
+			bench_frame(f, station, payload, len, c ? 1 + rand() % 50 : 0);
+			f->time = t + (c ? 1 + rand() % 10 : 0);
+			f->orig = i;
+		}
+	}
+	qsort(heard, heard_cnt, sizeof(*heard), bench_cmp);
+}
+
+/* The previous cache */
+#define OLD_SIZE 8
+#define OLD_INTERVAL 15
+
+typedef struct OldEntry{
+	uint16_t hash;
+	uint32_t timestamp;
+}OldEntry;
+
+static OldEntry old_cache[OLD_SIZE];
+static uint8_t old_index;
+
+static uint16_t old_hash(const BenchFrame *f){
+	uint16_t hash = 0;
+	for(int i = 0; i < 14; i++){
+		hash = hash * 31 + (i == 6 || i == 13 ? (f->buf[i] >> 1) & 0x0f : f->buf[i] >> 1);
+	}
+	for(int i = f->ctrl + 2; i < f->len; i++){
+		hash = hash * 31 + f->buf[i];
+	}
+	return hash;
+}
+
+static bool old_check(const BenchFrame *f, uint32_t now){
+	uint16_t hash = old_hash(f);
+	for(uint8_t i = OLD_SIZE; old_index > 0 && i > 0; i--){
+		uint8_t j = (old_index - 1 + i) % OLD_SIZE;
+		if(old_cache[j].hash == hash && now - old_cache[j].timestamp < OLD_INTERVAL){
+			return true;
+		}
+	}
+	old_index++;
+	if(old_index > OLD_SIZE) old_index -= OLD_SIZE;
+	old_cache[old_index - 1].hash = hash;
+	old_cache[old_index - 1].timestamp = now;
+	return false;
+}
+
+static DigiDup table;
+
+static bool new_check(const BenchFrame *f, uint32_t now){
+	return digi_dup_check(&table, digi_dup_key(f->buf, f->ctrl, f->len), f->len - f->ctrl, now);
+}
+
+static double bench_now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Run the duplicate check on the traffic. A frame should be dropped if
+ * the same frame was let through less than \a window seconds ago: a
+ * copy that was missed went on the air again, the window starts over.
+ */
+static void bench_run(const char *name, bool (*check)(const BenchFrame *, uint32_t), uint32_t window){
+	int missed = 0, false_drops = 0, dups = 0;
+	uint32_t *passed = calloc(heard_cnt, sizeof(*passed));
+	uint8_t *seen = calloc(heard_cnt, 1);
+
+	memset(old_cache, 0, sizeof(old_cache));
+	old_index = 0;
+	digi_dup_init(&table);
+
+	// last time each distinct frame, original or beacon payload, went through
+	for(int i = 0; i < heard_cnt; i++){
+		const BenchFrame *f = &heard[i];
+		int key = -1;
+		for(int j = i - 1; j >= 0 && f->time - heard[j].time <= 600; j--){
+			if(heard[j].len == f->len && !memcmp(heard[j].buf, f->buf, 14)
+					&& !memcmp(heard[j].buf + heard[j].ctrl, f->buf + f->ctrl, f->len - f->ctrl)){
+				key = j;
+				break;
+			}
+		}
+		bool is_dup = key >= 0 && seen[key] && f->time - passed[key] < window;
+		bool dropped = check(f, f->time);
+		dups += is_dup;
+		if(is_dup && !dropped){
+			missed++;
+		}else if(!is_dup && dropped){
+			false_drops++;
+		}
+		seen[i] = 1;
+		passed[i] = (key >= 0 && dropped) ? passed[key] : f->time;
+	}
+
+	double start = bench_now();
+	unsigned long lookups = 0;
+	do{
+		for(int i = 0; i < heard_cnt; i++){
+			check(&heard[i], heard[i].time);
+		}
+		lookups += heard_cnt;
+	}while(bench_now() - start < 0.5);
+	double ns = (bench_now() - start) * 1e9 / lookups;
+
+	printf("  %-6s %5d copies, %5d missed, %4d false drops, %6.1f ns/lookup\n",
+		name, dups, missed, false_drops, ns);
+	free(passed);
+	free(seen);
+}
+
+int main(int argc, char *argv[]){
+	int frames = 20000, rate = 60, stations = 300;
+	int opt;
+
+	while((opt = getopt(argc, argv, "n:r:s:")) != -1){
+		switch(opt){
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 's':
+			stations = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-n frames] [-r frames_per_min] [-s stations]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(frames < 1 || rate < 1 || stations < 1 || stations > 9999){
+		fprintf(stderr, "%s: invalid parameters\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	bench_traffic(frames, rate, stations);
+	printf("%d frames heard, %d originals at %d/min from %d stations\n", heard_cnt, frames, rate, stations);
+
+	printf("old cache, %d entries, %ds:\n", OLD_SIZE, OLD_INTERVAL);
+	bench_run("linear", old_check, OLD_INTERVAL);
+	printf("table, %d entries, %ds, %d probes:\n", DIGI_DUP_SIZE, DIGI_DUP_WINDOW, DIGI_DUP_PROBES);
+	bench_run("table", new_check, DIGI_DUP_WINDOW);
+
+	// the counters of the check run, before the timing loops
+	digi_dup_init(&table);
+	for(int i = 0; i < heard_cnt; i++){
+		new_check(&heard[i], heard[i].time);
+	}
+	printf("  hits %u, misses %u, evicts %u\n", table.hits, table.misses, table.evicts);
+	return 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Host benchmark of the modem and serial FIFOs.
+ *
+ * Moves bytes through a FIFO the way the firmware does, pushing a burst
+ * then popping it with the empty/full checks, and reports the cost per
+ * byte of:
+ * \li the FIFOBuffer with the locked calls of the main loop, each wrapped
+ *     in a save/disable/restore of an emulated status register, as
+ *     ATOMIC() does on the AVR (in, cli, out);
+ * \li the lock-free ring, one byte at a time;
+ * \li the lock-free ring with the bulk push_n/pop_n.
+ *
+ * Times are measured on the host CPU: they show the relative cost, not
+ * the cycles an AVR spends.
+ *
+ * Usage: fifo_bench [-s size] [-b burst] [-c chunk]
+ */
+
+#include <struct/fifobuf.h>
+#include <struct/spscbuf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_BYTES (64UL * 1024 * 1024)
+
+/* Stand-in for SREG, read and cleared then restored by ATOMIC() */
+static volatile uint8_t bench_sreg = 0x80;
+
+#define BENCH_ATOMIC(CODE) \
+	do { \
+		uint8_t __flags = bench_sreg; \
+		bench_sreg = 0; \
+		MEMORY_BARRIER; \
+		CODE; \
+		MEMORY_BARRIER; \
+		bench_sreg = __flags; \
+	} while (0)
+
+static unsigned char buf[SPSC_MAX_LEN];
+static unsigned char data[SPSC_MAX_LEN];
+static unsigned long sum;
+
+static double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench_fifo(size_t size, size_t burst)
+{
+	FIFOBuffer fb;
+	double start = bench_now();
+
+	fifo_init(&fb, buf, size);
+	for (unsigned long n = 0; n < BENCH_BYTES; n += burst)
+	{
+		for (size_t i = 0; i < burst; i++)
+		{
+			bool full;
+			BENCH_ATOMIC(full = fifo_isfull(&fb));
+			if (!full)
+				BENCH_ATOMIC(fifo_push(&fb, data[i]));
+		}
+		for (;;)
+		{
+			bool empty;
+			unsigned char c;
+
+			BENCH_ATOMIC(empty = fifo_isempty(&fb));
+			if (empty)
+				break;
+			BENCH_ATOMIC(c = fifo_pop(&fb));
+			sum += c;
+		}
+	}
+	return (bench_now() - start) * 1e9 / BENCH_BYTES;
+}
+
+static double bench_spsc(size_t size, size_t burst)
+{
+	SpscBuffer sb;
+	double start = bench_now();
+
+	spsc_init(&sb, buf, size);
+	for (unsigned long n = 0; n < BENCH_BYTES; n += burst)
+	{
+		for (size_t i = 0; i < burst; i++)
+			if (!spsc_isfull(&sb))
+				spsc_push(&sb, data[i]);
+		while (!spsc_isempty(&sb))
+			sum += spsc_pop(&sb);
+	}
+	return (bench_now() - start) * 1e9 / BENCH_BYTES;
+}
+
+static double bench_spsc_bulk(size_t size, size_t burst, size_t chunk)
+{
+	SpscBuffer sb;
+	unsigned char out[SPSC_MAX_LEN];
+	double start = bench_now();
+
+	spsc_init(&sb, buf, size);
+	for (unsigned long n = 0; n < BENCH_BYTES; n += burst)
+	{
+		spsc_push_n(&sb, data, burst);
+
+		size_t got;
+		while ((got = spsc_pop_n(&sb, out, chunk)) != 0)
+			for (size_t i = 0; i < got; i++)
+				sum += out[i];
+	}
+	return (bench_now() - start) * 1e9 / BENCH_BYTES;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t size = 64, burst = 48, chunk = 16;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:b:c:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'b':
+			burst = atoi(optarg);
+			break;
+		case 'c':
+			chunk = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-s size] [-b burst] [-c chunk]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (size < 2 || size > SPSC_MAX_LEN || (size & (size - 1))
+		|| burst < 1 || burst >= size || chunk < 1 || chunk > size)
+	{
+		fprintf(stderr, "%s: invalid parameters\n", argv[0]);
+		return 1;
+	}
+
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = rand();
+
+	printf("%zu bytes FIFO, bursts of %zu bytes:\n", size, burst);
+	printf("  fifobuf locked:  %.2f ns/byte\n", bench_fifo(size, burst));
+	printf("  spsc:            %.2f ns/byte\n", bench_spsc(size, burst));
+	printf("  spsc bulk (%zu): %s%.2f ns/byte\n", chunk, chunk < 10 ? " " : "",
+		bench_spsc_bulk(size, burst, chunk));
+	return sum == 0;
+}
@@ -0,0 +1,19 @@
+#!/bin/sh
+#
+# Packet error rate vs SNR of the AFSK1200 receiver,
+# with plain AX.25 frames and with FX.25 frames.
+# Build the bench first with "make BENCH=1".
+#
+# Usage: bench/fx25_per.sh [frames] [check bytes]
+#
+
+BENCH=images/afsk_bench
+FRAMES=${1:-200}
+CHECK=${2:-16}
+
+echo "noise snr_db per_ax25 per_fx25"
+for NOISE in 12 14 16 18 20 22 24 26; do
+	PLAIN=$($BENCH -f $FRAMES -n $NOISE -x 0 | sed -n 's/.*snr: \(.*\) dB, packet error rate: \(.*\)/\1 \2/p')
+	FX25=$($BENCH -f $FRAMES -n $NOISE -x $CHECK | sed -n 's/.*packet error rate: \(.*\)/\1/p')
+	echo "$NOISE $PLAIN $FX25"
+done
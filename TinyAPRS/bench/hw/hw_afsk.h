@@ -0,0 +1,32 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief AFSK modem hardware definitions for the host benchmarks.
+ *
+ * There is no hardware here: the benchmarks call afsk_adc_isr() and
+ * afsk_dac_isr() themselves for every sample.
+ */
+
+#ifndef HW_AFSK_H
+#define HW_AFSK_H
+
+#define AFSK_ADC_INIT(ch, ctx)   do { (void)ch, (void)ctx; } while (0)
+#define AFSK_DAC_INIT(ch, ctx)   do { (void)ch, (void)ctx; } while (0)
+
+#define AFSK_DAC_IRQ_START(ch)   do { (void)ch; } while (0)
+#define AFSK_DAC_IRQ_STOP(ch)    do { (void)ch; } while (0)
+
+#define AFSK_LED_INIT()          do { } while (0)
+#define AFSK_LED_RX_ON()         do { } while (0)
+#define AFSK_LED_RX_OFF()        do { } while (0)
+#define AFSK_LED_TX_ON()         do { } while (0)
+#define AFSK_LED_TX_OFF()        do { } while (0)
+
+#endif /* HW_AFSK_H */
@@ -0,0 +1,274 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Host benchmark of the KISS serial input.
+ *
+ * Encodes random KISS data frames, then reports the throughput of the
+ * KISS decoder in frames/s and bytes/s, and simulates the serial port:
+ * the UART fills the receive ring at the baudrate while the main loop,
+ * taking a fixed time per iteration, reads either one byte per iteration
+ * (as before) or all the bytes in the ring. For each loop time it reports
+ * the frames received intact and the ring overruns.
+ *
+ * Throughput is measured on the host CPU: it shows the relative cost,
+ * not what an AVR spends.
+ *
+ * Usage: kiss_bench [-f frames] [-b baudrate] [-r ring_size] [-l loop_us]
+ */
+
+#include "cfg/cfg_ax25.h"
+#include "../TinyAPRS/cfg/cfg_ser.h"
+#include "../TinyAPRS/net/kiss_decoder.h"
+
+#include <cfg/macros.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MIN_LEN 16
+
+static uint8_t *stream;
+static size_t stream_len;
+static uint16_t *frame_len;
+static uint8_t **frame_data;
+static int frames;
+
+static uint8_t rx_buf[CONFIG_AX25_FRAME_BUF_LEN];
+static KissDecoder rx;
+
+static void bench_put(uint8_t c)
+{
+	if (c == KISS_FEND)
+	{
+		stream[stream_len++] = KISS_FESC;
+		c = KISS_TFEND;
+	}
+	else if (c == KISS_FESC)
+	{
+		stream[stream_len++] = KISS_FESC;
+		c = KISS_TFESC;
+	}
+	stream[stream_len++] = c;
+}
+
+/*
+ * KISS data frames of random length and content, command byte included,
+ * one FEND between them.
+ */
+static void bench_encode(void)
+{
+	frame_len = malloc(frames * sizeof(*frame_len));
+	frame_data = malloc(frames * sizeof(*frame_data));
+	stream = malloc(frames * (2 * sizeof(rx_buf) + 1) + 1);
+
+	stream[stream_len++] = KISS_FEND;
+	for (int i = 0; i < frames; i++)
+	{
+		uint16_t len = BENCH_MIN_LEN + rand() % (sizeof(rx_buf) - BENCH_MIN_LEN + 1);
+		uint8_t *data = malloc(len);
+
+		data[0] = 0x00;
+		for (int j = 1; j < len; j++)
+			data[j] = rand();
+		for (int j = 0; j < len; j++)
+			bench_put(data[j]);
+		stream[stream_len++] = KISS_FEND;
+
+		frame_len[i] = len;
+		frame_data[i] = data;
+	}
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_throughput(void)
+{
+	unsigned long got = 0, rounds = 0;
+	double start = bench_now(), elapsed;
+
+	do
+	{
+		kiss_decoder_init(&rx, rx_buf, sizeof(rx_buf));
+		for (size_t i = 0; i < stream_len; i++)
+			if (kiss_decoder_put(&rx, stream[i]))
+				got++;
+		rounds++;
+	} while ((elapsed = bench_now() - start) < 1.0);
+
+	printf("decoder: %.0f frames/s, %.1f Mbytes/s (%lu/%lu frames)\n",
+		got / elapsed, rounds * stream_len / elapsed / 1e6, got, rounds * frames);
+}
+
+/* UART receive ring, with the same overrun behaviour of the serial driver */
+static uint8_t ring[256];
+static int ring_size, ring_head, ring_tail, ring_cnt;
+static bool ring_err;
+
+static void ring_push(uint8_t c)
+{
+	if (ring_cnt == ring_size)
+	{
+		ring_err = true;
+		return;
+	}
+	ring[ring_tail] = c;
+	ring_tail = (ring_tail + 1) % ring_size;
+	ring_cnt++;
+}
+
+/* ser_getchar(): EOF when empty, or until the errors are cleared */
+static int ring_getchar(void)
+{
+	if (ring_cnt == 0 || ring_err)
+		return EOF;
+	uint8_t c = ring[ring_head];
+	ring_head = (ring_head + 1) % ring_size;
+	ring_cnt--;
+	return c;
+}
+
+static int next_frame, frames_ok, frames_bad;
+
+static void bench_decode(uint8_t c)
+{
+	uint16_t len = kiss_decoder_put(&rx, c);
+	if (!len)
+		return;
+
+	/* Frames lost entirely are skipped by length and content */
+	for (int i = next_frame; i < frames; i++)
+	{
+		if (len == frame_len[i] && !memcmp(rx_buf, frame_data[i], len))
+		{
+			frames_ok++;
+			next_frame = i + 1;
+			return;
+		}
+	}
+	frames_bad++;
+}
+
+/*
+ * Run the main loop every \a loop_us while the UART receives the stream
+ * at \a baudrate, reading one byte per iteration or draining the ring.
+ */
+static void bench_serial(long baudrate, int loop_us, bool drain)
+{
+	double byte_us = 10 * 1e6 / baudrate;
+	double now = 0;
+	size_t pos = 0;
+	unsigned long overruns = 0;
+
+	kiss_decoder_init(&rx, rx_buf, sizeof(rx_buf));
+	ring_head = ring_tail = ring_cnt = 0;
+	ring_err = false;
+	next_frame = frames_ok = frames_bad = 0;
+
+	while (pos < stream_len || ring_cnt)
+	{
+		now += loop_us;
+		while (pos < stream_len && pos * byte_us < now)
+			ring_push(stream[pos++]);
+
+		int c;
+		if (!drain)
+		{
+			/* The previous KISS input never cleared the errors */
+			if ((c = ring_getchar()) != EOF)
+				bench_decode(c);
+			else if (ring_err)
+			{
+				overruns++;
+				break;
+			}
+			continue;
+		}
+
+		while ((c = ring_getchar()) != EOF)
+			bench_decode(c);
+
+		if (ring_err)
+		{
+			int n = ring_cnt;
+
+			overruns++;
+			ring_err = false;
+			while (n-- > 0 && (c = ring_getchar()) != EOF)
+				bench_decode(c);
+			kiss_decoder_drop(&rx);
+		}
+	}
+
+	printf("  %s, loop %5dus: %5d/%d frames, %d corrupted, %lu overruns%s\n",
+		drain ? "drain" : "1 byte", loop_us, frames_ok, frames, frames_bad, overruns,
+		(!drain && ring_err) ? ", input stalled at the first overrun" : "");
+}
+
+int main(int argc, char *argv[])
+{
+	long baudrate = 115200;
+	int loop_us = 0;
+	int opt;
+
+	frames = 1000;
+	ring_size = CONFIG_UART0_RXBUFSIZE;
+
+	while ((opt = getopt(argc, argv, "f:b:r:l:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f':
+			frames = atoi(optarg);
+			break;
+		case 'b':
+			baudrate = atol(optarg);
+			break;
+		case 'r':
+			ring_size = atoi(optarg);
+			break;
+		case 'l':
+			loop_us = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-f frames] [-b baudrate] [-r ring_size] [-l loop_us]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (frames < 1 || baudrate < 1 || ring_size < 2 || ring_size > (int)sizeof(ring))
+	{
+		fprintf(stderr, "%s: invalid parameters\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	bench_encode();
+	printf("%d frames, %zu bytes\n", frames, stream_len);
+	bench_throughput();
+
+	printf("serial %ld baud, %d bytes ring:\n", baudrate, ring_size);
+	static const int loops[] = { 50, 100, 500, 2000, 5000, 10000 };
+	for (int i = 0; i < (int)countof(loops); i++)
+	{
+		int us = loop_us ? loop_us : loops[i];
+		bench_serial(baudrate, us, false);
+		bench_serial(baudrate, us, true);
+		if (loop_us)
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,445 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Host benchmark of the packet error rate vs Eb/N0.
+ *
+ * Frames of random content are sent with ax25_sendRaw() through the
+ * firmware modulator, passed through a channel model, then decoded by
+ * the firmware demodulator and AX25 receiver, for each Eb/N0 of a sweep.
+ * The channel applies, in this order:
+ * \li a twist of -t dB, the space tone scaled down against the mark tone;
+ * \li with -d, the 75us deemphasis of an FM receiver (-6dB/octave
+ *     above 2.1kHz);
+ * \li a frequency offset of -o Hz, as a mistuned SSB receiver would,
+ *     shifting both tones;
+ * \li white gaussian noise, calibrated from the power of the signal
+ *     out of the previous steps, taking Eb as the signal energy in
+ *     the 1/1200s of a bit on air and N0 over the 4.8kHz band of the
+ *     sample rate. With -F, the noise of an FM discriminator instead,
+ *     rising 6dB/octave with the same power, and going through the
+ *     deemphasis with the signal.
+ *
+ * A frame is counted as received if a frame with the same content is
+ * delivered, corrupted if a different frame passed the CRC check (a
+ * wrong CRC repair, or an undetected error).
+ *
+ * The discriminator filter and clock recovery loop are chosen at build
+ * time: a binary is built for each configuration, see bench/snr_sweep.sh
+ * to run them all. Results are printed as tab separated values, one line
+ * per Eb/N0, after a header line unless -H is given.
+ *
+ * Usage: snr_bench [-f frames] [-l info_len] [-e from:to:step] [-t twist_db] [-d] [-o offset_hz] [-F] [-s seed] [-H]
+ */
+
+#include "cfg/cfg_afsk.h"
+#include "cfg/cfg_ax25.h"
+
+#include <net/afsk.h>
+#include <net/ax25.h>
+#include <drv/timer.h>
+#include <cfg/debug.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static Afsk rx_afsk;
+static AX25Ctx rx_ax25;
+
+static Afsk tx_afsk;
+static AX25Ctx tx_ax25;
+
+static unsigned long samples;
+static uint16_t mark_inc;
+
+/* Frame being sent, FCS excluded, and how it was received */
+static uint8_t sent[CONFIG_AX25_FRAME_BUF_LEN];
+static size_t sent_len;
+static unsigned long received, corrupted;
+
+static const char *bench_filter(void)
+{
+#if CONFIG_AFSK_FILTER == AFSK_BUTTERWORTH
+	return "butterworth";
+#elif CONFIG_AFSK_FILTER == AFSK_CHEBYSHEV
+	return "chebyshev";
+#else
+	return "fir";
+#endif
+}
+
+static const char *bench_pll(void)
+{
+#if CONFIG_AFSK_PLL == AFSK_PLL_PI
+	return "pi";
+#else
+	return "simple";
+#endif
+}
+
+static void bench_hook(struct AX25Msg *msg)
+{
+	const AX25Frame *frame = rx_ax25.frame;
+	(void)msg;
+
+	if (frame->len == sent_len + 2 && !memcmp(frame->buf, sent, sent_len))
+		received++;
+	else
+		corrupted++;
+}
+
+static void bench_txHook(struct AX25Msg *msg)
+{
+	(void)msg;
+}
+
+/* Samples received by the ADC ISR between two main loop iterations */
+#define BENCH_POLL_SAMPLES 32
+
+static void bench_poll(void)
+{
+	ax25_poll(&rx_ax25);
+#if CONFIG_AX25_RX_QUEUE
+	while (ax25_rxDeliver(&rx_ax25))
+		;
+#endif
+}
+
+/* Samples are given on the 8 bit scale, the ADC input may have more bits */
+#define BENCH_ADC_SCALE (1L << (AFSK_SAMPLE_BITS - 8))
+
+/*
+ * Feed a sample to the ADC ISR, then let the main loop poll the
+ * frames every few samples. The timer ISR is simulated to keep the
+ * clock going at the sample rate.
+ */
+static void bench_sample(double s)
+{
+	afsk_adc_isr(&rx_afsk, (afsk_sample_t)MINMAX(-128 * BENCH_ADC_SCALE, lrint(s * BENCH_ADC_SCALE), 128 * BENCH_ADC_SCALE - 1));
+	if (samples % BENCH_POLL_SAMPLES == 0)
+		bench_poll();
+
+	if (++samples % (SAMPLERATE / TIMER_TICKS_PER_SEC) == 0)
+		_clock++;
+}
+
+/*
+ * Return the receive buffers of the previous run to the frame arena,
+ * ax25_init() doesn't.
+ */
+static void bench_release(void)
+{
+	if (rx_ax25.rx_frame)
+		ax25_frameRelease(rx_ax25.rx_frame);
+#if CONFIG_AX25_RX_CHANNELS > 1
+	for (int i = 0; i < rx_ax25.rx_cnt; i++)
+		if (rx_ax25.rx[i].rx_frame)
+			ax25_frameRelease(rx_ax25.rx[i].rx_frame);
+#endif
+}
+
+static void bench_reset(void)
+{
+	bench_release();
+	afsk_init(&rx_afsk, 0, 0);
+	ax25_init(&rx_ax25, &rx_afsk.fd, bench_hook);
+#if CONFIG_AX25_CRC_FIX
+	rx_ax25.weak_bits = afsk_weakBits;
+#endif
+#if CONFIG_AFSK_SLICERS > 1
+	for (int i = 0; i < CONFIG_AFSK_SLICERS - 1; i++)
+		ax25_addRxChannel(&rx_ax25, afsk_slicerChannel(&rx_afsk, i));
+#endif
+#if CONFIG_AFSK_FX25
+	ax25_addRxChannel(&rx_ax25, afsk_fx25Channel(&rx_afsk));
+#endif
+	samples = 0;
+	received = corrupted = 0;
+}
+
+/* Gaussian noise, Box-Muller */
+static double bench_noise(void)
+{
+	double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static const AX25Call bench_path[] = AX25_PATH(AX25_CALL("APZTA", 0), AX25_CALL("BENCH", 1), AX25_CALL("WIDE1", 1));
+
+/*
+ * The frame from the bench station with \a len bytes of random info, as
+ * it should be received: the bit stuffing and the tones vary from frame
+ * to frame.
+ */
+static void bench_build(uint8_t *info, int len)
+{
+	uint8_t *p = sent;
+
+	for (size_t i = 0; i < countof(bench_path); i++, p += AX25_CALL_LEN)
+		ax25_encodeCall(p, &bench_path[i], i == countof(bench_path) - 1, false);
+	*p++ = AX25_CTRL_UI;
+	*p++ = AX25_PID_NOLAYER3;
+	for (int i = 0; i < len; i++)
+		*p++ = info[i] = rand();
+	sent_len = p - sent;
+}
+
+/* The channel model, see the file description */
+typedef struct BenchChannel
+{
+	double space_gain;    // twist
+	double deemph;        // pole of the deemphasis filter, 0 if off
+	double offset;        // frequency offset, radians per sample
+	double *hilbert;      // taps of the Hilbert transformer for the offset
+	int hilbert_len;
+	bool fm_noise;        // noise of an FM discriminator
+	double noise_prev;    // previous white noise sample
+	double noise_y;       // deemphasis filter state of the noise
+} BenchChannel;
+
+/* Deemphasis time constant, 75us */
+#define BENCH_DEEMPH_TAU 75e-6
+/* Taps of the Hilbert transformer, odd */
+#define BENCH_HILBERT_TAPS 63
+
+static void bench_channelInit(BenchChannel *ch, double twist_db, bool deemph, double offset_hz, bool fm_noise)
+{
+	ch->fm_noise = fm_noise;
+	ch->noise_prev = ch->noise_y = 0;
+	ch->space_gain = pow(10, -twist_db / 20);
+	ch->deemph = deemph ? exp(-1.0 / (SAMPLERATE * BENCH_DEEMPH_TAU)) : 0;
+	ch->offset = 2 * M_PI * offset_hz / SAMPLERATE;
+	ch->hilbert_len = BENCH_HILBERT_TAPS;
+	ch->hilbert = calloc(BENCH_HILBERT_TAPS, sizeof(*ch->hilbert));
+
+	/* Hamming windowed ideal Hilbert transformer, 2/(pi n) on the odd taps */
+	for (int i = 0; i < BENCH_HILBERT_TAPS; i++)
+	{
+		int n = i - BENCH_HILBERT_TAPS / 2;
+		if (n & 1)
+			ch->hilbert[i] = 2 / (M_PI * n)
+				* (0.54 + 0.46 * cos(2 * M_PI * n / (BENCH_HILBERT_TAPS - 1)));
+	}
+}
+
+/*
+ * Modulate the frame with \a len bytes of \a info with the firmware
+ * modulator and pass it through the channel, noise excepted.
+ * \return the number of samples in \a out, reallocated as needed.
+ */
+static size_t bench_modulate(const BenchChannel *ch, const uint8_t *info, int len, double **out, size_t *size)
+{
+	size_t count = 0;
+	double y = 0;
+
+	ax25_sendVia(&tx_ax25, bench_path, countof(bench_path), info, len);
+	/* Some silence after the frame, for the Hilbert transformer */
+	for (int tail = ch->hilbert_len; tx_afsk.sending || tail--; )
+	{
+		double s = 0;
+		if (tx_afsk.sending)
+		{
+			bool mark = tx_afsk.phase_inc == mark_inc;
+			s = ((int)afsk_dac_isr(&tx_afsk) - 128) / 2.0;
+			if (!mark)
+				s *= ch->space_gain;
+		}
+		if (ch->deemph)
+			s = y = ch->deemph * y + (1 - ch->deemph) * s;
+
+		if (count == *size)
+		{
+			*size = *size ? 2 * *size : 16384;
+			*out = realloc(*out, *size * sizeof(**out));
+		}
+		(*out)[count++] = s;
+	}
+
+	size_t n = count - ch->hilbert_len;
+	if (ch->offset == 0)
+		return n;
+
+	/*
+	 * Shift the analytic signal, the quadrature part being the output
+	 * of the Hilbert transformer centered on each sample.
+	 */
+	double *x = *out;
+	int half = ch->hilbert_len / 2;
+	double *shifted = malloc(n * sizeof(*shifted));
+	for (size_t i = 0; i < n; i++)
+	{
+		double q = 0;
+		for (int j = 0; j < ch->hilbert_len; j++)
+		{
+			long k = (long)i + half - j;
+			if (k >= 0)
+				q += ch->hilbert[j] * x[k];
+		}
+		double phase = ch->offset * i;
+		shifted[i] = x[i] * cos(phase) - q * sin(phase);
+	}
+	memcpy(x, shifted, n * sizeof(*x));
+	free(shifted);
+	return n;
+}
+
+/*
+ * Next noise sample of the channel, of unit power before the deemphasis:
+ * white, or the first difference of white noise for an FM discriminator.
+ */
+static double bench_channelNoise(BenchChannel *ch)
+{
+	double w = bench_noise();
+
+	if (!ch->fm_noise)
+		return w;
+
+	double n = (w - ch->noise_prev) / M_SQRT2;
+	ch->noise_prev = w;
+	if (ch->deemph)
+		n = ch->noise_y = ch->deemph * ch->noise_y + (1 - ch->deemph) * n;
+	return n;
+}
+
+/*
+ * Noise between the transmissions, with a random length so that every
+ * frame starts at a different bit phase.
+ */
+static void bench_gap(BenchChannel *ch, double sigma)
+{
+	int gap = SAMPLERATE / 10 + rand() % SAMPLEPERBIT;
+	for (int i = 0; i < gap; i++)
+		bench_sample(sigma * bench_channelNoise(ch));
+}
+
+/* Bit rate on air */
+#define BENCH_BITRATE 1200
+
+/*
+ * Send \a frames frames at \a ebn0_db, with \a len bytes of info.
+ */
+static void bench_point(BenchChannel *ch, int frames, int len, double ebn0_db)
+{
+	static double *buf;
+	static size_t size;
+	uint8_t info[CONFIG_AX25_FRAME_BUF_LEN];
+
+	bench_reset();
+	for (int f = 0; f < frames; f++)
+	{
+		bench_build(info, len);
+		size_t n = bench_modulate(ch, info, len, &buf, &size);
+
+		double power = 0;
+		for (size_t i = 0; i < n; i++)
+			power += buf[i] * buf[i];
+		power /= n;
+
+		/* Eb = P / bitrate, N0 = sigma^2 / (samplerate / 2) */
+		double sigma = sqrt(power * SAMPLERATE / 2 / BENCH_BITRATE / pow(10, ebn0_db / 10));
+
+		bench_gap(ch, sigma);
+		unsigned long before = received;
+		for (size_t i = 0; i < n; i++)
+			bench_sample(buf[i] + sigma * bench_channelNoise(ch));
+		bench_gap(ch, sigma);
+		bench_poll();
+		/* Only one copy of the frame counts */
+		received = MIN(received, before + 1);
+	}
+}
+
+static void bench_usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-f frames] [-l info_len] [-e from:to:step] [-t twist_db] [-d] [-o offset_hz] [-F] [-s seed] [-H]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 200, len = 64;
+	double from = 4, to = 16, step = 1;
+	double twist_db = 0, offset_hz = 0;
+	bool deemph = false, fm_noise = false, header = true;
+	unsigned seed = 1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:l:e:t:do:Fs:H")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f':
+			frames = atoi(optarg);
+			break;
+		case 'l':
+			len = atoi(optarg);
+			break;
+		case 'e':
+			if (sscanf(optarg, "%lf:%lf:%lf", &from, &to, &step) != 3)
+			{
+				bench_usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 't':
+			twist_db = atof(optarg);
+			break;
+		case 'd':
+			deemph = true;
+			break;
+		case 'o':
+			offset_hz = atof(optarg);
+			break;
+		case 'F':
+			fm_noise = true;
+			break;
+		case 's':
+			seed = atoi(optarg);
+			break;
+		case 'H':
+			header = false;
+			break;
+		default:
+			bench_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (frames < 1 || len < 0 || len > CONFIG_AX25_FRAME_BUF_LEN - 2 - 23 || step <= 0 || to < from)
+	{
+		fprintf(stderr, "%s: invalid parameters\n", argv[0]);
+		return 1;
+	}
+
+	BenchChannel ch;
+	bench_channelInit(&ch, twist_db, deemph, offset_hz, fm_noise);
+
+	afsk_init(&tx_afsk, 0, 0);
+	ax25_init(&tx_ax25, &tx_afsk.fd, bench_txHook);
+	mark_inc = tx_afsk.phase_inc;
+
+	if (header)
+		printf("filter\tpll\tslicers\tinfo_len\ttwist_db\tdeemph\toffset_hz\tfm_noise\tebn0_db\tframes\treceived\tcorrupted\tper\n");
+	for (int i = 0; from + i * step <= to + step / 1000; i++)
+	{
+		double ebn0_db = from + i * step;
+
+		/* Each point gets the same frames and noise whatever the sweep */
+		srand(seed * 7919 + lrint(ebn0_db * 100));
+		bench_point(&ch, frames, len, ebn0_db);
+		printf("%s\t%s\t%d\t%d\t%.1f\t%d\t%.1f\t%d\t%.1f\t%d\t%lu\t%lu\t%.4f\n",
+			bench_filter(), bench_pll(), CONFIG_AFSK_SLICERS, len, twist_db, deemph, offset_hz, fm_noise,
+			ebn0_db, frames, received, corrupted, (double)(frames - (long)received) / frames);
+		fflush(stdout);
+	}
+	free(ch.hilbert);
+	return 0;
+}
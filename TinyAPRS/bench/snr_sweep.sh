@@ -0,0 +1,16 @@
+#!/bin/sh
+#
+# Packet error rate vs Eb/N0 of each discriminator filter and clock
+# recovery loop, as a TSV table, through the same channel: the options
+# are passed to snr_bench (e.g. -t 6 for twist, -d for deemphasis,
+# -o 50 for a frequency offset, -F for the noise of an FM discriminator).
+# Build the benches first with "make BENCH=1".
+#
+# Usage: bench/snr_sweep.sh [snr_bench options]
+#
+
+HEADER=
+for BENCH in snr_bench snr_bench_butterworth snr_bench_fir snr_bench_simple; do
+	images/$BENCH $HEADER "$@" || exit 1
+	HEADER=-H
+done
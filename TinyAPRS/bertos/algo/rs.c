@@ -0,0 +1,268 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Reed-Solomon encoder and decoder (Berlekamp-Massey, Chien search, Forney).
+ */
+
+#include "rs.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+#include <cpu/pgm.h>
+
+#include <string.h>
+
+/* log(0) */
+#define A0 RS_NN
+
+/* Powers of alpha, alpha_to[A0] = 0 */
+static const uint8_t PROGMEM alpha_to[256] = {
+	0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26,
+	0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0,
+	0x9d, 0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23,
+	0x46, 0x8c, 0x05, 0x0a, 0x14, 0x28, 0x50, 0xa0, 0x5d, 0xba, 0x69, 0xd2, 0xb9, 0x6f, 0xde, 0xa1,
+	0x5f, 0xbe, 0x61, 0xc2, 0x99, 0x2f, 0x5e, 0xbc, 0x65, 0xca, 0x89, 0x0f, 0x1e, 0x3c, 0x78, 0xf0,
+	0xfd, 0xe7, 0xd3, 0xbb, 0x6b, 0xd6, 0xb1, 0x7f, 0xfe, 0xe1, 0xdf, 0xa3, 0x5b, 0xb6, 0x71, 0xe2,
+	0xd9, 0xaf, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0d, 0x1a, 0x34, 0x68, 0xd0, 0xbd, 0x67, 0xce,
+	0x81, 0x1f, 0x3e, 0x7c, 0xf8, 0xed, 0xc7, 0x93, 0x3b, 0x76, 0xec, 0xc5, 0x97, 0x33, 0x66, 0xcc,
+	0x85, 0x17, 0x2e, 0x5c, 0xb8, 0x6d, 0xda, 0xa9, 0x4f, 0x9e, 0x21, 0x42, 0x84, 0x15, 0x2a, 0x54,
+	0xa8, 0x4d, 0x9a, 0x29, 0x52, 0xa4, 0x55, 0xaa, 0x49, 0x92, 0x39, 0x72, 0xe4, 0xd5, 0xb7, 0x73,
+	0xe6, 0xd1, 0xbf, 0x63, 0xc6, 0x91, 0x3f, 0x7e, 0xfc, 0xe5, 0xd7, 0xb3, 0x7b, 0xf6, 0xf1, 0xff,
+	0xe3, 0xdb, 0xab, 0x4b, 0x96, 0x31, 0x62, 0xc4, 0x95, 0x37, 0x6e, 0xdc, 0xa5, 0x57, 0xae, 0x41,
+	0x82, 0x19, 0x32, 0x64, 0xc8, 0x8d, 0x07, 0x0e, 0x1c, 0x38, 0x70, 0xe0, 0xdd, 0xa7, 0x53, 0xa6,
+	0x51, 0xa2, 0x59, 0xb2, 0x79, 0xf2, 0xf9, 0xef, 0xc3, 0x9b, 0x2b, 0x56, 0xac, 0x45, 0x8a, 0x09,
+	0x12, 0x24, 0x48, 0x90, 0x3d, 0x7a, 0xf4, 0xf5, 0xf7, 0xf3, 0xfb, 0xeb, 0xcb, 0x8b, 0x0b, 0x16,
+	0x2c, 0x58, 0xb0, 0x7d, 0xfa, 0xe9, 0xcf, 0x83, 0x1b, 0x36, 0x6c, 0xd8, 0xad, 0x47, 0x8e, 0x00,
+};
+
+/* Logarithms, index_of[0] = A0 */
+static const uint8_t PROGMEM index_of[256] = {
+	0xff, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6, 0x03, 0xdf, 0x33, 0xee, 0x1b, 0x68, 0xc7, 0x4b,
+	0x04, 0x64, 0xe0, 0x0e, 0x34, 0x8d, 0xef, 0x81, 0x1c, 0xc1, 0x69, 0xf8, 0xc8, 0x08, 0x4c, 0x71,
+	0x05, 0x8a, 0x65, 0x2f, 0xe1, 0x24, 0x0f, 0x21, 0x35, 0x93, 0x8e, 0xda, 0xf0, 0x12, 0x82, 0x45,
+	0x1d, 0xb5, 0xc2, 0x7d, 0x6a, 0x27, 0xf9, 0xb9, 0xc9, 0x9a, 0x09, 0x78, 0x4d, 0xe4, 0x72, 0xa6,
+	0x06, 0xbf, 0x8b, 0x62, 0x66, 0xdd, 0x30, 0xfd, 0xe2, 0x98, 0x25, 0xb3, 0x10, 0x91, 0x22, 0x88,
+	0x36, 0xd0, 0x94, 0xce, 0x8f, 0x96, 0xdb, 0xbd, 0xf1, 0xd2, 0x13, 0x5c, 0x83, 0x38, 0x46, 0x40,
+	0x1e, 0x42, 0xb6, 0xa3, 0xc3, 0x48, 0x7e, 0x6e, 0x6b, 0x3a, 0x28, 0x54, 0xfa, 0x85, 0xba, 0x3d,
+	0xca, 0x5e, 0x9b, 0x9f, 0x0a, 0x15, 0x79, 0x2b, 0x4e, 0xd4, 0xe5, 0xac, 0x73, 0xf3, 0xa7, 0x57,
+	0x07, 0x70, 0xc0, 0xf7, 0x8c, 0x80, 0x63, 0x0d, 0x67, 0x4a, 0xde, 0xed, 0x31, 0xc5, 0xfe, 0x18,
+	0xe3, 0xa5, 0x99, 0x77, 0x26, 0xb8, 0xb4, 0x7c, 0x11, 0x44, 0x92, 0xd9, 0x23, 0x20, 0x89, 0x2e,
+	0x37, 0x3f, 0xd1, 0x5b, 0x95, 0xbc, 0xcf, 0xcd, 0x90, 0x87, 0x97, 0xb2, 0xdc, 0xfc, 0xbe, 0x61,
+	0xf2, 0x56, 0xd3, 0xab, 0x14, 0x2a, 0x5d, 0x9e, 0x84, 0x3c, 0x39, 0x53, 0x47, 0x6d, 0x41, 0xa2,
+	0x1f, 0x2d, 0x43, 0xd8, 0xb7, 0x7b, 0xa4, 0x76, 0xc4, 0x17, 0x49, 0xec, 0x7f, 0x0c, 0x6f, 0xf6,
+	0x6c, 0xa1, 0x3b, 0x52, 0x29, 0x9d, 0x55, 0xaa, 0xfb, 0x60, 0x86, 0xb1, 0xbb, 0xcc, 0x3e, 0x5a,
+	0xcb, 0x59, 0x5f, 0xb0, 0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
+	0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea, 0xa8, 0x50, 0x58, 0xaf,
+};
+
+#define ALPHA(x) pgm_read8(&alpha_to[(x)])
+#define INDEX(x) pgm_read8(&index_of[(x)])
+
+INLINE uint8_t modnn(unsigned x)
+{
+	while (x >= RS_NN)
+	{
+		x -= RS_NN;
+		x = (x >> 8) + (x & RS_NN);
+	}
+	return x;
+}
+
+/**
+ * Compute the code generator polynomial for \a nroots parity symbols.
+ * \param genpoly where to put the nroots + 1 coefficients, in log form.
+ * \param nroots number of parity symbols.
+ */
+void rs_genpoly(uint8_t *genpoly, uint8_t nroots)
+{
+	ASSERT(nroots <= RS_MAX_ROOTS);
+
+	genpoly[0] = 1;
+	for (uint8_t i = 0; i < nroots; i++)
+	{
+		/* Multiply by (x + alpha^(i + 1)) */
+		genpoly[i + 1] = 1;
+		for (uint8_t j = i; j > 0; j--)
+		{
+			if (genpoly[j])
+				genpoly[j] = genpoly[j - 1] ^ ALPHA(modnn(INDEX(genpoly[j]) + i + 1));
+			else
+				genpoly[j] = genpoly[j - 1];
+		}
+		genpoly[0] = ALPHA(modnn(INDEX(genpoly[0]) + i + 1));
+	}
+
+	for (uint8_t i = 0; i <= nroots; i++)
+		genpoly[i] = INDEX(genpoly[i]);
+}
+
+/**
+ * Add \a len data bytes to the parity being computed.
+ * \param genpoly generator polynomial from rs_genpoly().
+ * \param nroots number of parity symbols.
+ * \param data data bytes, NULL to add zeros.
+ * \param len number of data bytes.
+ * \param parity parity symbols, to be cleared before the first byte.
+ */
+void rs_encode(const uint8_t *genpoly, uint8_t nroots, const uint8_t *data, size_t len, uint8_t *parity)
+{
+	while (len--)
+	{
+		uint8_t feedback = INDEX((data ? *data++ : 0) ^ parity[0]);
+
+		if (feedback != A0)
+			for (uint8_t j = 1; j < nroots; j++)
+				parity[j] ^= ALPHA(modnn(feedback + genpoly[nroots - j]));
+
+		memmove(&parity[0], &parity[1], nroots - 1);
+		parity[nroots - 1] = (feedback != A0) ? ALPHA(modnn(feedback + genpoly[0])) : 0;
+	}
+}
+
+/**
+ * Correct the errors of a codeword.
+ * \param block the RS_NN bytes of the codeword, corrected in place.
+ * \param nroots number of parity symbols, at the end of \a block.
+ * \return the number of corrected bytes, -1 if there are too many errors.
+ */
+int rs_decode(uint8_t *block, uint8_t nroots)
+{
+	uint8_t s[RS_MAX_ROOTS];
+	uint8_t lambda[RS_MAX_ROOTS + 1], b[RS_MAX_ROOTS + 1], t[RS_MAX_ROOTS + 1];
+	uint8_t omega[RS_MAX_ROOTS + 1];
+	uint8_t root[RS_MAX_ROOTS], loc[RS_MAX_ROOTS];
+	uint8_t syn_error = 0;
+
+	ASSERT(nroots <= RS_MAX_ROOTS);
+
+	/* Syndromes, evaluating the block at the roots of the generator */
+	for (uint8_t i = 0; i < nroots; i++)
+		s[i] = block[0];
+
+	for (unsigned j = 1; j < RS_NN; j++)
+		for (uint8_t i = 0; i < nroots; i++)
+			s[i] = s[i] ? block[j] ^ ALPHA(modnn(INDEX(s[i]) + i + 1)) : block[j];
+
+	for (uint8_t i = 0; i < nroots; i++)
+	{
+		syn_error |= s[i];
+		s[i] = INDEX(s[i]);
+	}
+
+	if (!syn_error)
+		return 0;
+
+	/* Berlekamp-Massey, error locator polynomial */
+	memset(&lambda[1], 0, nroots);
+	lambda[0] = 1;
+	for (uint8_t i = 0; i <= nroots; i++)
+		b[i] = INDEX(lambda[i]);
+
+	uint8_t el = 0;
+	for (uint8_t r = 1; r <= nroots; r++)
+	{
+		uint8_t discr_r = 0;
+		for (uint8_t i = 0; i < r; i++)
+			if (lambda[i] && s[r - i - 1] != A0)
+				discr_r ^= ALPHA(modnn(INDEX(lambda[i]) + s[r - i - 1]));
+		discr_r = INDEX(discr_r);
+
+		if (discr_r == A0)
+		{
+			memmove(&b[1], b, nroots);
+			b[0] = A0;
+			continue;
+		}
+
+		t[0] = lambda[0];
+		for (uint8_t i = 0; i < nroots; i++)
+			t[i + 1] = (b[i] != A0) ? lambda[i + 1] ^ ALPHA(modnn(discr_r + b[i])) : lambda[i + 1];
+
+		if (2 * el <= r - 1)
+		{
+			el = r - el;
+			for (uint8_t i = 0; i <= nroots; i++)
+				b[i] = lambda[i] ? modnn(INDEX(lambda[i]) - discr_r + RS_NN) : A0;
+		}
+		else
+		{
+			memmove(&b[1], b, nroots);
+			b[0] = A0;
+		}
+		memcpy(lambda, t, nroots + 1);
+	}
+
+	uint8_t deg_lambda = 0;
+	for (uint8_t i = 0; i <= nroots; i++)
+	{
+		lambda[i] = INDEX(lambda[i]);
+		if (lambda[i] != A0)
+			deg_lambda = i;
+	}
+
+	/* Chien search, roots of the error locator */
+	uint8_t count = 0;
+	memcpy(&t[1], &lambda[1], nroots);
+	for (unsigned i = 1; i <= RS_NN; i++)
+	{
+		uint8_t q = 1;
+		for (uint8_t j = deg_lambda; j > 0; j--)
+		{
+			if (t[j] != A0)
+			{
+				t[j] = modnn(t[j] + j);
+				q ^= ALPHA(t[j]);
+			}
+		}
+		if (q)
+			continue;
+
+		root[count] = i;
+		loc[count] = i - 1;
+		if (++count == deg_lambda)
+			break;
+	}
+
+	if (count != deg_lambda)
+		return -1;
+
+	/* Error evaluator polynomial */
+	uint8_t deg_omega = deg_lambda - 1;
+	for (uint8_t i = 0; i <= deg_omega; i++)
+	{
+		uint8_t tmp = 0;
+		for (int j = i; j >= 0; j--)
+			if (s[i - j] != A0 && lambda[j] != A0)
+				tmp ^= ALPHA(modnn(s[i - j] + lambda[j]));
+		omega[i] = INDEX(tmp);
+	}
+
+	/* Forney, error values */
+	for (int j = count - 1; j >= 0; j--)
+	{
+		uint8_t num = 0;
+		for (int i = deg_omega; i >= 0; i--)
+			if (omega[i] != A0)
+				num ^= ALPHA(modnn(omega[i] + i * root[j]));
+
+		uint8_t den = 0;
+		for (int i = MIN((int)deg_lambda, nroots - 1) & ~1; i >= 0; i -= 2)
+			if (lambda[i + 1] != A0)
+				den ^= ALPHA(modnn(lambda[i + 1] + i * root[j]));
+
+		if (!den)
+			return -1;
+
+		if (num)
+			block[loc[j]] ^= ALPHA(modnn(INDEX(num) + RS_NN - INDEX(den)));
+	}
+
+	return count;
+}
@@ -0,0 +1,39 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief Reed-Solomon codes over GF(2^8).
+ *
+ * Field generator polynomial 0x11d, first consecutive root of the code
+ * generator alpha^1, 255 symbols codeword: the codes used by FX.25.
+ * Shortened codes are handled by the caller, padding the data with
+ * zeros up to 255 - nroots bytes.
+ *
+ * The codeword is in transmission order, the first data byte is the
+ * coefficient of the highest power.
+ *
+ * $WIZ$ module_name = "rs"
+ */
+
+#ifndef ALGO_RS_H
+#define ALGO_RS_H
+
+#include <cfg/compiler.h>
+
+/** Symbols in a codeword */
+#define RS_NN 255
+
+/** Maximum number of parity symbols supported */
+#define RS_MAX_ROOTS 64
+
+void rs_genpoly(uint8_t *genpoly, uint8_t nroots);
+void rs_encode(const uint8_t *genpoly, uint8_t nroots, const uint8_t *data, size_t len, uint8_t *parity);
+int rs_decode(uint8_t *block, uint8_t nroots);
+
+#endif /* ALGO_RS_H */
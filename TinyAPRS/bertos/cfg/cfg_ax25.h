@@ -72,4 +72,81 @@
  */
 #define CONFIG_AX25_RPT_LST 1
 
+/**
+ * Number of receive channels polled by ax25_poll().
+ * Channels beyond the first one are added with ax25_addRxChannel(),
+ * frames received by more than a channel are delivered once.
+ * Each additional channel takes CONFIG_AX25_FRAME_BUF_LEN + 10 bytes of RAM.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_AX25_RX_CHANNELS 1
+
+/**
+ * Try to repair the frames received with a wrong CRC on the main
+ * channel, flipping single bits, pairs of adjacent bits and pairs of
+ * the low confidence bits marked by the demodulator.
+ * Repaired frames must still look like APRS frames to be delivered.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AX25_CRC_FIX 0
+
+/**
+ * Maximum number of bits, counted from the end of the frame,
+ * searched by the CRC repair of a frame. Bounds the time spent
+ * on each broken frame.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 16
+ */
+#define CONFIG_AX25_CRC_FIX_BUDGET 2048
+
+/**
+ * Number of frames in the transmit queue, 0 to disable it.
+ * Frames sent with ax25_queueVia(), ax25_queueRaw() and ax25_queueMsg()
+ * are written to the channel by ax25_poll() as long as it has room,
+ * so the main loop doesn't wait for the modem, and a callback is
+ * called when each one has been sent.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_AX25_TX_QUEUE 0
+
+/**
+ * Room for the data of the queued frames, FCS excluded.
+ * Each frame of the queue takes 10 more bytes on AVR.
+ * Frames that don't fit are copied in a free frame buffer, see
+ * CONFIG_AX25_FRAMES; 0 to always do so.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_AX25_TX_BUF_LEN 330
+
+/**
+ * Number of received frames queued for ax25_rxDeliver(), 0 to pass
+ * them to the hook from ax25_poll() instead.
+ * With the queue a slow hook doesn't hold up the channel: the frames
+ * received meanwhile are queued, or dropped and counted when it is full.
+ * Each queued frame holds a buffer of CONFIG_AX25_FRAMES.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_AX25_RX_QUEUE 0
+
+/**
+ * Number of frame buffers, CONFIG_AX25_FRAME_BUF_LEN + 7 bytes each.
+ * Each receive channel holds one while receiving, the frames received
+ * are delivered in it and can be queued for transmission without
+ * copying them (see ax25_queueFrame()).
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_AX25_FRAMES (CONFIG_AX25_RX_CHANNELS + CONFIG_AX25_RX_QUEUE)
+
 #endif /* CFG_AX25_H */
@@ -342,6 +342,15 @@
  */
 #define CONFIG_SER_DEFBAUDRATE   0UL
 
+/**
+ * Use lock-free rings (see struct/spscbuf.h) for the serial FIFOs instead
+ * of the FIFOBuffer, so that the main loop doesn't mask the interrupts for
+ * each char. The buffer sizes must then be powers of 2, up to 128.
+ * $WIZ$ type = "boolean"
+ * $WIZ$ supports = "avr and not xmega"
+ */
+#define CONFIG_SER_SPSC          0
+
 /// Enable strobe pin for debugging serial interrupt. $WIZ$ type = "boolean"
 #define CONFIG_SER_STROBE        0
 
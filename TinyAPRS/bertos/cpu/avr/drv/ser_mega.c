@@ -439,6 +439,24 @@ static unsigned char spi_txbuffer[CONFIG_SPI_TXBUFSIZE];
 static unsigned char spi_rxbuffer[CONFIG_SPI_RXBUFSIZE];
 #endif
 
+#if CONFIG_SER_SPSC
+	#define SER_SPSC_SIZE_OK(size)  ((size) <= SPSC_MAX_LEN && !((size) & ((size) - 1)))
+
+	STATIC_ASSERT(SER_SPSC_SIZE_OK(CONFIG_UART0_TXBUFSIZE) && SER_SPSC_SIZE_OK(CONFIG_UART0_RXBUFSIZE));
+	#if AVR_HAS_UART1 && CONFIG_UART1_ENABLED
+		STATIC_ASSERT(SER_SPSC_SIZE_OK(CONFIG_UART1_TXBUFSIZE) && SER_SPSC_SIZE_OK(CONFIG_UART1_RXBUFSIZE));
+	#endif
+	#if AVR_HAS_UART2 && CONFIG_UART2_ENABLED
+		STATIC_ASSERT(SER_SPSC_SIZE_OK(CONFIG_UART2_TXBUFSIZE) && SER_SPSC_SIZE_OK(CONFIG_UART2_RXBUFSIZE));
+	#endif
+	#if AVR_HAS_UART3 && CONFIG_UART3_ENABLED
+		STATIC_ASSERT(SER_SPSC_SIZE_OK(CONFIG_UART3_TXBUFSIZE) && SER_SPSC_SIZE_OK(CONFIG_UART3_RXBUFSIZE));
+	#endif
+	#if CONFIG_SPI_ENABLED
+		STATIC_ASSERT(SER_SPSC_SIZE_OK(CONFIG_SPI_TXBUFSIZE) && SER_SPSC_SIZE_OK(CONFIG_SPI_RXBUFSIZE));
+	#endif
+#endif
+
 /**
  * Internal hardware state structure
  *
@@ -764,10 +782,10 @@ static void spi_starttx(struct SerialHardware *_hw)
 	IRQ_SAVE_DISABLE(flags);
 
 	/* Send data only if the SPI is not already transmitting */
-	if (!hw->sending && !fifo_isempty(&ser_handles[SER_SPI]->txfifo))
+	if (!hw->sending && !ser_fifo_isempty(&ser_handles[SER_SPI]->txfifo))
 	{
 		hw->sending = true;
-		SPDR = fifo_pop(&ser_handles[SER_SPI]->txfifo);
+		SPDR = ser_fifo_pop(&ser_handles[SER_SPI]->txfifo);
 	}
 
 	IRQ_RESTORE(flags);
@@ -958,9 +976,9 @@ DECLARE_ISR(USART0_UDRE_vect)
 {
 	SER_STROBE_ON;
 
-	struct FIFOBuffer * const txfifo = &ser_handles[SER_UART0]->txfifo;
+	SerFifo * const txfifo = &ser_handles[SER_UART0]->txfifo;
 
-	if (fifo_isempty(txfifo))
+	if (ser_fifo_isempty(txfifo))
 	{
 		SER_UART0_BUS_TXEND;
 #ifndef SER_UART0_BUS_TXOFF
@@ -979,7 +997,7 @@ DECLARE_ISR(USART0_UDRE_vect)
 #endif
 	else
 	{
-		char c = fifo_pop(txfifo);
+		char c = ser_fifo_pop(txfifo);
 		SER_UART0_BUS_TXCHAR(c);
 	}
 
@@ -1006,8 +1024,8 @@ DECLARE_ISR(USART0_TX_vect)
 {
 	SER_STROBE_ON;
 
-	struct FIFOBuffer * const txfifo = &ser_handles[SER_UART0]->txfifo;
-	if (fifo_isempty(txfifo))
+	SerFifo * const txfifo = &ser_handles[SER_UART0]->txfifo;
+	if (ser_fifo_isempty(txfifo))
 	{
 		SER_UART0_BUS_TXOFF;
 		UARTDescs[SER_UART0].sending = false;
@@ -1029,9 +1047,9 @@ DECLARE_ISR(USART1_UDRE_vect)
 {
 	SER_STROBE_ON;
 
-	struct FIFOBuffer * const txfifo = &ser_handles[SER_UART1]->txfifo;
+	SerFifo * const txfifo = &ser_handles[SER_UART1]->txfifo;
 
-	if (fifo_isempty(txfifo))
+	if (ser_fifo_isempty(txfifo))
 	{
 		SER_UART1_BUS_TXEND;
 #ifndef SER_UART1_BUS_TXOFF
@@ -1050,7 +1068,7 @@ DECLARE_ISR(USART1_UDRE_vect)
 #endif
 	else
 	{
-		char c = fifo_pop(txfifo);
+		char c = ser_fifo_pop(txfifo);
 		SER_UART1_BUS_TXCHAR(c);
 	}
 
@@ -1067,8 +1085,8 @@ DECLARE_ISR(USART1_TX_vect)
 {
 	SER_STROBE_ON;
 
-	struct FIFOBuffer * const txfifo = &ser_handles[SER_UART1]->txfifo;
-	if (fifo_isempty(txfifo))
+	SerFifo * const txfifo = &ser_handles[SER_UART1]->txfifo;
+	if (ser_fifo_isempty(txfifo))
 	{
 		SER_UART1_BUS_TXOFF;
 		UARTDescs[SER_UART1].sending = false;
@@ -1091,9 +1109,9 @@ DECLARE_ISR(USART2_UDRE_vect)
 {
 	SER_STROBE_ON;
 
-	struct FIFOBuffer * const txfifo = &ser_handles[SER_UART2]->txfifo;
+	SerFifo * const txfifo = &ser_handles[SER_UART2]->txfifo;
 
-	if (fifo_isempty(txfifo))
+	if (ser_fifo_isempty(txfifo))
 	{
 		SER_UART2_BUS_TXEND;
 #ifndef SER_UART2_BUS_TXOFF
@@ -1102,7 +1120,7 @@ DECLARE_ISR(USART2_UDRE_vect)
 	}
 	else
 	{
-		char c = fifo_pop(txfifo);
+		char c = ser_fifo_pop(txfifo);
 		SER_UART2_BUS_TXCHAR(c);
 	}
 
@@ -1119,8 +1137,8 @@ DECLARE_ISR(USART2_TX_vect)
 {
 	SER_STROBE_ON;
 
-	struct FIFOBuffer * const txfifo = &ser_handles[SER_UART2]->txfifo;
-	if (fifo_isempty(txfifo))
+	SerFifo * const txfifo = &ser_handles[SER_UART2]->txfifo;
+	if (ser_fifo_isempty(txfifo))
 	{
 		SER_UART2_BUS_TXOFF;
 		UARTDescs[SER_UART2].sending = false;
@@ -1143,9 +1161,9 @@ DECLARE_ISR(USART3_UDRE_vect)
 {
 	SER_STROBE_ON;
 
-	struct FIFOBuffer * const txfifo = &ser_handles[SER_UART3]->txfifo;
+	SerFifo * const txfifo = &ser_handles[SER_UART3]->txfifo;
 
-	if (fifo_isempty(txfifo))
+	if (ser_fifo_isempty(txfifo))
 	{
 		SER_UART3_BUS_TXEND;
 #ifndef SER_UART3_BUS_TXOFF
@@ -1154,7 +1172,7 @@ DECLARE_ISR(USART3_UDRE_vect)
 	}
 	else
 	{
-		char c = fifo_pop(txfifo);
+		char c = ser_fifo_pop(txfifo);
 		SER_UART3_BUS_TXCHAR(c);
 	}
 
@@ -1171,8 +1189,8 @@ DECLARE_ISR(USART3_TX_vect)
 {
 	SER_STROBE_ON;
 
-	struct FIFOBuffer * const txfifo = &ser_handles[SER_UART3]->txfifo;
-	if (fifo_isempty(txfifo))
+	SerFifo * const txfifo = &ser_handles[SER_UART3]->txfifo;
+	if (ser_fifo_isempty(txfifo))
 	{
 		SER_UART3_BUS_TXOFF;
 		UARTDescs[SER_UART3].sending = false;
@@ -1218,15 +1236,15 @@ DECLARE_ISR(USART0_RX_vect)
 	 * will occur once the handler terminates.
 	 */
 	char c = UDR0;
-	struct FIFOBuffer * const rxfifo = &ser_handles[SER_UART0]->rxfifo;
+	SerFifo * const rxfifo = &ser_handles[SER_UART0]->rxfifo;
 
-	if (fifo_isfull(rxfifo))
+	if (ser_fifo_isfull(rxfifo))
 		ser_handles[SER_UART0]->status |= SERRF_RXFIFOOVERRUN;
 	else
 	{
-		fifo_push(rxfifo, c);
+		ser_fifo_push(rxfifo, c);
 #if CONFIG_SER_HWHANDSHAKE
-		if (fifo_isfull(rxfifo))
+		if (ser_fifo_isfull(rxfifo))
 			RTS_OFF;
 #endif
 	}
@@ -1267,16 +1285,16 @@ DECLARE_ISR(USART1_RX_vect)
 	 * not going to accept the incoming data
 	 */
 	char c = UDR1;
-	struct FIFOBuffer * const rxfifo = &ser_handles[SER_UART1]->rxfifo;
+	SerFifo * const rxfifo = &ser_handles[SER_UART1]->rxfifo;
 	//ASSERT_VALID_FIFO(rxfifo);
 
-	if (UNLIKELY(fifo_isfull(rxfifo)))
+	if (UNLIKELY(ser_fifo_isfull(rxfifo)))
 		ser_handles[SER_UART1]->status |= SERRF_RXFIFOOVERRUN;
 	else
 	{
-		fifo_push(rxfifo, c);
+		ser_fifo_push(rxfifo, c);
 #if CONFIG_SER_HWHANDSHAKE
-		if (fifo_isfull(rxfifo))
+		if (ser_fifo_isfull(rxfifo))
 			RTS_OFF;
 #endif
 	}
@@ -1317,16 +1335,16 @@ DECLARE_ISR(USART2_RX_vect)
 	 * not going to accept the incoming data
 	 */
 	char c = UDR2;
-	struct FIFOBuffer * const rxfifo = &ser_handles[SER_UART2]->rxfifo;
+	SerFifo * const rxfifo = &ser_handles[SER_UART2]->rxfifo;
 	//ASSERT_VALID_FIFO(rxfifo);
 
-	if (UNLIKELY(fifo_isfull(rxfifo)))
+	if (UNLIKELY(ser_fifo_isfull(rxfifo)))
 		ser_handles[SER_UART2]->status |= SERRF_RXFIFOOVERRUN;
 	else
 	{
-		fifo_push(rxfifo, c);
+		ser_fifo_push(rxfifo, c);
 #if CONFIG_SER_HWHANDSHAKE
-		if (fifo_isfull(rxfifo))
+		if (ser_fifo_isfull(rxfifo))
 			RTS_OFF;
 #endif
 	}
@@ -1367,16 +1385,16 @@ DECLARE_ISR(USART3_RX_vect)
 	 * not going to accept the incoming data
 	 */
 	char c = UDR3;
-	struct FIFOBuffer * const rxfifo = &ser_handles[SER_UART3]->rxfifo;
+	SerFifo * const rxfifo = &ser_handles[SER_UART3]->rxfifo;
 	//ASSERT_VALID_FIFO(rxfifo);
 
-	if (UNLIKELY(fifo_isfull(rxfifo)))
+	if (UNLIKELY(ser_fifo_isfull(rxfifo)))
 		ser_handles[SER_UART3]->status |= SERRF_RXFIFOOVERRUN;
 	else
 	{
-		fifo_push(rxfifo, c);
+		ser_fifo_push(rxfifo, c);
 #if CONFIG_SER_HWHANDSHAKE
-		if (fifo_isfull(rxfifo))
+		if (ser_fifo_isfull(rxfifo))
 			RTS_OFF;
 #endif
 	}
@@ -1398,8 +1416,8 @@ DECLARE_ISR(SPI_STC_vect)
 	SER_STROBE_ON;
 
 	/* Read incoming byte. */
-	if (!fifo_isfull(&ser_handles[SER_SPI]->rxfifo))
-		fifo_push(&ser_handles[SER_SPI]->rxfifo, SPDR);
+	if (!ser_fifo_isfull(&ser_handles[SER_SPI]->rxfifo))
+		ser_fifo_push(&ser_handles[SER_SPI]->rxfifo, SPDR);
 	/*
 	 * FIXME
 	else
@@ -1407,8 +1425,8 @@ DECLARE_ISR(SPI_STC_vect)
 	*/
 
 	/* Send */
-	if (!fifo_isempty(&ser_handles[SER_SPI]->txfifo))
-		SPDR = fifo_pop(&ser_handles[SER_SPI]->txfifo);
+	if (!ser_fifo_isempty(&ser_handles[SER_SPI]->txfifo))
+		SPDR = ser_fifo_pop(&ser_handles[SER_SPI]->txfifo);
 	else
 		UARTDescs[SER_SPI].sending = false;
 
@@ -93,7 +93,7 @@ struct Serial *ser_handles[SER_CNT];
  */
 int ser_putchar(int c, struct Serial *port)
 {
-	if (fifo_isfull_locked(&port->txfifo))
+	if (ser_fifo_isfull_locked(&port->txfifo))
 	{
 #if CONFIG_SER_TXTIMEOUT != -1
 		/* If timeout == 0 we don't want to wait */
@@ -116,10 +116,10 @@ int ser_putchar(int c, struct Serial *port)
 			}
 #endif /* CONFIG_SER_TXTIMEOUT */
 		}
-		while (fifo_isfull_locked(&port->txfifo));
+		while (ser_fifo_isfull_locked(&port->txfifo));
 	}
 
-	fifo_push_locked(&port->txfifo, (unsigned char)c);
+	ser_fifo_push_locked(&port->txfifo, (unsigned char)c);
 
 	/* (re)trigger tx interrupt */
 	port->hw->table->txStart(port->hw);
@@ -139,7 +139,7 @@ int ser_putchar(int c, struct Serial *port)
  */
 int ser_getchar(struct Serial *port)
 {
-	if (fifo_isempty_locked(&port->rxfifo))
+	if (ser_fifo_isempty_locked(&port->rxfifo))
 	{
 #if CONFIG_SER_RXTIMEOUT != -1
 		/* If timeout == 0 we don't want to wait for chars */
@@ -162,7 +162,7 @@ int ser_getchar(struct Serial *port)
 			}
 #endif /* CONFIG_SER_RXTIMEOUT */
 		}
-		while (fifo_isempty_locked(&port->rxfifo) && (ser_getstatus(port) & SERRF_RX) == 0);
+		while (ser_fifo_isempty_locked(&port->rxfifo) && (ser_getstatus(port) & SERRF_RX) == 0);
 	}
 
 	/*
@@ -171,7 +171,7 @@ int ser_getchar(struct Serial *port)
 	 */
 	if (ser_getstatus(port) & SERRF_RX)
 		return EOF;
-	return (int)(unsigned char)fifo_pop_locked(&port->rxfifo);
+	return (int)(unsigned char)ser_fifo_pop_locked(&port->rxfifo);
 }
 
 #if 0
@@ -183,16 +183,16 @@ int ser_getchar(struct Serial *port)
  */
 static int ser_getchar_nowait(struct Serial *fd)
 {
-	if (fifo_isempty_locked(&fd->rxfifo))
+	if (ser_fifo_isempty_locked(&fd->rxfifo))
 		return EOF;
 
 	/* NOTE: the double cast prevents unwanted sign extension */
-	return (int)(unsigned char)fifo_pop_locked(&fd->rxfifo);
+	return (int)(unsigned char)ser_fifo_pop_locked(&fd->rxfifo);
 }
 #endif
 
 bool ser_available(struct Serial *fd) {
-	if (fifo_isempty_locked(&fd->rxfifo)) {
+	if (ser_fifo_isempty_locked(&fd->rxfifo)) {
 		return false;
 	} else {
 		return true;
@@ -218,6 +218,11 @@ static size_t ser_read(struct KFile *fd, void *_buf, size_t size)
 		if ((c = ser_getchar(fds)) == EOF)
 			break;
 		buf[i++] = c;
+#if CONFIG_SER_SPSC
+		/* Then take at once what is already in the ring */
+		if (!(ser_getstatus(fds) & SERRF_RX))
+			i += spsc_pop_n(&fds->rxfifo, (unsigned char *)buf + i, size - i);
+#endif
 	}
 
 	return i;
@@ -228,7 +233,8 @@ static size_t ser_read(struct KFile *fd, void *_buf, size_t size)
  *
  * \return 0 if OK, EOF in case of error.
  *
- * \todo Optimize with fifo_pushblock()
+ * With the lock-free rings the chars are pushed as many at a time as
+ * there is room for, waiting in ser_putchar() only when the ring is full.
  */
 static size_t ser_write(struct KFile *fd, const void *_buf, size_t size)
 {
@@ -236,12 +242,29 @@ static size_t ser_write(struct KFile *fd, const void *_buf, size_t size)
 	const char *buf = (const char *)_buf;
 	size_t i = 0;
 
+#if CONFIG_SER_SPSC
+	while (i < size)
+	{
+		size_t n = spsc_push_n(&fds->txfifo, (const unsigned char *)buf + i, size - i);
+
+		if (n)
+		{
+			i += n;
+			fds->hw->table->txStart(fds->hw);
+		}
+		else if (ser_putchar(buf[i], fds) == EOF)
+			break;
+		else
+			i++;
+	}
+#else
 	while (size--)
 	{
 		if (ser_putchar(*buf++, fds) == EOF)
 			break;
 		i++;
 	}
+#endif
 	return i;
 }
 
@@ -309,7 +332,7 @@ void ser_purge(struct Serial *fd)
  */
 void ser_purgeRx(struct Serial *fd)
 {
-	fifo_flush_locked(&fd->rxfifo);
+	ser_fifo_flush_locked(&fd->rxfifo);
 }
 
 /**
@@ -317,7 +340,7 @@ void ser_purgeRx(struct Serial *fd)
  */
 void ser_purgeTx(struct Serial *fd)
 {
-	fifo_flush_locked(&fd->txfifo);
+	ser_fifo_flush_locked(&fd->txfifo);
 }
 
 
@@ -337,7 +360,7 @@ static int ser_flush(struct KFile *fd)
 	 * Wait until the FIFO becomes empty, and then until the byte currently in
 	 * the hardware register gets shifted out.
 	 */
-	while (!fifo_isempty(&fds->txfifo)
+	while (!ser_fifo_isempty(&fds->txfifo)
 	       || fds->hw->table->txSending(fds->hw))
 		cpu_relax();
 	return 0;
@@ -365,8 +388,8 @@ static struct Serial *ser_open(struct Serial *fd, unsigned int unit)
 	/* Initialize circular buffers */
 	ASSERT(fd->hw->txbuffer);
 	ASSERT(fd->hw->rxbuffer);
-	fifo_init(&fd->txfifo, fd->hw->txbuffer, fd->hw->txbuffer_size);
-	fifo_init(&fd->rxfifo, fd->hw->rxbuffer, fd->hw->rxbuffer_size);
+	ser_fifo_init(&fd->txfifo, fd->hw->txbuffer, fd->hw->txbuffer_size);
+	ser_fifo_init(&fd->rxfifo, fd->hw->rxbuffer, fd->hw->rxbuffer_size);
 
 	fd->hw->table->init(fd->hw, fd);
 
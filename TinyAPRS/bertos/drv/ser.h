@@ -79,6 +79,45 @@
 
 #include "cfg/cfg_ser.h"
 
+/**
+ * \name Serial FIFOs, shared by the generic driver and the CPU ones.
+ *
+ * The \c _locked variants are for the main loop, the others for the
+ * interrupt handlers. The lock-free rings need no locking at all.
+ * \{
+ */
+#if CONFIG_SER_SPSC
+	#include <struct/spscbuf.h>
+
+	typedef SpscBuffer SerFifo;
+
+	#define ser_fifo_init(f, buf, size)  spsc_init(f, buf, size)
+	#define ser_fifo_isempty(f)          spsc_isempty(f)
+	#define ser_fifo_isfull(f)           spsc_isfull(f)
+	#define ser_fifo_push(f, c)          spsc_push(f, c)
+	#define ser_fifo_pop(f)              spsc_pop(f)
+	#define ser_fifo_count(f)            spsc_count(f)
+	#define ser_fifo_isempty_locked(f)   spsc_isempty(f)
+	#define ser_fifo_isfull_locked(f)    spsc_isfull(f)
+	#define ser_fifo_push_locked(f, c)   spsc_push(f, c)
+	#define ser_fifo_pop_locked(f)       spsc_pop(f)
+	#define ser_fifo_flush_locked(f)     spsc_flush_locked(f)
+#else
+	typedef FIFOBuffer SerFifo;
+
+	#define ser_fifo_init(f, buf, size)  fifo_init(f, buf, size)
+	#define ser_fifo_isempty(f)          fifo_isempty(f)
+	#define ser_fifo_isfull(f)           fifo_isfull(f)
+	#define ser_fifo_push(f, c)          fifo_push(f, c)
+	#define ser_fifo_pop(f)              fifo_pop(f)
+	#define ser_fifo_isempty_locked(f)   fifo_isempty_locked(f)
+	#define ser_fifo_isfull_locked(f)    fifo_isfull_locked(f)
+	#define ser_fifo_push_locked(f, c)   fifo_push_locked(f, c)
+	#define ser_fifo_pop_locked(f)       fifo_pop_locked(f)
+	#define ser_fifo_flush_locked(f)     fifo_flush_locked(f)
+#endif
+/*\}*/
+
 
 
 /**
@@ -158,8 +197,8 @@ typedef struct Serial
 	 *
 	 * \{
 	 */
-	FIFOBuffer txfifo;
-	FIFOBuffer rxfifo;
+	SerFifo txfifo;
+	SerFifo rxfifo;
 	/* \} */
 
 #if CONFIG_SER_RXTIMEOUT != -1
@@ -53,6 +53,8 @@
 #include <cpu/pgm.h>
 #include <struct/fifobuf.h>
 
+#include <algo/rand.h>
+
 #include <string.h> /* memset */
 
 #define PHASE_BIT    8
@@ -62,37 +64,51 @@
 #define PHASE_THRES  (PHASE_MAX / 2) // - PHASE_BIT / 2)
 
 // Modulator constants
+#define SIN_LEN     256 ///< Full wave length
+#define PHASE_SHIFT 8   ///< The sine table is indexed by the MSBs of the 16 bit phase
+
 #define MARK_FREQ  1200
-#define MARK_INC   (uint16_t)(DIV_ROUND(SIN_LEN * (uint32_t)MARK_FREQ, CONFIG_AFSK_DAC_SAMPLERATE))
+#define MARK_INC   (uint16_t)(DIV_ROUND((uint32_t)SIN_LEN * MARK_FREQ << PHASE_SHIFT, CONFIG_AFSK_DAC_SAMPLERATE))
 
 #define SPACE_FREQ 2200
-#define SPACE_INC  (uint16_t)(DIV_ROUND(SIN_LEN * (uint32_t)SPACE_FREQ, CONFIG_AFSK_DAC_SAMPLERATE))
+#define SPACE_INC  (uint16_t)(DIV_ROUND((uint32_t)SIN_LEN * SPACE_FREQ << PHASE_SHIFT, CONFIG_AFSK_DAC_SAMPLERATE))
 
 //Ensure sample rate is a multiple of bit rate
 STATIC_ASSERT(!(CONFIG_AFSK_DAC_SAMPLERATE % BITRATE));
 
+// The FIFOs are SpscBuffer rings
+STATIC_ASSERT(CONFIG_AFSK_RX_BUFLEN <= SPSC_MAX_LEN && !(CONFIG_AFSK_RX_BUFLEN & (CONFIG_AFSK_RX_BUFLEN - 1)));
+STATIC_ASSERT(CONFIG_AFSK_TX_BUFLEN <= SPSC_MAX_LEN && !(CONFIG_AFSK_TX_BUFLEN & (CONFIG_AFSK_TX_BUFLEN - 1)));
+
 #define DAC_SAMPLEPERBIT (CONFIG_AFSK_DAC_SAMPLERATE / BITRATE)
 
 /**
- * Sine table for the first quarter of wave.
- * The rest of the wave is computed from this first quarter.
- * This table is used to generate the modulated data.
+ * Sine table for a full wave.
+ * This table is used to generate the modulated data: the phase
+ * accumulator wraps around by itself, so a sample is just a lookup.
  */
 static const uint8_t PROGMEM sin_table[] =
 {
-	128, 129, 131, 132, 134, 135, 137, 138, 140, 142, 143, 145, 146, 148, 149, 151,
-	152, 154, 155, 157, 158, 160, 162, 163, 165, 166, 167, 169, 170, 172, 173, 175,
-	176, 178, 179, 181, 182, 183, 185, 186, 188, 189, 190, 192, 193, 194, 196, 197,
-	198, 200, 201, 202, 203, 205, 206, 207, 208, 210, 211, 212, 213, 214, 215, 217,
-	218, 219, 220, 221, 222, 223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 233,
-	234, 234, 235, 236, 237, 238, 238, 239, 240, 241, 241, 242, 243, 243, 244, 245,
-	245, 246, 246, 247, 248, 248, 249, 249, 250, 250, 250, 251, 251, 252, 252, 252,
-	253, 253, 253, 253, 254, 254, 254, 254, 254, 255, 255, 255, 255, 255, 255, 255,
+	129, 132, 135, 138, 142, 145, 148, 151, 154, 157, 160, 163, 166, 169, 172, 175,
+	178, 181, 183, 186, 189, 192, 194, 197, 200, 202, 205, 207, 210, 212, 214, 217,
+	219, 221, 223, 225, 227, 229, 231, 233, 234, 236, 238, 239, 241, 242, 243, 245,
+	246, 247, 248, 249, 250, 251, 252, 252, 253, 253, 254, 254, 255, 255, 255, 255,
+	255, 255, 255, 255, 254, 254, 253, 253, 252, 252, 251, 250, 249, 248, 247, 246,
+	245, 243, 242, 241, 239, 238, 236, 234, 233, 231, 229, 227, 225, 223, 221, 219,
+	217, 214, 212, 210, 207, 205, 202, 200, 197, 194, 192, 189, 186, 183, 181, 178,
+	175, 172, 169, 166, 163, 160, 157, 154, 151, 148, 145, 142, 138, 135, 132, 129,
+	126, 123, 120, 117, 113, 110, 107, 104, 101, 98, 95, 92, 89, 86, 83, 80,
+	77, 74, 72, 69, 66, 63, 61, 58, 55, 53, 50, 48, 45, 43, 41, 38,
+	36, 34, 32, 30, 28, 26, 24, 22, 21, 19, 17, 16, 14, 13, 12, 10,
+	9, 8, 7, 6, 5, 4, 3, 3, 2, 2, 1, 1, 0, 0, 0, 0,
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 7, 8, 9,
+	10, 12, 13, 14, 16, 17, 19, 21, 22, 24, 26, 28, 30, 32, 34, 36,
+	38, 41, 43, 45, 48, 50, 53, 55, 58, 61, 63, 66, 69, 72, 74, 77,
+	80, 83, 86, 89, 92, 95, 98, 101, 104, 107, 110, 113, 117, 120, 123, 126,
 };
 
-#define SIN_LEN 512 ///< Full wave length
-
-STATIC_ASSERT(sizeof(sin_table) == SIN_LEN / 4);
+STATIC_ASSERT(sizeof(sin_table) == SIN_LEN);
+STATIC_ASSERT(SIN_LEN << PHASE_SHIFT == 0x10000UL);
 
 #if (CONFIG_AFSK_FILTER == AFSK_FIR)
 enum fir_filters
@@ -134,21 +150,6 @@ static FIR fir_table[] =
 };
 #endif
 
-/**
- * Given the index, this function computes the correct sine sample
- * based only on the first quarter of wave.
- */
-INLINE uint8_t sin_sample(uint16_t idx)
-{
-	ASSERT(idx < SIN_LEN);
-	uint16_t new_idx = idx % (SIN_LEN / 2);
-	new_idx = (new_idx >= (SIN_LEN / 4)) ? (SIN_LEN / 2 - new_idx - 1) : new_idx;
-
-	uint8_t data = pgm_read8(&sin_table[new_idx]);
-
-	return (idx >= (SIN_LEN / 2)) ? (255 - data) : data;
-}
-
 #if (CONFIG_AFSK_FILTER == AFSK_FIR)
 static int8_t fir_filter(int8_t s, enum fir_filters f)
 {
@@ -172,6 +173,29 @@ static int8_t fir_filter(int8_t s, enum fir_filters f)
 }
 #endif
 
+#if CONFIG_AFSK_SLICERS > 1
+/**
+ * Setup of the additional slicers.
+ * The main demodulator filters the discriminator output at 800Hz and
+ * slices it at 0; the others try a different filter cutoff and a biased
+ * threshold, to catch the frames distorted by the radio audio path
+ * (deemphasis, twist, DC offset).
+ */
+static const struct SlicerSetup
+{
+	uint8_t lp_shift;  ///< IIR feedback shift: 1 = 600Hz, 2 = 800Hz, 3 = 1200Hz
+	int16_t threshold; ///< mark/space decision level
+} slicer_setup[] =
+{
+	{ .lp_shift = 1, .threshold = 0 },
+	{ .lp_shift = 3, .threshold = 0 },
+	{ .lp_shift = 2, .threshold = 64 },
+	{ .lp_shift = 2, .threshold = -64 },
+};
+
+STATIC_ASSERT(CONFIG_AFSK_SLICERS - 1 <= countof(slicer_setup));
+#endif
+
 #define BIT_DIFFER(bitline1, bitline2) (((bitline1) ^ (bitline2)) & 0x01)
 #define EDGE_FOUND(bitline)            BIT_DIFFER((bitline), (bitline) >> 1)
 
@@ -185,7 +209,7 @@ static int8_t fir_filter(int8_t s, enum fir_filters f)
  *
  * \return true if all is ok, false if the fifo is full.
  */
-static bool hdlc_parse(Hdlc *hdlc, bool bit, FIFOBuffer *fifo)
+static bool hdlc_parse(Hdlc *hdlc, bool bit, SpscBuffer *fifo)
 {
 	bool ret = true;
 
@@ -195,17 +219,15 @@ static bool hdlc_parse(Hdlc *hdlc, bool bit, FIFOBuffer *fifo)
 	/* HDLC Flag */
 	if (hdlc->demod_bits == HDLC_FLAG)
 	{
-		if (!fifo_isfull(fifo))
+		if (!spsc_isfull(fifo))
 		{
-			fifo_push(fifo, HDLC_FLAG);
+			spsc_push(fifo, HDLC_FLAG);
 			hdlc->rxstart = true;
-			AFSK_LED_RX_ON();
 		}
 		else
 		{
 			ret = false;
 			hdlc->rxstart = false;
-			AFSK_LED_RX_OFF();
 		}
 
 		hdlc->currchar = 0;
@@ -217,7 +239,6 @@ static bool hdlc_parse(Hdlc *hdlc, bool bit, FIFOBuffer *fifo)
 	if ((hdlc->demod_bits & HDLC_RESET) == HDLC_RESET)
 	{
 		hdlc->rxstart = false;
-		AFSK_LED_RX_OFF();
 		return ret;
 	}
 
@@ -237,22 +258,20 @@ static bool hdlc_parse(Hdlc *hdlc, bool bit, FIFOBuffer *fifo)
 			|| hdlc->currchar == HDLC_RESET
 			|| hdlc->currchar == AX25_ESC))
 		{
-			if (!fifo_isfull(fifo))
-				fifo_push(fifo, AX25_ESC);
+			if (!spsc_isfull(fifo))
+				spsc_push(fifo, AX25_ESC);
 			else
 			{
 				hdlc->rxstart = false;
-				AFSK_LED_RX_OFF();
 				ret = false;
 			}
 		}
 
-		if (!fifo_isfull(fifo))
-			fifo_push(fifo, hdlc->currchar);
+		if (!spsc_isfull(fifo))
+			spsc_push(fifo, hdlc->currchar);
 		else
 		{
 			hdlc->rxstart = false;
-			AFSK_LED_RX_OFF();
 			ret = false;
 		}
 
@@ -266,15 +285,558 @@ static bool hdlc_parse(Hdlc *hdlc, bool bit, FIFOBuffer *fifo)
 }
 
 
+#if CONFIG_AFSK_PLL == AFSK_PLL_PI
+/*
+ * The bit phase wraps around once per bit, when the bit is sampled.
+ * PLL_EDGE is where a detected edge should be: half a bit before the
+ * majority window, centered on the sample before the wrap, plus half
+ * a sample of average detection delay.
+ */
+#define PLL_INC      ((uint16_t)(0x10000UL / SAMPLEPERBIT))
+#define PLL_EDGE     (0x8000 - PLL_INC / 2)
+
+/* Correction limits: the phase always advances, bitrate within 1% */
+#define PLL_CORR_MAX (PLL_INC * 3 / 4)
+#define PLL_FREQ_MAX (PLL_INC / 100)
+
+/* Loop gains as shifts of the phase error, acquiring and locked */
+#define PLL_KP_ACQ   1
+#define PLL_KI_ACQ   6
+#define PLL_KP_LOCK  3
+#define PLL_KI_LOCK  9
+
+/* Locked when the average edge error is below 3/4 of a sample */
+#define PLL_LOCK_ERR (PLL_INC * 3 / 4)
+#endif
+
 /**
- * ADC ISR callback.
- * This function has to be called by the ADC ISR when a sample of the configured
- * channel is available.
+ * Bit clock recovery.
+ * Align the sampling phase to the edges found in \a sampled_bits and,
+ * when it is time to sample a bit, shift its value in \a found_bits.
+ *
+ * \param sampled_bits bits sampled by the demodulator at ADC speed.
+ * \param pll bit clock recovery state.
+ * \param found_bits bits found at the bitrate speed.
+ *
+ * \return true if a new bit has been shifted in \a found_bits.
+ */
+INLINE bool afsk_sampleBit(uint8_t sampled_bits, AfskPll *pll, uint8_t *found_bits)
+{
+#if CONFIG_AFSK_PLL == AFSK_PLL_PI
+	int16_t corr = 0;
+
+	/*
+	 * Proportional-integral loop on the edge phase error.
+	 * While acquiring (e.g. on the preamble flags) the gains are high,
+	 * to lock within a couple of flags; once locked they are lowered,
+	 * so noisy edges in the frame do not move the clock much.
+	 */
+	if (EDGE_FOUND(sampled_bits))
+	{
+		int16_t e = (int16_t)(pll->phase - PLL_EDGE);
+		/*
+		 * |e| is up to 0x8000 and the average follows it: saturate it,
+		 * so that their difference always fits in an int16_t.
+		 */
+		uint16_t abs_e = e < 0 ? 0 - (uint16_t)e : (uint16_t)e;
+		if (abs_e > INT16_MAX)
+			abs_e = INT16_MAX;
+
+		pll->err += ((int16_t)(abs_e - pll->err)) >> 3;
+
+		if (pll->err > PLL_LOCK_ERR)
+		{
+			corr = e >> PLL_KP_ACQ;
+			pll->freq -= e >> PLL_KI_ACQ;
+		}
+		else
+		{
+			corr = e >> PLL_KP_LOCK;
+			pll->freq -= e >> PLL_KI_LOCK;
+		}
+		if (corr > PLL_CORR_MAX)
+			corr = PLL_CORR_MAX;
+		else if (corr < -PLL_CORR_MAX)
+			corr = -PLL_CORR_MAX;
+
+		if (pll->freq > PLL_FREQ_MAX)
+			pll->freq = PLL_FREQ_MAX;
+		else if (pll->freq < -PLL_FREQ_MAX)
+			pll->freq = -PLL_FREQ_MAX;
+	}
+
+	uint16_t prev = pll->phase;
+	pll->phase += PLL_INC + pll->freq - corr;
+
+	/* sample the bit when the phase wraps */
+	if (pll->phase >= prev)
+		return false;
+#else
+	/* If there is an edge, adjust phase sampling */
+	if (EDGE_FOUND(sampled_bits))
+	{
+		if (pll->curr_phase < PHASE_THRES)
+			pll->curr_phase += PHASE_INC;
+		else
+			pll->curr_phase -= PHASE_INC;
+	}
+	pll->curr_phase += PHASE_BIT;
+
+	/* sample the bit */
+	if (pll->curr_phase < PHASE_MAX)
+		return false;
+
+	pll->curr_phase %= PHASE_MAX;
+#endif
+
+	/* Shift 1 position in the shift register of the found bits */
+	*found_bits <<= 1;
+
+	/*
+	 * Determine bit value by reading the last 3 sampled bits.
+	 * If the number of ones is two or greater, the bit value is a 1,
+	 * otherwise is a 0.
+	 * This algorithm presumes that there are 8 samples per bit.
+	 */
+	STATIC_ASSERT(SAMPLEPERBIT == 8);
+	uint8_t bits = sampled_bits & 0x07;
+	if (bits == 0x07 // 111, 3 bits set to 1
+	 || bits == 0x06 // 110, 2 bits
+	 || bits == 0x05 // 101, 2 bits
+	 || bits == 0x03 // 011, 2 bits
+	){
+		*found_bits |= 1;
+	}
+
+	return true;
+}
+
+#if CONFIG_AFSK_WEAK_BITS
+/*
+ * Track the position of the bits just parsed by hdlc_parse() that were
+ * sampled with low confidence, i.e. 2 out of 3 majority.
+ */
+INLINE void afsk_weakBit(Afsk *af, bool weak)
+{
+	Hdlc *hdlc = &af->hdlc;
+	AfskWeakBits *wb = &af->weak;
+
+	/* Frame boundary, save the bits of the frame just ended (if any) */
+	if (hdlc->demod_bits == HDLC_FLAG)
+	{
+		if (wb->len)
+		{
+			wb->last_len = wb->len;
+			wb->last_cnt = wb->cnt;
+			memcpy(wb->last_pos, wb->pos, wb->cnt * sizeof(wb->pos[0]));
+		}
+		wb->len = 0;
+		wb->cnt = 0;
+		return;
+	}
+
+	/* Skip stuffed bits and bits outside of a frame */
+	if (!hdlc->rxstart || (hdlc->demod_bits & 0x3f) == 0x3e)
+		return;
+
+	if (weak && wb->cnt < CONFIG_AFSK_WEAK_BITS)
+		wb->pos[wb->cnt++] = wb->len * 8 + (hdlc->bit_idx ? hdlc->bit_idx - 1 : 7);
+
+	if (hdlc->bit_idx == 0)
+		wb->len++;
+}
+
+/**
+ * Get the low confidence bits of the last frame received by the
+ * main demodulator, to help repairing it if its CRC is wrong.
+ *
+ * \param fd modem channel.
+ * \param frm_len length of the frame, escapes excluded.
+ * \param pos where to put the bit positions.
+ * \param max room in \a pos.
+ *
+ * \return the number of positions, 0 if the last frame
+ *         has not the given length.
+ */
+uint8_t afsk_weakBits(KFile *fd, size_t frm_len, uint16_t *pos, uint8_t max)
+{
+	Afsk *af = AFSK_CAST(fd);
+	AfskWeakBits *wb = &af->weak;
+	uint8_t cnt = 0;
+
+	ATOMIC(
+		if (wb->last_len == frm_len)
+		{
+			cnt = MIN(wb->last_cnt, max);
+			memcpy(pos, wb->last_pos, cnt * sizeof(pos[0]));
+		}
+	);
+	return cnt;
+}
+#endif
+
+#if CONFIG_AFSK_FX25
+/*
+ * FX.25 receiver states: looking for a correlation tag, receiving the
+ * codeword (in the ADC ISR), waiting for the main loop to decode it.
+ */
+#define FX25_HUNT  0
+#define FX25_DATA  1
+#define FX25_READY 2
+
+/*
+ * Feed the FX.25 receiver with a bit from the main demodulator,
+ * looking for a correlation tag and then collecting the codeword.
+ */
+INLINE void afsk_fx25Bit(AfskFx25 *fx, bool bit)
+{
+	if (fx->rx_state == FX25_HUNT)
+	{
+		fx->tag_lo = (fx->tag_lo >> 1) | (fx->tag_hi << 31);
+		fx->tag_hi = (fx->tag_hi >> 1) | ((uint32_t)bit << 31);
+
+		int8_t code = fx25_findTag(fx->tag_lo, fx->tag_hi);
+		if (code >= 0)
+		{
+			Fx25Code c;
+			fx25_code(code, &c);
+			fx->rx_code = code;
+			fx->rx_n = c.n;
+			fx->rx_k = c.k;
+			fx->rx_len = 0;
+			fx->rx_bits = 0;
+			fx->tag_lo = fx->tag_hi = 0;
+			fx->rx_state = FX25_DATA;
+		}
+	}
+	else if (fx->rx_state == FX25_DATA)
+	{
+		fx->rx_cur = (fx->rx_cur >> 1) | (bit ? 0x80 : 0);
+		if (++fx->rx_bits < 8)
+			return;
+
+		/* Data at the start, parity at the end of the block */
+		fx->rx_bits = 0;
+		if (fx->rx_len < fx->rx_k)
+			fx->rx_block[fx->rx_len] = fx->rx_cur;
+		else
+			fx->rx_block[RS_NN - fx->rx_n + fx->rx_len] = fx->rx_cur;
+
+		if (++fx->rx_len == fx->rx_n)
+			fx->rx_state = FX25_READY;
+	}
+}
+#endif
+
+#if CONFIG_AFSK_CHANNEL_LOAD
+/*
+ * Close a second of the channel load meter, and the 10 s and minute
+ * slots when they are over.
+ *
+ * Run from the demodulator, possibly in the ADC ISR: the divisions are
+ * multiplications and shifts, exact in the range of the values, as the
+ * software division would take most of a sample period.
+ */
+static NOINLINE void afsk_loadSecond(AfskLoadMeter *m)
+{
+	bool ten = ++m->secs == 10;
+	bool min = ten && m->ten == countof(m->load[0].tens) - 1;
+
+	STATIC_ASSERT(BITRATE == 1200);
+	for (uint8_t k = 0; k < AFSK_LOAD_KINDS; k++)
+	{
+		AfskLoad *l = &m->load[k];
+
+		/* bits / 12 = (bits * 683) / 8192, the 1200 bits of a second in percent */
+		l->sec = ((uint32_t)l->bits * 683) >> 13;
+		l->bits = 0;
+		l->sum += l->sec;
+		if (ten)
+		{
+			/* sum / 10 = (sum * 205) / 2048 */
+			l->tens[m->ten] = ((uint32_t)l->sum * 205) >> 11;
+			l->sum = 0;
+		}
+		if (min)
+		{
+			uint16_t sum = 0;
+			for (uint8_t i = 0; i < countof(l->tens); i++)
+				sum += l->tens[i];
+			/* sum / 6 = (sum * 683) / 4096 */
+			l->mins[m->min] = ((uint32_t)sum * 683) >> 12;
+		}
+	}
+
+	m->bits = 0;
+	if (ten)
+	{
+		m->secs = 0;
+		m->ten = min ? 0 : m->ten + 1;
+		if (m->tens_cnt < countof(m->load[0].tens))
+			m->tens_cnt++;
+	}
+	if (min)
+	{
+		m->min = (m->min + 1) % countof(m->load[0].mins);
+		if (m->mins_cnt < countof(m->load[0].mins))
+			m->mins_cnt++;
+	}
+}
+
+/*
+ * Count a demodulated bit in the channel load meter.
+ */
+INLINE void afsk_loadBit(Afsk *af)
+{
+	AfskLoadMeter *m = &af->load;
+
+	m->load[AFSK_LOAD_ENERGY].bits += af->cd;
+	m->load[AFSK_LOAD_SYNC].bits += af->hdlc.rxstart && afsk_dcd(af);
+	if (++m->bits == BITRATE)
+		afsk_loadSecond(m);
+}
+
+/**
+ * Channel load, the time it was busy over a sliding window.
+ *
+ * The energy is the time a signal was on the discriminator output
+ * (the carrier detect flag), with or without data, noise included when
+ * the squelch is open; the sync is the time HDLC frames were being
+ * received with the bit clock locked, so the flags found in noise don't
+ * count. Windows not filled yet since the modem started are averaged
+ * over the time elapsed.
+ *
  * \param af Afsk context to operate on.
- * \param curr_sample current sample from the ADC.
+ * \param kind one of AfskLoadKind.
+ * \param window one of AfskLoadWindow.
+ * \return the busy time in percent.
+ */
+uint8_t afsk_channelLoad(Afsk *af, uint8_t kind, uint8_t window)
+{
+	const AfskLoadMeter *m = &af->load;
+	const AfskLoad *l = &m->load[kind];
+	const uint8_t *slot = l->tens;
+	uint8_t cnt = m->tens_cnt;
+	uint16_t sum = 0;
+
+	ASSERT(kind < AFSK_LOAD_KINDS);
+	/* The demodulator writes single bytes, read as they are */
+	if (window == AFSK_LOAD_10MIN && m->mins_cnt)
+	{
+		slot = l->mins;
+		cnt = m->mins_cnt;
+	}
+	if (window == AFSK_LOAD_1S || !cnt)
+		return l->sec;
+
+	for (uint8_t i = 0; i < cnt; i++)
+		sum += slot[i];
+	return sum / cnt;
+}
+#endif
+
+#if CONFIG_AFSK_AGC
+/*
+ * Bit peaks of the discriminator input kept by the AGC, below full scale
+ * to leave room for the twist between the tones: the gain is lowered
+ * above the high level and raised below the low one.
+ */
+#define AGC_PEAK_HIGH  112
+#define AGC_PEAK_LOW   48
+
+/* Gain of the 8 bit ADC input path, 10 bit samples shifted right by 2 */
+#define AGC_GAIN_UNITY 64
+/* From 12dB below to 30dB above it */
+#define AGC_GAIN_MIN   (AGC_GAIN_UNITY / 4)
+#define AGC_GAIN_MAX   (AGC_GAIN_UNITY * 32)
+
+#if CONFIG_AFSK_EQ
+/*
+ * Tilt filters of the equalizer, (1 - c z^-1) / (1 - p z^-1) with the
+ * zero c and the pole p in 1.7 fixed point, cutting the space tone from
+ * 0 to AFSK_EQ_CUT_MAX dB under the mark tone, 1dB apart. Each one has
+ * the least noise gain for its cut; the mark tone gain changes too, the
+ * AGC follows.
+ */
+static const int8_t PROGMEM eq_cut[][2] =
+{
+	{ 0, 0 },     /* flat */
+	{ -128, -19 },
+	{ -128, 2 },
+	{ -128, 24 },
+	{ -128, 43 },
+	{ -128, 63 },
+	{ -103, 87 }, /* 6dB */
+};
+
+STATIC_ASSERT(countof(eq_cut) == AFSK_EQ_CUT_MAX + 1);
+
+/*
+ * Level ratios half way between two twists, 8.8 fixed point:
+ * 10^((twist + 0.5) / 20) from -AFSK_EQ_TWIST_MAX - 1 to AFSK_EQ_TWIST_MAX.
+ */
+static const uint16_t PROGMEM eq_ratio[] =
+{
+	61, 68, 76, 86, 96, 108, 121, 136,
+	152, 171, 192, 215, 242, 271, 304, 341,
+	383, 430, 482, 541, 607, 681, 764, 858,
+	962, 1080,
+};
+
+STATIC_ASSERT(countof(eq_ratio) == 2 * AFSK_EQ_TWIST_MAX + 2);
+
+/* Flags in favour of a twist step, more than against it */
+#define EQ_VOTES 4
+
+/* Level of the found bits on the mark tone */
+#if CONFIG_AFSK_FILTER == AFSK_FIR
+	#define EQ_MARK_LEVEL 0
+#else
+	#define EQ_MARK_LEVEL 1
+#endif
+
+/*
+ * Follow a new twist. Only a louder space tone is evened out: a space
+ * tone cut cuts the noise above it too, while raising a weak space tone
+ * raises the noise more than the tone on a flat (white) noise floor.
+ * Receivers with a weak space tone hear it through de-emphasis, which
+ * has already cut their noise alike.
+ */
+static void afsk_eqSet(AfskEq *eq, int8_t twist)
+{
+	uint8_t cut = MINMAX((int8_t)0, twist, (int8_t)AFSK_EQ_CUT_MAX);
+
+	eq->twist = twist;
+	eq->cut = cut;
+	eq->c = pgm_read8(&eq_cut[cut][0]);
+	eq->p = pgm_read8(&eq_cut[cut][1]);
+	eq->vote = 0;
+}
+
+INLINE int16_t afsk_eqFilter(AfskEq *eq, int16_t x)
+{
+	int16_t y = x - (int16_t)(((int32_t)eq->c * eq->x1) >> 7) + (int16_t)(((int32_t)eq->p * eq->y1) >> 7);
+
+	eq->x1 = x;
+	eq->y1 = y;
+	return y;
+}
+
+/*
+ * Measure the twist on the tone levels of the HDLC flags, called once per
+ * bit after hdlc_parse(). In NRZI a flag is a 0 and six 1 bits on a tone,
+ * then its last 0 on the other one: when it follows another flag the
+ * level of the six 1 bits is compared with the level of the last bit.
+ */
+static void afsk_eqBit(Afsk *af, bool bit)
+{
+	AfskEq *eq = &af->eq;
+	uint16_t level = eq->acc;
+
+	eq->acc = 0;
+	if (eq->flag_gap < 255)
+		eq->flag_gap++;
+
+	if (bit)
+	{
+		/* Long runs of 1 bits are no flag, just don't overflow */
+		if (eq->run < 0x8000)
+			eq->run += level;
+		return;
+	}
+
+	if (af->hdlc.demod_bits == HDLC_FLAG)
+	{
+		if (eq->flag_gap == 8)
+		{
+			uint32_t space = (uint32_t)level * 6 << 8, mark = eq->run;
+			uint8_t i = eq->twist + AFSK_EQ_TWIST_MAX + 1;
+
+			if ((af->found_bits & 1) == EQ_MARK_LEVEL)
+			{
+				mark = space >> 8;
+				space = (uint32_t)eq->run << 8;
+			}
+
+			/* More than half a dB above or below the measured twist */
+			if (space > mark * pgm_read16(&eq_ratio[i]) && eq->vote < EQ_VOTES)
+				eq->vote++;
+			else if (space < mark * pgm_read16(&eq_ratio[i - 1]) && eq->vote > -EQ_VOTES)
+				eq->vote--;
+
+			if (eq->vote == EQ_VOTES && eq->twist < AFSK_EQ_TWIST_MAX)
+				afsk_eqSet(eq, eq->twist + 1);
+			else if (eq->vote == -EQ_VOTES && eq->twist > -AFSK_EQ_TWIST_MAX)
+				afsk_eqSet(eq, eq->twist - 1);
+		}
+		eq->flag_gap = 0;
+	}
+	eq->run = 0;
+}
+#endif
+
+/*
+ * Remove the DC offset of an ADC sample and scale it to the 8 bit
+ * input of the discriminator.
+ */
+INLINE int8_t afsk_agc(Afsk *af, afsk_sample_t curr_sample)
+{
+	/* Single pole high-pass at about 50Hz, the offset averaged over 32 samples */
+	af->agc_dc += curr_sample - (af->agc_dc >> 5);
+	int32_t s = ((int32_t)(curr_sample - (af->agc_dc >> 5)) * af->agc_gain) >> 8;
+#if CONFIG_AFSK_EQ
+	/* Some headroom above full scale for the filter, without overflowing it */
+	int16_t x = (int16_t)MINMAX((int32_t)-1024, s, (int32_t)1023);
+
+	/* The twist is measured before the filter */
+	af->eq.acc += ABS(x);
+	s = afsk_eqFilter(&af->eq, x);
+#endif
+	int8_t out = (int8_t)MINMAX((int32_t)-128, s, (int32_t)127);
+
+	uint8_t peak = ABS(out);
+	if (peak > af->agc_peak)
+		af->agc_peak = peak;
+
+	/* The gain follows the bit peaks: fast attack, slow release */
+	if (++af->agc_cnt == SAMPLEPERBIT)
+	{
+		uint16_t gain = af->agc_gain;
+
+		if (af->agc_peak > AGC_PEAK_HIGH)
+		{
+			/* -2.5dB per bit */
+			gain -= gain >> 2;
+			if (gain < AGC_GAIN_MIN)
+				gain = AGC_GAIN_MIN;
+		}
+		else if (af->agc_peak < AGC_PEAK_LOW)
+		{
+			/* +0.14dB per bit, 30dB in 200ms */
+			gain += (gain >> 6) + 1;
+			if (gain > AGC_GAIN_MAX)
+				gain = AGC_GAIN_MAX;
+		}
+		af->agc_gain = gain;
+		af->agc_peak = 0;
+		af->agc_cnt = 0;
+	}
+	return out;
+}
+#endif
+
+/*
+ * Demodulate a sample: DC blocker and AGC, frequency discriminator,
+ * slicers, bit clock recovery and HDLC parsing.
  */
-void afsk_adc_isr(Afsk *af, int8_t curr_sample)
+INLINE void afsk_demod(Afsk *af, afsk_sample_t adc_sample)
 {
+#if CONFIG_AFSK_AGC
+	int8_t curr_sample = afsk_agc(af, adc_sample);
+#else
+	int8_t curr_sample = adc_sample;
+#endif
+
 	/*
 	 * Frequency discriminator and LP IIR filter.
 	 * This filter is designed to work
@@ -282,6 +844,8 @@ void afsk_adc_isr(Afsk *af, int8_t curr_sample)
 	 */
 	STATIC_ASSERT(SAMPLERATE == 9600);
 	STATIC_ASSERT(BITRATE == 1200);
+	/* Slicers are fed by the IIR discriminator */
+	STATIC_ASSERT(CONFIG_AFSK_SLICERS == 1 || CONFIG_AFSK_FILTER != AFSK_FIR);
 
 #define CUTOFF_600 0 // for 1200BPS, cutoff is 600HZ ?
 #define CUTOFF_800 1
@@ -417,77 +981,196 @@ void afsk_adc_isr(Afsk *af, int8_t curr_sample)
 //kprintf("%+03d %+03d %+03d %d\n", curr_sample, af->iir_x[1], af->iir_y[1], (af->cd)?1:0);
 
 
-	/* If there is an edge, adjust phase sampling */
-	if (EDGE_FOUND(af->sampled_bits))
-	{
-		if (af->curr_phase < PHASE_THRES)
-			af->curr_phase += PHASE_INC;
-		else
-			af->curr_phase -= PHASE_INC;
-	}
-	af->curr_phase += PHASE_BIT;
-
-	/* sample the bit */
-	if (af->curr_phase >= PHASE_MAX)
+	if (afsk_sampleBit(af->sampled_bits, &af->pll, &af->found_bits))
 	{
-		af->curr_phase %= PHASE_MAX;
-
-		/* Shift 1 position in the shift register of the found bits */
-		af->found_bits <<= 1;
-
-		/*
-		 * Determine bit value by reading the last 3 sampled bits.
-		 * If the number of ones is two or greater, the bit value is a 1,
-		 * otherwise is a 0.
-		 * This algorithm presumes that there are 8 samples per bit.
-		 */
-		STATIC_ASSERT(SAMPLEPERBIT == 8);
-		uint8_t bits = af->sampled_bits & 0x07;
-		if (bits == 0x07 // 111, 3 bits set to 1
-		 || bits == 0x06 // 110, 2 bits
-		 || bits == 0x05 // 101, 2 bits
-		 || bits == 0x03 // 011, 2 bits
-		){
-			af->found_bits |= 1;
-		}
-
 		/*
 		 * NRZ-Space coding: if 2 consecutive bits have the same value
 		 * a 1 is received, otherwise it's a 0.
 		 */
 		if (!hdlc_parse(&af->hdlc, !EDGE_FOUND(af->found_bits), &af->rx_fifo))
-			af->status |= AFSK_RXFIFO_OVERRUN;
+			ATOMIC(af->status |= AFSK_RXFIFO_OVERRUN);
+
+		#if CONFIG_AFSK_WEAK_BITS
+		uint8_t bits = af->sampled_bits & 0x07;
+		afsk_weakBit(af, bits != 0 && bits != 0x07);
+		#endif
+
+		#if CONFIG_AFSK_EQ
+		afsk_eqBit(af, !EDGE_FOUND(af->found_bits));
+		#endif
+
+		#if CONFIG_AFSK_FX25
+		afsk_fx25Bit(&af->fx25, !EDGE_FOUND(af->found_bits));
+		#endif
+
+		#if CONFIG_AFSK_CHANNEL_LOAD
+		afsk_loadBit(af);
+		#endif
+
+		if (af->hdlc.rxstart)
+			AFSK_LED_RX_ON();
+		else
+			AFSK_LED_RX_OFF();
 	}
-}
 
-static void afsk_txStart(Afsk *af)
-{
-	if (!af->sending)
+#if CONFIG_AFSK_SLICERS > 1
+	/*
+	 * Run the additional slicers on the discriminator output.
+	 * Each one costs roughly 60 CPU cycles per sample, plus the
+	 * HDLC parsing once per bit.
+	 */
+	for (uint8_t i = 0; i < countof(af->slicer); i++)
 	{
-		af->phase_inc = MARK_INC;
-		af->phase_acc = 0;
-		af->stuff_cnt = 0;
-		af->sending = true;
-		af->preamble_len = DIV_ROUND(CONFIG_AFSK_PREAMBLE_LEN * BITRATE, 8000);
-		AFSK_DAC_IRQ_START(af->dac_ch);
+		AfskSlicer *s = &af->slicer[i];
+
+		s->iir_y = af->iir_x[0] + af->iir_x[1] + (s->iir_y >> s->lp_shift);
+
+		s->sampled_bits <<= 1;
+		s->sampled_bits |= (s->iir_y > s->threshold) ? 0 : 1;
+
+		if (afsk_sampleBit(s->sampled_bits, &s->pll, &s->found_bits)
+			&& !hdlc_parse(&s->hdlc, !EDGE_FOUND(s->found_bits), &s->rx_fifo))
+			s->status |= AFSK_RXFIFO_OVERRUN;
 	}
-	ATOMIC(af->trailer_len  = DIV_ROUND(CONFIG_AFSK_TRAILER_LEN  * BITRATE, 8000));
+#endif
 }
 
-#define BIT_STUFF_LEN 5
+#if CONFIG_AFSK_SAMPLE_BUFLEN
+/*
+ * Samples demodulated by each afsk_process_block() call, few enough
+ * not to delay the main loop, enough to amortize the call.
+ */
+#define AFSK_BLOCK_LEN 32
 
-#define SWITCH_TONE(inc)  (((inc) == MARK_INC) ? SPACE_INC : MARK_INC)
+#define SAMPLE_MASK (CONFIG_AFSK_SAMPLE_BUFLEN - 1)
+STATIC_ASSERT(CONFIG_AFSK_SAMPLE_BUFLEN <= 256 && !(CONFIG_AFSK_SAMPLE_BUFLEN & SAMPLE_MASK));
 
 /**
- * DAC ISR callback.
- * This function has to be called by the DAC ISR when a sample of the configured
- * channel has been converted out.
+ * Demodulate a block of the samples queued by afsk_adc_isr().
+ * Called by the modem channel read functions, so ax25_poll() keeps the
+ * demodulator running; call it directly if the channel is not polled
+ * often enough.
  *
  * \param af Afsk context to operate on.
- *
- * \return The next DAC output sample.
+ * \return the number of samples demodulated.
  */
-uint8_t afsk_dac_isr(Afsk *af)
+size_t afsk_process_block(Afsk *af)
+{
+	uint8_t tail = af->sample_tail;
+	size_t n;
+
+	for (n = 0; n < AFSK_BLOCK_LEN && tail != af->sample_head; n++)
+	{
+		afsk_demod(af, af->sample_buf[tail]);
+		tail = (tail + 1) & SAMPLE_MASK;
+		af->sample_tail = tail;
+	}
+	return n;
+}
+#endif
+
+/**
+ * ADC ISR callback.
+ * This function has to be called by the ADC ISR when a sample of the configured
+ * channel is available.
+ * When CONFIG_AFSK_SAMPLE_BUFLEN is set, the sample is only queued here
+ * and demodulated later by afsk_process_block().
+ * \param af Afsk context to operate on.
+ * \param curr_sample current sample from the ADC.
+ */
+void afsk_adc_isr(Afsk *af, afsk_sample_t curr_sample)
+{
+#if CONFIG_AFSK_SAMPLE_BUFLEN
+	/* Single producer ring: only the ISR writes the head */
+	uint8_t head = af->sample_head;
+	uint8_t next = (head + 1) & SAMPLE_MASK;
+
+	if (next == af->sample_tail)
+	{
+		af->sample_overrun++;
+		af->status |= AFSK_SAMPLE_OVERRUN;
+		return;
+	}
+	af->sample_buf[head] = curr_sample;
+	af->sample_head = next;
+#else
+	afsk_demod(af, curr_sample);
+#endif
+}
+
+static void afsk_txStart(Afsk *af)
+{
+	if (!af->sending)
+	{
+		af->phase_inc = MARK_INC;
+		af->phase_acc = 0;
+		af->stuff_cnt = 0;
+		af->tx_open = false;
+		af->sending = true;
+		af->preamble_len = af->tx_delay;
+		AFSK_DAC_IRQ_START(af->dac_ch);
+	}
+	ATOMIC(af->trailer_len = af->tx_tail);
+}
+
+#define BIT_STUFF_LEN 5
+
+#if CONFIG_AFSK_FX25
+/*
+ * In the tx FIFO, an unescaped HDLC_RESET is followed by a byte
+ * to be sent as it is, without bit stuffing: FX.25 frames are
+ * bit stuffed by afsk_write() to compute their parity.
+ */
+#define AFSK_TX_RAW HDLC_RESET
+
+/*
+ * Nothing left to modulate: FX.25 codewords are streamed from their
+ * buffer after the tx_ahead chars queued before them.
+ */
+#define AFSK_TX_EMPTY(af) \
+	(spsc_isempty(&(af)->tx_fifo) && !(af)->fx25.tx_left)
+
+/*
+ * Get the next byte of the FX.25 codeword, if it is its turn.
+ */
+INLINE bool afsk_fx25Next(Afsk *af)
+{
+	AfskFx25 *fx = &af->fx25;
+
+	if (!fx->tx_left || fx->tx_ahead)
+		return false;
+
+	af->curr_out = fx->tx_code[fx->tx_pos++];
+	fx->tx_left--;
+	af->bit_stuff = false;
+	af->tx_open = true;
+	return true;
+}
+#else
+#define AFSK_TX_EMPTY(af) spsc_isempty(&(af)->tx_fifo)
+#endif
+
+INLINE uint8_t afsk_txPop(Afsk *af)
+{
+	#if CONFIG_AFSK_FX25
+	if (af->fx25.tx_ahead)
+		af->fx25.tx_ahead--;
+	#endif
+	return spsc_pop(&af->tx_fifo);
+}
+
+#define SWITCH_TONE(inc)  (((inc) == MARK_INC) ? SPACE_INC : MARK_INC)
+
+/**
+ * DAC ISR callback.
+ * This function has to be called by the DAC ISR when a sample of the configured
+ * channel has been converted out.
+ *
+ * \param af Afsk context to operate on.
+ *
+ * \return The next DAC output sample.
+ */
+uint8_t afsk_dac_isr(Afsk *af)
 {
 	uint8_t value = 0;
 	AFSK_LED_TX_ON();
@@ -498,7 +1181,7 @@ uint8_t afsk_dac_isr(Afsk *af)
 		if (af->tx_bit == 0)
 		{
 			/* We have just finished transimitting a char, get a new one. */
-			if (fifo_isempty(&af->tx_fifo) && af->trailer_len == 0)
+			if (AFSK_TX_EMPTY(af) && af->trailer_len == 0)
 			{
 				AFSK_DAC_IRQ_STOP(af->dac_ch);
 				af->sending = false;
@@ -520,13 +1203,17 @@ uint8_t afsk_dac_isr(Afsk *af)
 				 */
 				if (af->preamble_len == 0)
 				{
-					if (fifo_isempty(&af->tx_fifo))
+					#if CONFIG_AFSK_FX25
+					if (afsk_fx25Next(af))
+						goto start_char;
+					#endif
+					if (spsc_isempty(&af->tx_fifo))
 					{
 						af->trailer_len--;
 						af->curr_out = HDLC_FLAG;
 					}
 					else
-						af->curr_out = fifo_pop(&af->tx_fifo);
+						af->curr_out = afsk_txPop(af);
 				}
 				else
 				{
@@ -537,21 +1224,48 @@ uint8_t afsk_dac_isr(Afsk *af)
 				/* Handle char escape */
 				if (af->curr_out == AX25_ESC)
 				{
-					if (fifo_isempty(&af->tx_fifo))
+					if (spsc_isempty(&af->tx_fifo))
 					{
 						AFSK_DAC_IRQ_STOP(af->dac_ch);
 						af->sending = false;
 						goto exit; // return;
 					}
 					else{
-						af->curr_out = fifo_pop(&af->tx_fifo);
+						af->curr_out = afsk_txPop(af);
+						af->tx_open = true;
+					}
+				}
+				#if CONFIG_AFSK_FX25
+				else if (af->curr_out == AFSK_TX_RAW)
+				{
+					if (spsc_isempty(&af->tx_fifo))
+					{
+						AFSK_DAC_IRQ_STOP(af->dac_ch);
+						af->sending = false;
+						goto exit; // return;
 					}
+					af->curr_out = afsk_txPop(af);
+					af->bit_stuff = false;
+					af->tx_open = true;
 				}
+				#endif
 				else if (af->curr_out == HDLC_FLAG || af->curr_out == HDLC_RESET){
 					/* If these chars are not escaped disable bit stuffing */
 					af->bit_stuff = false;
+
+					/* A flag after some data closes a frame */
+					if (af->curr_out == HDLC_FLAG && af->tx_open)
+					{
+						af->tx_open = false;
+						af->tx_frames++;
+					}
 				}
+				else
+					af->tx_open = true;
 			}
+			#if CONFIG_AFSK_FX25
+		start_char:
+			#endif
 			/* Start with LSB mask */
 			af->tx_bit = 0x01;
 		}
@@ -598,45 +1312,251 @@ uint8_t afsk_dac_isr(Afsk *af)
 
 	/* Get new sample and put it out on the DAC */
 	af->phase_acc += af->phase_inc;
-	af->phase_acc %= SIN_LEN;
 
 	af->sample_count--;
-	value = sin_sample(af->phase_acc);
+	value = pgm_read8(&sin_table[af->phase_acc >> PHASE_SHIFT]);
 exit:
 	AFSK_LED_TX_OFF();
 	return value;
 }
 
 
-static size_t afsk_read(KFile *fd, void *_buf, size_t size)
+/*
+ * Check if a demodulator FIFO is empty, demodulating
+ * the queued samples first if there are any.
+ */
+INLINE bool afsk_rxEmpty(Afsk *af, SpscBuffer *fifo)
+{
+	#if CONFIG_AFSK_SAMPLE_BUFLEN
+	if (spsc_isempty(fifo))
+		afsk_process_block(af);
+	#else
+	(void)af;
+	#endif
+	return spsc_isempty(fifo);
+}
+
+/*
+ * Read received data from a demodulator FIFO, honouring
+ * the CONFIG_AFSK_RXTIMEOUT setting for the first char only:
+ * then the chars already received are returned, in bulk.
+ */
+static size_t afsk_fifoRead(Afsk *af, SpscBuffer *fifo, void *_buf, size_t size)
 {
-	Afsk *af = AFSK_CAST(fd);
 	uint8_t *buf = (uint8_t *)_buf;
+	size_t n = 0;
 
-	#if CONFIG_AFSK_RXTIMEOUT == 0
-	while (size-- && !fifo_isempty_locked(&af->rx_fifo))
-	#else
-	while (size--)
+	#if CONFIG_AFSK_RXTIMEOUT != 0
+	#if CONFIG_AFSK_RXTIMEOUT != -1
+	ticks_t start = timer_clock();
 	#endif
+
+	while (size && afsk_rxEmpty(af, fifo))
 	{
+		cpu_relax();
 		#if CONFIG_AFSK_RXTIMEOUT != -1
-		ticks_t start = timer_clock();
+		if (timer_clock() - start > ms_to_ticks(CONFIG_AFSK_RXTIMEOUT))
+			return 0;
 		#endif
+	}
+	#endif
+
+	while (n < size && !afsk_rxEmpty(af, fifo))
+		n += spsc_pop_n(fifo, buf + n, size - n);
+
+	return n;
+}
+
+static size_t afsk_read(KFile *fd, void *_buf, size_t size)
+{
+	Afsk *af = AFSK_CAST(fd);
+	return afsk_fifoRead(af, &af->rx_fifo, _buf, size);
+}
+
+/*
+ * Queue a char for the modulator, waiting for room in the FIFO.
+ */
+static void afsk_txPush(Afsk *af, uint8_t c)
+{
+	while (spsc_isfull(&af->tx_fifo))
+		cpu_relax();
+
+	spsc_push(&af->tx_fifo, c);
+	afsk_txStart(af);
+}
+
+#if CONFIG_AFSK_FX25
+static void afsk_txRaw(Afsk *af, uint8_t c)
+{
+	afsk_txPush(af, AFSK_TX_RAW);
+	afsk_txPush(af, c);
+}
+
+/* Data of the codeword, after the tag */
+#define FX25_TX_DATA(fx) ((fx)->tx_code + FX25_TAG_LEN)
+
+/*
+ * Let the modulator stream len bytes of tx_code, after the chars
+ * already in the FIFO and before the ones pushed from now on.
+ */
+static void afsk_fx25Stream(Afsk *af, uint16_t start, uint16_t len)
+{
+	AfskFx25 *fx = &af->fx25;
+
+	ATOMIC(
+		fx->tx_ahead = spsc_count(&af->tx_fifo);
+		fx->tx_pos = start;
+		fx->tx_left = len;
+	);
+	afsk_txStart(af);
+}
+
+/*
+ * Check if the modulator is still streaming tx_code.
+ */
+INLINE bool afsk_fx25Busy(AfskFx25 *fx)
+{
+	uint16_t left;
+
+	ATOMIC(left = fx->tx_left);
+	return left != 0;
+}
 
-		while (fifo_isempty_locked(&af->rx_fifo))
+/*
+ * Add a bit to the bitstream of the frame being sent. Frames too long
+ * for a codeword are sent plain, as soon as their bytes are ready.
+ */
+static void afsk_fx25PutBit(Afsk *af, bool bit)
+{
+	AfskFx25 *fx = &af->fx25;
+
+	fx->tx_cur = (fx->tx_cur >> 1) | (bit ? 0x80 : 0);
+	if (++fx->tx_bits < 8)
+		return;
+	fx->tx_bits = 0;
+
+	if (!fx->tx_over && fx->tx_len == FX25_MAX_DATA)
+	{
+		afsk_fx25Stream(af, FX25_TAG_LEN, fx->tx_len);
+		fx->tx_over = true;
+	}
+
+	if (fx->tx_over)
+		afsk_txRaw(af, fx->tx_cur);
+	else
+		FX25_TX_DATA(fx)[fx->tx_len++] = fx->tx_cur;
+}
+
+static void afsk_fx25PutFlag(Afsk *af)
+{
+	for (uint8_t i = 0; i < 8; i++)
+		afsk_fx25PutBit(af, HDLC_FLAG & BV(i));
+	af->fx25.tx_ones = 0;
+}
+
+/*
+ * Send the bitstream of a frame, in a codeword if it fits one.
+ * The codeword data is padded with flags.
+ */
+static void afsk_fx25Send(Afsk *af)
+{
+	AfskFx25 *fx = &af->fx25;
+	int8_t idx = -1;
+
+	if (!fx->tx_over)
+		idx = fx25_pickCode(fx->tx_check, fx->tx_len + (fx->tx_bits ? 1 : 0));
+
+	if (idx < 0)
+	{
+		/* Plain AX.25, complete the last byte with flag bits */
+		for (uint8_t i = 0; fx->tx_bits; i++)
+			afsk_fx25PutBit(af, HDLC_FLAG & BV(i));
+		if (!fx->tx_over)
+			afsk_fx25Stream(af, FX25_TAG_LEN, fx->tx_len);
+		return;
+	}
+
+	Fx25Code code;
+	fx25_code(idx, &code);
+	for (uint8_t i = 0; fx->tx_bits || fx->tx_len < code.k; i = (i + 1) % 8)
+		afsk_fx25PutBit(af, HDLC_FLAG & BV(i));
+
+	uint8_t nroots = code.n - code.k;
+	uint8_t genpoly[RS_MAX_ROOTS + 1];
+	uint8_t *parity = FX25_TX_DATA(fx) + code.k;
+
+	rs_genpoly(genpoly, nroots);
+	memset(parity, 0, nroots);
+	rs_encode(genpoly, nroots, FX25_TX_DATA(fx), code.k, parity);
+	rs_encode(genpoly, nroots, NULL, RS_NN - code.n, parity);
+
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		fx->tx_code[i] = code.tag_lo >> (i * 8);
+		fx->tx_code[i + 4] = code.tag_hi >> (i * 8);
+	}
+	afsk_fx25Stream(af, 0, FX25_TAG_LEN + code.n);
+}
+
+/*
+ * Bit stuff the frames written by ax25 (escaped chars between HDLC
+ * flags) and send them as FX.25 frames.
+ */
+static void afsk_fx25Write(Afsk *af, uint8_t c)
+{
+	AfskFx25 *fx = &af->fx25;
+
+	if (!fx->tx_esc && c == AX25_ESC)
+	{
+		fx->tx_esc = true;
+		return;
+	}
+
+	if (!fx->tx_esc && c == HDLC_FLAG)
+	{
+		if (fx->tx_frame && fx->tx_data)
 		{
-			cpu_relax();
-			#if CONFIG_AFSK_RXTIMEOUT != -1
-			if (timer_clock() - start > ms_to_ticks(CONFIG_AFSK_RXTIMEOUT))
-				return buf - (uint8_t *)_buf;
-			#endif
+			afsk_fx25PutFlag(af);
+			afsk_fx25Send(af);
+			/* Just to tell afsk_txFrames() the frame ended */
+			afsk_txPush(af, HDLC_FLAG);
+			fx->tx_frame = false;
 		}
-
-		*buf++ = fifo_pop_locked(&af->rx_fifo);
+		else
+		{
+			/* Opening flag, after the previous codeword has been sent */
+			while (afsk_fx25Busy(fx))
+				cpu_relax();
+			fx->tx_frame = true;
+			fx->tx_data = false;
+			fx->tx_over = false;
+			fx->tx_len = 0;
+			fx->tx_bits = 0;
+			afsk_fx25PutFlag(af);
+		}
+		return;
 	}
 
-	return buf - (uint8_t *)_buf;
+	fx->tx_esc = false;
+	if (!fx->tx_frame)
+		return;
+
+	fx->tx_data = true;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		bool bit = c & BV(i);
+
+		afsk_fx25PutBit(af, bit);
+		if (!bit)
+			fx->tx_ones = 0;
+		else if (++fx->tx_ones == BIT_STUFF_LEN)
+		{
+			afsk_fx25PutBit(af, 0);
+			fx->tx_ones = 0;
+		}
+	}
 }
+#endif
 
 static size_t afsk_write(KFile *fd, const void *_buf, size_t size)
 {
@@ -645,11 +1565,14 @@ static size_t afsk_write(KFile *fd, const void *_buf, size_t size)
 
 	while (size--)
 	{
-		while (fifo_isfull_locked(&af->tx_fifo))
-			cpu_relax();
-
-		fifo_push_locked(&af->tx_fifo, *buf++);
-		afsk_txStart(af);
+		#if CONFIG_AFSK_FX25
+		if (af->fx25.tx_check)
+		{
+			afsk_fx25Write(af, *buf++);
+			continue;
+		}
+		#endif
+		afsk_txPush(af, *buf++);
 	}
 
 	return buf - (const uint8_t *)_buf;
@@ -679,6 +1602,273 @@ static void afsk_clearerr(KFile *fd)
 	ATOMIC(af->status = 0);
 }
 
+#if CONFIG_AFSK_FX25
+/*
+ * Chars pushed to the tx FIFO by a char of an FX.25 frame at most:
+ * two raw bytes of the bitstream and the closing flag.
+ */
+#define AFSK_FX25_TX_MAX 5
+#endif
+
+/**
+ * Get the room in the transmit FIFO: this many chars can be written
+ * to the modem channel without waiting for the modulator.
+ * FX.25 frames are bit stuffed in a buffer streamed by the modulator,
+ * so there is no room for a new frame until the previous one is out.
+ *
+ * \param fd modem channel.
+ */
+size_t afsk_txRoom(KFile *fd)
+{
+	Afsk *af = AFSK_CAST(fd);
+	size_t room = spsc_len(&af->tx_fifo) - spsc_count(&af->tx_fifo);
+	#if CONFIG_AFSK_FX25
+	AfskFx25 *fx = &af->fx25;
+	if (fx->tx_check)
+	{
+		/* Only a frame too long for a codeword bypasses the buffer */
+		if (afsk_fx25Busy(fx) && !(fx->tx_frame && fx->tx_over))
+			return 0;
+		room /= AFSK_FX25_TX_MAX;
+	}
+	#endif
+	return room;
+}
+
+/**
+ * Get the number of frames sent by the modulator, wrapping around.
+ * A frame is sent when its closing flag leaves the transmit FIFO,
+ * after the CRC has been modulated.
+ *
+ * \param fd modem channel.
+ */
+uint8_t afsk_txFrames(KFile *fd)
+{
+	Afsk *af = AFSK_CAST(fd);
+	return af->tx_frames;
+}
+
+
+/* Time the carrier must be lost before the channel is clear, with a slot time */
+#define AFSK_DCD_HOLD_MS 20
+
+/**
+ * Set the p-persistent CSMA parameters of the next transmissions,
+ * a persistence of 63 and a slot time of 100ms after afsk_init().
+ *
+ * \param af Afsk context to operate on.
+ * \param persistence probability to transmit in each slot, times 256, minus 1.
+ * \param slot_ms slot time, in ms; with 0 the channel is clear as soon as
+ *        the carrier is lost, not AFSK_DCD_HOLD_MS later.
+ * \param full_duplex true to transmit without waiting for the channel.
+ */
+void afsk_setCsma(Afsk *af, uint8_t persistence, uint16_t slot_ms, bool full_duplex)
+{
+	af->csma.persistence = persistence;
+	af->csma.slot = ms_to_ticks(slot_ms);
+	af->csma.full_duplex = full_duplex;
+}
+
+/**
+ * Channel access of a new transmission, to be polled from the main loop
+ * until it returns true; it never waits.
+ * The transmission waits for the channel to be clear (see afsk_dcd()),
+ * then, once per slot time, it starts with probability
+ * (persistence + 1) / 256, otherwise it is deferred to the next slot.
+ * The channel stays granted while the modulator is sending, so frames
+ * written back to back go out in the same transmission.
+ *
+ * \param fd modem channel.
+ * \return true if the transmission can start now.
+ */
+bool afsk_txClear(KFile *fd)
+{
+	Afsk *af = AFSK_CAST(fd);
+	AfskCsma *csma = &af->csma;
+
+	if (af->sending || csma->full_duplex)
+		return true;
+
+	switch (csma->state)
+	{
+	case AFSK_CSMA_DEFER:
+		if (timer_clock() - csma->start < csma->slot)
+			return false;
+		/* Fall through */
+	case AFSK_CSMA_TX:
+		csma->state = AFSK_CSMA_WAIT;
+		/* Fall through */
+	case AFSK_CSMA_WAIT:
+	default:
+		if (afsk_dcd(af))
+		{
+			csma->start = timer_clock();
+			return false;
+		}
+		/* Clear once the carrier has been lost for a while, not on a dip of it */
+		if (csma->slot && timer_clock() - csma->start < ms_to_ticks(AFSK_DCD_HOLD_MS))
+			return false;
+		break;
+	}
+
+	uint16_t r = rand();
+	if ((uint8_t)((r >> 8) ^ r) <= csma->persistence)
+	{
+		csma->state = AFSK_CSMA_TX;
+		return true;
+	}
+
+	csma->defers++;
+	csma->start = timer_clock();
+	csma->state = AFSK_CSMA_DEFER;
+	return false;
+}
+
+
+#if CONFIG_AFSK_SLICERS > 1
+INLINE AfskSlicer *AFSK_SLICER_CAST(KFile *fd)
+{
+	ASSERT(fd->_type == KFT_AFSK_SLICER);
+	return (AfskSlicer *)fd;
+}
+
+static size_t afsk_slicerRead(KFile *fd, void *_buf, size_t size)
+{
+	AfskSlicer *s = AFSK_SLICER_CAST(fd);
+	return afsk_fifoRead(s->af, &s->rx_fifo, _buf, size);
+}
+
+static int afsk_slicerError(KFile *fd)
+{
+	AfskSlicer *s = AFSK_SLICER_CAST(fd);
+	int err;
+
+	ATOMIC(err = s->status);
+	return err;
+}
+
+static void afsk_slicerClearerr(KFile *fd)
+{
+	AfskSlicer *s = AFSK_SLICER_CAST(fd);
+	ATOMIC(s->status = 0);
+}
+#endif
+
+#if CONFIG_AFSK_FX25
+INLINE AfskFx25 *AFSK_FX25_CAST(KFile *fd)
+{
+	ASSERT(fd->_type == KFT_AFSK_FX25);
+	return (AfskFx25 *)fd;
+}
+
+/*
+ * Correct the codeword received by the ISR, then parse its HDLC
+ * bitstream as the frames are read.
+ */
+static void afsk_fx25Decode(AfskFx25 *fx)
+{
+	if (fx->rx_state != FX25_READY)
+		return;
+
+	if (fx->parse_pos == fx->parse_end)
+	{
+		uint8_t nroots = fx->rx_n - fx->rx_k;
+		uint8_t *pad = &fx->rx_block[fx->rx_k];
+		uint8_t pad_len = RS_NN - fx->rx_n;
+
+		memset(pad, 0, pad_len);
+		int fixed = rs_decode(fx->rx_block, nroots);
+
+		/* Corrections in the padding mean the codeword was wrongly decoded */
+		for (uint8_t i = 0; fixed > 0 && i < pad_len; i++)
+			if (pad[i])
+				fixed = -1;
+
+		if (fixed < 0)
+		{
+			LOG_INFO("FX.25 codeword not corrected\n");
+			fx->rx_bad++;
+			fx->rx_state = FX25_HUNT;
+			return;
+		}
+
+		fx->rx_blocks++;
+		fx->rx_fixed += fixed;
+		fx->parse_pos = 0;
+		fx->parse_end = fx->rx_k * 8;
+		fx->hdlc.demod_bits = 0;
+		fx->hdlc.rxstart = false;
+	}
+
+	/* Parse until there is something to read, a bit pushes at most 2 chars */
+	while (fx->parse_pos < fx->parse_end && spsc_isempty(&fx->rx_fifo))
+	{
+		bool bit = fx->rx_block[fx->parse_pos / 8] & BV(fx->parse_pos % 8);
+		hdlc_parse(&fx->hdlc, bit, &fx->rx_fifo);
+		fx->parse_pos++;
+	}
+
+	if (fx->parse_pos == fx->parse_end)
+		fx->rx_state = FX25_HUNT;
+}
+
+static size_t afsk_fx25Read(KFile *fd, void *_buf, size_t size)
+{
+	AfskFx25 *fx = AFSK_FX25_CAST(fd);
+	uint8_t *buf = (uint8_t *)_buf;
+
+	while (size--)
+	{
+		afsk_fx25Decode(fx);
+		if (spsc_isempty(&fx->rx_fifo))
+			break;
+		*buf++ = spsc_pop(&fx->rx_fifo);
+	}
+	return buf - (uint8_t *)_buf;
+}
+
+static int afsk_fx25Error(KFile *fd)
+{
+	(void)fd;
+	return 0;
+}
+
+static void afsk_fx25Clearerr(KFile *fd)
+{
+	(void)fd;
+}
+#endif
+
+/**
+ * Set the preamble and trailer lengths (TXDELAY and TXtail) of the
+ * next transmissions, CONFIG_AFSK_PREAMBLE_LEN and CONFIG_AFSK_TRAILER_LEN
+ * after afsk_init().
+ *
+ * \param af Afsk context to operate on.
+ * \param preamble_ms time the radio needs to key up, in ms.
+ * \param trailer_ms time to wait before the radio is unkeyed, in ms.
+ */
+void afsk_setTxDelay(Afsk *af, uint16_t preamble_ms, uint16_t trailer_ms)
+{
+	ATOMIC(
+		af->tx_delay = DIV_ROUND(preamble_ms * (uint32_t)BITRATE, 8000);
+		af->tx_tail = DIV_ROUND(trailer_ms * (uint32_t)BITRATE, 8000);
+	);
+}
+
+#if CONFIG_AFSK_EQ
+/**
+ * Set the twist the equalizer starts from, e.g. the one measured
+ * before on the same radio (see afsk_twist()); it is 0 after afsk_init().
+ * \param af Afsk context to operate on.
+ * \param twist_db level of the space tone over the mark tone, in dB.
+ */
+void afsk_setTwist(Afsk *af, int8_t twist_db)
+{
+	twist_db = MINMAX((int8_t)-AFSK_EQ_TWIST_MAX, twist_db, (int8_t)AFSK_EQ_TWIST_MAX);
+	ATOMIC(afsk_eqSet(&af->eq, twist_db));
+}
+#endif
 
 /**
  * Initialize an AFSK1200 modem.
@@ -697,14 +1887,24 @@ void afsk_init(Afsk *af, int adc_ch, int dac_ch)
 
 	af->phase_inc = MARK_INC;
 
+	#if CONFIG_AFSK_PLL == AFSK_PLL_PI
+	af->pll.err = PLL_INC * 2;
+	#endif
+
+	#if CONFIG_AFSK_AGC
+	af->agc_gain = AGC_GAIN_UNITY;
+	#endif
+
 	fifo_init(&af->delay_fifo, (uint8_t *)af->delay_buf, sizeof(af->delay_buf));
-	fifo_init(&af->rx_fifo, af->rx_buf, sizeof(af->rx_buf));
+	spsc_init(&af->rx_fifo, af->rx_buf, sizeof(af->rx_buf));
 
 	/* Fill sample FIFO with 0 */
 	for (int i = 0; i < SAMPLEPERBIT / 2; i++)
 		fifo_push(&af->delay_fifo, 0);
 
-	fifo_init(&af->tx_fifo, af->tx_buf, sizeof(af->tx_buf));
+	spsc_init(&af->tx_fifo, af->tx_buf, sizeof(af->tx_buf));
+	afsk_setTxDelay(af, CONFIG_AFSK_PREAMBLE_LEN, CONFIG_AFSK_TRAILER_LEN);
+	afsk_setCsma(af, 63, 100, false);
 
 	AFSK_ADC_INIT(adc_ch, af);
 	AFSK_DAC_INIT(dac_ch, af);
@@ -720,4 +1920,34 @@ void afsk_init(Afsk *af, int adc_ch, int dac_ch)
 	af->fd.flush = afsk_flush;
 	af->fd.error = afsk_error;
 	af->fd.clearerr = afsk_clearerr;
+
+	#if CONFIG_AFSK_SLICERS > 1
+	for (int i = 0; i < CONFIG_AFSK_SLICERS - 1; i++)
+	{
+		AfskSlicer *s = &af->slicer[i];
+
+		s->af = af;
+		#if CONFIG_AFSK_PLL == AFSK_PLL_PI
+		s->pll.err = PLL_INC * 2;
+		#endif
+		s->lp_shift = slicer_setup[i].lp_shift;
+		s->threshold = slicer_setup[i].threshold;
+		spsc_init(&s->rx_fifo, s->rx_buf, sizeof(s->rx_buf));
+
+		DB(s->fd._type = KFT_AFSK_SLICER);
+		s->fd.read = afsk_slicerRead;
+		s->fd.error = afsk_slicerError;
+		s->fd.clearerr = afsk_slicerClearerr;
+	}
+	#endif
+
+	#if CONFIG_AFSK_FX25
+	af->fx25.tx_check = CONFIG_AFSK_FX25_TX_CHECK;
+	spsc_init(&af->fx25.rx_fifo, af->fx25.rx_buf, sizeof(af->fx25.rx_buf));
+
+	DB(af->fx25.fd._type = KFT_AFSK_FX25);
+	af->fx25.fd.read = afsk_fx25Read;
+	af->fx25.fd.error = afsk_fx25Error;
+	af->fx25.fd.clearerr = afsk_fx25Clearerr;
+	#endif
 }
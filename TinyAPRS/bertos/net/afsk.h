@@ -49,8 +49,15 @@
 #include <cfg/compiler.h>
 
 #include <io/kfile.h>
+#include <drv/timer.h>
 
 #include <struct/fifobuf.h>
+#include <struct/spscbuf.h>
+
+#if CONFIG_AFSK_FX25
+	#include <algo/rs.h>
+	#include <net/fx25.h>
+#endif
 
 
 
@@ -70,6 +77,19 @@
 
 #define SAMPLEPERBIT (SAMPLERATE / BITRATE)
 
+/**
+ * ADC samples passed to afsk_adc_isr(), centered on 0.
+ * With CONFIG_AFSK_AGC the whole 10 bit conversion is passed,
+ * the DC offset and the level are adjusted by the demodulator.
+ */
+#if CONFIG_AFSK_AGC
+	typedef int16_t afsk_sample_t;
+	#define AFSK_SAMPLE_BITS 10
+#else
+	typedef int8_t afsk_sample_t;
+	#define AFSK_SAMPLE_BITS 8
+#endif
+
 /**
  * HDLC (High-Level Data Link Control) context.
  * Maybe to be moved in a separate HDLC module one day.
@@ -82,19 +102,281 @@ typedef struct Hdlc
 	bool rxstart;       ///< True if an HDLC_FLAG char has been found in the bitstream.
 } Hdlc;
 
-//#define FIR_MAX_TAPS 16
-//typedef struct FIR
-//{
-//	int8_t taps;
-//	int8_t coef[FIR_MAX_TAPS];
-//	int16_t mem[FIR_MAX_TAPS];
-//} FIR;
+/**
+ * Bit clock recovery state.
+ */
+typedef struct AfskPll
+{
+#if CONFIG_AFSK_PLL == AFSK_PLL_PI
+	uint16_t phase; ///< Bit phase, the bit is sampled when it wraps around
+	int16_t freq;   ///< Integral term, bitrate correction
+	uint16_t err;   ///< Average phase error of the edges
+#else
+	/**
+	 * Current phase, needed to know when the bitstream at ADC speed
+	 * should be sampled.
+	 */
+	int8_t curr_phase;
+#endif
+} AfskPll;
+
+#if CONFIG_AFSK_WEAK_BITS
+/**
+ * Low confidence bits of the received frames.
+ * Positions are counted in bits from the start of the frame,
+ * least significant bit of each byte first.
+ */
+typedef struct AfskWeakBits
+{
+	uint16_t len; ///< Bytes received so far in the current frame
+	uint8_t cnt;  ///< Low confidence bits in the current frame
+	uint16_t pos[CONFIG_AFSK_WEAK_BITS]; ///< Their positions
+
+	uint16_t last_len; ///< Length of the last complete frame
+	uint8_t last_cnt;  ///< Low confidence bits in the last complete frame
+	uint16_t last_pos[CONFIG_AFSK_WEAK_BITS]; ///< Their positions
+} AfskWeakBits;
+#endif
+
+/**
+ * Channel access states of the next transmission, see afsk_txClear().
+ */
+enum AfskCsmaState
+{
+	AFSK_CSMA_WAIT,  ///< Waiting for the channel to be clear
+	AFSK_CSMA_DEFER, ///< Channel clear, backing off for a slot time
+	AFSK_CSMA_TX,    ///< Channel granted, transmitting
+};
+
+/**
+ * p-persistent CSMA channel access.
+ */
+typedef struct AfskCsma
+{
+	uint8_t state;       ///< One of AfskCsmaState
+	uint8_t persistence; ///< Transmit with probability (persistence + 1) / 256 in each slot
+	bool full_duplex;    ///< Transmit without waiting for the channel
+	ticks_t slot;        ///< Slot time
+	ticks_t start;       ///< Start of the current slot, or last time a carrier was detected
+	uint16_t defers;     ///< Slots the transmissions were deferred
+} AfskCsma;
+
+#if CONFIG_AFSK_CHANNEL_LOAD
+#if !CONFIG_AFSK_CARRIER_DETECT_FLAG
+	#error CONFIG_AFSK_CHANNEL_LOAD needs CONFIG_AFSK_CARRIER_DETECT_FLAG
+#endif
+
+/**
+ * Channel load measures, see afsk_channelLoad().
+ */
+enum AfskLoadKind
+{
+	AFSK_LOAD_ENERGY, ///< Signal on the discriminator, the carrier detect flag
+	AFSK_LOAD_SYNC,   ///< HDLC flags found with a carrier (see afsk_dcd()), frames being received
+	AFSK_LOAD_KINDS,
+};
+
+/**
+ * Sliding windows of the channel load, see afsk_channelLoad().
+ */
+enum AfskLoadWindow
+{
+	AFSK_LOAD_1S,    ///< Last second
+	AFSK_LOAD_1MIN,  ///< Last minute, in 10 s steps
+	AFSK_LOAD_10MIN, ///< Last 10 minutes, in 1 minute steps
+};
+
+/**
+ * Busy time of one measure of the channel, in percent.
+ */
+typedef struct AfskLoad
+{
+	uint16_t bits;     ///< Busy bits in the current second
+	uint16_t sum;      ///< Sum of the seconds of the current 10 s
+	uint8_t sec;       ///< Last second
+	uint8_t tens[6];   ///< Last minute, each 10 s
+	uint8_t mins[10];  ///< Last 10 minutes, each minute
+} AfskLoad;
+
+/**
+ * Channel load meter, updated by the demodulator once per bit.
+ */
+typedef struct AfskLoadMeter
+{
+	AfskLoad load[AFSK_LOAD_KINDS];
+	uint16_t bits;     ///< Bits in the current second
+	uint8_t secs;      ///< Seconds in the current 10 s
+	uint8_t ten;       ///< Next 10 s slot
+	uint8_t min;       ///< Next minute slot
+	uint8_t tens_cnt;  ///< Slots of \a tens filled
+	uint8_t mins_cnt;  ///< Slots of \a mins filled
+} AfskLoadMeter;
+#endif
+
+#if CONFIG_AFSK_EQ
+#if !CONFIG_AFSK_AGC
+	#error CONFIG_AFSK_EQ needs CONFIG_AFSK_AGC
+#endif
+
+/** Largest twist measured by the equalizer, in dB */
+#define AFSK_EQ_TWIST_MAX 12
+
+/** Largest space tone cut of the equalizer filter, in dB */
+#define AFSK_EQ_CUT_MAX 6
+
+/**
+ * Mark/space twist equalizer, a first order tilt filter in front of the
+ * discriminator. On each pair of back to back HDLC flags the level of the
+ * long tone of the flag is compared with the level of its single bit of
+ * the other tone, moving the measured twist by 1dB towards it; the filter
+ * cuts the space tone by the twist when it is the louder one.
+ */
+typedef struct AfskEq
+{
+	int8_t twist;     ///< Space tone level over the mark tone, in dB
+	int8_t cut;       ///< Space tone cut of the filter under the mark tone, in dB
+	int8_t c;         ///< Filter zero, 1.7 fixed point
+	int8_t p;         ///< Filter pole, 1.7 fixed point
+	int8_t vote;      ///< Flags with more (> 0) or less (< 0) twist than measured
+	int16_t x1;       ///< Previous filter input
+	int16_t y1;       ///< Previous filter output
+	uint16_t acc;     ///< Level of the current bit, sum of the sample magnitudes
+	uint16_t run;     ///< Level of the 1 bits since the last 0
+	uint8_t flag_gap; ///< Bits since the last HDLC flag
+} AfskEq;
+#endif
+
+struct Afsk;
+
+#if CONFIG_AFSK_SLICERS > 1
+/**
+ * Additional demodulator slicer.
+ *
+ * A slicer shares the frequency discriminator of the main demodulator,
+ * but runs its own lowpass filter, bit threshold, bit clock and HDLC
+ * decoder, so it can recover frames the main one misses.
+ * Received data is read through \a fd, in the same format of the
+ * main modem channel.
+ */
+typedef struct AfskSlicer
+{
+	/** Base "class", read only */
+	KFile fd;
+
+	/** Modem the slicer belongs to */
+	struct Afsk *af;
+
+	/** Lowpass filter feedback shift, selects the filter cutoff */
+	uint8_t lp_shift;
+
+	/** Filter output level separating mark from space */
+	int16_t threshold;
+
+	/** IIR filter Y cell */
+	int16_t iir_y;
+
+	/** Bits sampled at ADC speed */
+	uint8_t sampled_bits;
+
+	/** Bit clock recovery */
+	AfskPll pll;
+
+	/** Bits found at the bitrate speed */
+	uint8_t found_bits;
+
+	/** Slicer status, same errors of the main modem channel */
+	volatile int status;
+
+	/** Hdlc context */
+	Hdlc hdlc;
+
+	/** FIFO for received data */
+	SpscBuffer rx_fifo;
+
+	/** FIFO rx buffer */
+	uint8_t rx_buf[CONFIG_AFSK_RX_BUFLEN];
+} AfskSlicer;
+#endif
+
+#if CONFIG_AFSK_FILTER == AFSK_FIR
+#define FIR_MAX_TAPS 16
+typedef struct FIR
+{
+	int8_t taps;
+	int8_t coef[FIR_MAX_TAPS];
+	int16_t mem[FIR_MAX_TAPS];
+} FIR;
+#endif
+
+#if CONFIG_AFSK_FX25
+/**
+ * FX.25 encoder and decoder.
+ */
+typedef struct AfskFx25
+{
+	/** Channel of the frames recovered by the FX.25 decoder */
+	KFile fd;
+
+	/** Last 64 bits received, looking for a correlation tag */
+	uint32_t tag_lo;
+	uint32_t tag_hi;
+
+	volatile uint8_t rx_state; ///< Looking for a tag, receiving or decoding a codeword
+	int8_t rx_code;  ///< Code of the codeword
+	uint8_t rx_n;    ///< Codeword bytes sent
+	uint8_t rx_k;    ///< Codeword data bytes sent
+	uint8_t rx_len;  ///< Codeword bytes received so far
+	uint8_t rx_bits; ///< Bits of the current byte received so far
+	uint8_t rx_cur;  ///< Current byte
+
+	/** Codeword, data at the start, parity at the end and zeros in between */
+	uint8_t rx_block[RS_NN];
+
+	uint16_t parse_pos; ///< Next data bit of the corrected codeword to parse
+	uint16_t parse_end; ///< Data bits of the corrected codeword
+	Hdlc hdlc;          ///< Hdlc context for the corrected codeword
+
+	/** FIFO for the recovered frames */
+	SpscBuffer rx_fifo;
+	uint8_t rx_buf[4];
+
+	uint16_t rx_blocks; ///< Codewords decoded
+	uint16_t rx_fixed;  ///< Bytes corrected in the codewords
+	uint16_t rx_bad;    ///< Codewords with too many errors
+
+	/** Parity bytes of the sent frames, 0 to send plain AX.25 frames */
+	uint8_t tx_check;
+
+	bool tx_frame; ///< An HDLC flag opened a frame
+	bool tx_data;  ///< The frame has data
+	bool tx_esc;   ///< The next char is escaped
+	bool tx_over;  ///< The frame doesn't fit a codeword, sending it plain
+	uint8_t tx_ones;  ///< Consecutive 1 bits, for bit stuffing
+	uint8_t tx_bits;  ///< Bits of the current byte
+	uint8_t tx_cur;   ///< Current byte
+	uint8_t tx_len;   ///< Bytes of the bitstream so far
+
+	/**
+	 * Tag, bit stuffed frame (the data of the codeword) and parity.
+	 * The modulator streams it from here, not from the tx FIFO.
+	 */
+	uint8_t tx_code[FX25_TAG_LEN + RS_NN];
+	uint16_t tx_pos;            ///< Next byte of tx_code to modulate
+	volatile uint16_t tx_left;  ///< Bytes of tx_code left to modulate
+	volatile spsc_idx_t tx_ahead; ///< FIFO chars to modulate before tx_code
+} AfskFx25;
+#endif
 
 /**
  * RX FIFO buffer full error.
  */
 #define AFSK_RXFIFO_OVERRUN BV(0)
 
+/**
+ * ADC sample lost because the demodulator is late.
+ */
+#define AFSK_SAMPLE_OVERRUN BV(1)
+
 /**
  * AFSK1200 modem context.
  */
@@ -124,7 +406,8 @@ typedef struct Afsk
 	/** Counter for bit stuffing */
 	uint8_t stuff_cnt;
 	/**
-	 * DDS phase accumulator for generating modulated data.
+	 * DDS phase accumulator for generating modulated data,
+	 * a full sine period is the whole 16 bit range.
 	 */
 	uint16_t phase_acc;
 
@@ -142,17 +425,31 @@ typedef struct Afsk
 	int8_t delay_buf[SAMPLEPERBIT / 2 + 1];
 
 	/** FIFO for received data */
-	FIFOBuffer rx_fifo;
+	SpscBuffer rx_fifo;
 
 	/** FIFO rx buffer */
 	uint8_t rx_buf[CONFIG_AFSK_RX_BUFLEN];
 
 	/** FIFO for transmitted data */
-	FIFOBuffer tx_fifo;
+	SpscBuffer tx_fifo;
 
 	/** FIFO tx buffer */
 	uint8_t tx_buf[CONFIG_AFSK_TX_BUFLEN];
 
+#if CONFIG_AFSK_AGC
+	/** DC offset of the ADC samples, times 32 */
+	int16_t agc_dc;
+
+	/** Gain from the ADC samples to the discriminator input, 8.8 fixed point */
+	uint16_t agc_gain;
+
+	/** Peak of the scaled samples in the current bit */
+	uint8_t agc_peak;
+
+	/** Samples of the current bit */
+	uint8_t agc_cnt;
+#endif
+
 	/** IIR filter X cells, used to filter sampled data by the demodulator */
 	int16_t iir_x[2];
 
@@ -171,11 +468,8 @@ typedef struct Afsk
 	uint8_t cd_state;
 #endif
 
-	/**
-	 * Current phase, needed to know when the bitstream at ADC speed
-	 * should be sampled.
-	 */
-	int8_t curr_phase;
+	/** Bit clock recovery */
+	AfskPll pll;
 
 	/** Bits found by the demodulator at the correct bitrate speed. */
 	uint8_t found_bits;
@@ -192,6 +486,11 @@ typedef struct Afsk
 	/** Hdlc context */
 	Hdlc hdlc;
 
+#if CONFIG_AFSK_WEAK_BITS
+	/** Low confidence bits of the main demodulator frames */
+	AfskWeakBits weak;
+#endif
+
 	/**
 	 * Preamble length.
 	 * When the AFSK modem wants to send data, before sending the actual data,
@@ -207,6 +506,55 @@ typedef struct Afsk
 	 * This helps to synchronize the demodulator filters on the receiver side.
 	 */
 	uint16_t trailer_len;
+
+	/** Preamble length of the next transmissions (TXDELAY), in HDLC flags */
+	uint16_t tx_delay;
+
+	/** Trailer length of the next transmissions (TXtail), in HDLC flags */
+	uint16_t tx_tail;
+
+	/** True from the first char of a frame sent by the modulator to its closing flag */
+	bool tx_open;
+
+	/** Frames sent by the modulator, wrapping around (see afsk_txFrames()) */
+	volatile uint8_t tx_frames;
+
+	/** Channel access of the next transmission */
+	AfskCsma csma;
+
+#if CONFIG_AFSK_SAMPLE_BUFLEN
+	/** ADC samples waiting to be demodulated */
+	afsk_sample_t sample_buf[CONFIG_AFSK_SAMPLE_BUFLEN];
+
+	/** Sample ring write index, only changed by the ADC ISR */
+	volatile uint8_t sample_head;
+
+	/** Sample ring read index, only changed by afsk_process_block() */
+	volatile uint8_t sample_tail;
+
+	/** Number of ADC samples lost because the ring was full */
+	volatile uint16_t sample_overrun;
+#endif
+
+#if CONFIG_AFSK_CHANNEL_LOAD
+	/** Time the channel is busy */
+	AfskLoadMeter load;
+#endif
+
+#if CONFIG_AFSK_EQ
+	/** Mark/space twist equalizer */
+	AfskEq eq;
+#endif
+
+#if CONFIG_AFSK_SLICERS > 1
+	/** Additional slicers, fed with the main demodulator discriminator */
+	AfskSlicer slicer[CONFIG_AFSK_SLICERS - 1];
+#endif
+
+#if CONFIG_AFSK_FX25
+	/** FX.25 forward error correction */
+	AfskFx25 fx25;
+#endif
 } Afsk;
 
 #define KFT_AFSK MAKE_ID('A', 'F', 'S', 'K')
@@ -218,9 +566,109 @@ INLINE Afsk *AFSK_CAST(KFile *fd)
 }
 
 
-void afsk_adc_isr(Afsk *af, int8_t sample);
+#define KFT_AFSK_SLICER MAKE_ID('A', 'F', 'S', 'L')
+
+/**
+ * Lock quality of a bit clock recovery loop.
+ * \return 0 when the edges are random, 255 when all of them
+ *         are where the loop expects.
+ */
+INLINE uint8_t afsk_pllLock(const AfskPll *pll)
+{
+#if CONFIG_AFSK_PLL == AFSK_PLL_PI
+	/* Random edges average a quarter of the bit period away */
+	return (pll->err >= 0x4000) ? 0 : 255 - (pll->err >> 6);
+#else
+	(void)pll;
+	return 255;
+#endif
+}
+
+/*
+ * Bit clock lock of the main demodulator from which a carrier is detected:
+ * the average edge error is below 1.4 samples, while random edges
+ * average 2 samples (a quarter of the bit period).
+ */
+#define AFSK_DCD_LOCK 80
+
+/**
+ * Data carrier detect: true while the bit clock of the main demodulator
+ * is locked to the edges of a signal.
+ * Without the clock recovery loop, true while HDLC data is received.
+ * \param af Afsk context to operate on.
+ */
+INLINE bool afsk_dcd(Afsk *af)
+{
+#if CONFIG_AFSK_PLL == AFSK_PLL_PI
+	/* The lock is kept without edges, as in silence: none in the last 8 bits is no carrier */
+	uint8_t bits = af->found_bits;
+	return bits != 0 && bits != 0xff && afsk_pllLock(&af->pll) >= AFSK_DCD_LOCK;
+#else
+	return af->hdlc.rxstart;
+#endif
+}
+
+void afsk_adc_isr(Afsk *af, afsk_sample_t sample);
 uint8_t afsk_dac_isr(Afsk *af);
 void afsk_init(Afsk *af, int adc_ch, int dac_ch);
+void afsk_setTxDelay(Afsk *af, uint16_t preamble_ms, uint16_t trailer_ms);
+size_t afsk_txRoom(KFile *fd);
+uint8_t afsk_txFrames(KFile *fd);
+void afsk_setCsma(Afsk *af, uint8_t persistence, uint16_t slot_ms, bool full_duplex);
+bool afsk_txClear(KFile *fd);
+
+#if CONFIG_AFSK_SAMPLE_BUFLEN
+size_t afsk_process_block(Afsk *af);
+#endif
+
+#if CONFIG_AFSK_WEAK_BITS
+uint8_t afsk_weakBits(KFile *fd, size_t frm_len, uint16_t *pos, uint8_t max);
+#endif
+
+#if CONFIG_AFSK_CHANNEL_LOAD
+uint8_t afsk_channelLoad(Afsk *af, uint8_t kind, uint8_t window);
+#endif
+
+#if CONFIG_AFSK_EQ
+void afsk_setTwist(Afsk *af, int8_t twist_db);
+
+/**
+ * Twist of the received audio measured by the equalizer: level of the
+ * space tone over the mark tone in dB, negative for de-emphasized audio.
+ * \param af Afsk context to operate on.
+ */
+INLINE int8_t afsk_twist(Afsk *af)
+{
+	return af->eq.twist;
+}
+#endif
+
+#if CONFIG_AFSK_SLICERS > 1
+/**
+ * Get the receive channel of an additional slicer.
+ * \param af Afsk context to operate on.
+ * \param idx slicer index, from 0 to CONFIG_AFSK_SLICERS - 2.
+ * \return the KFile to read the slicer data from.
+ */
+INLINE KFile *afsk_slicerChannel(Afsk *af, int idx)
+{
+	ASSERT(idx < CONFIG_AFSK_SLICERS - 1);
+	return &af->slicer[idx].fd;
+}
+#endif
+
+#if CONFIG_AFSK_FX25
+#define KFT_AFSK_FX25 MAKE_ID('A', 'F', 'X', '2')
+
+/**
+ * Get the channel of the frames recovered by the FX.25 decoder,
+ * to be polled along with the modem one (see ax25_addRxChannel()).
+ */
+INLINE KFile *afsk_fx25Channel(Afsk *af)
+{
+	return &af->fx25.fd;
+}
+#endif
 
 int afsk_testSetup(void);
 int afsk_testRun(void);
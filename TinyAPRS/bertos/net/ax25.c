@@ -55,6 +55,7 @@
 
 #include <cpu/irq.h>
 
+
 /*
  * Decode the CALL field, assume addr is a fix-size array
  */
@@ -66,34 +67,96 @@
 	}
 
 /*
+ * The frame arena, shared by all the contexts. Only the main loop
+ * uses it, so it needs no locking.
+ */
+static AX25Frame ax25_frame_items[CONFIG_AX25_FRAMES];
+static List ax25_frames;
+static bool ax25_frames_ready;
+static uint8_t ax25_frames_free;
+
+/**
+ * Take a frame buffer from the arena, with a reference for the caller.
+ *
+ * \return NULL if all the CONFIG_AX25_FRAMES buffers are in use.
+ */
+AX25Frame *ax25_frameAlloc(void)
+{
+	AX25Frame *frame;
+
+	if (!ax25_frames_ready)
+	{
+		LIST_INIT(&ax25_frames);
+		for (size_t i = 0; i < countof(ax25_frame_items); i++)
+			ADDTAIL(&ax25_frames, &ax25_frame_items[i].link);
+		ax25_frames_free = CONFIG_AX25_FRAMES;
+		ax25_frames_ready = true;
+	}
+	if (LIST_EMPTY(&ax25_frames))
+		return NULL;
+
+	frame = (AX25Frame *)list_remHead(&ax25_frames);
+	ax25_frames_free--;
+	frame->len = 0;
+	frame->refs = 1;
+	return frame;
+}
+
+/**
+ * Drop a reference to \a frame, the last one returns it to the arena.
+ */
+void ax25_frameRelease(AX25Frame *frame)
+{
+	ASSERT(frame->refs);
+
+	if (--frame->refs == 0)
+	{
+		ADDHEAD(&ax25_frames, &frame->link);
+		ax25_frames_free++;
+	}
+}
+
+/**
+ * \return the number of free buffers in the arena.
+ */
+uint8_t ax25_framesFree(void)
+{
+	return ax25_frames_ready ? ax25_frames_free : CONFIG_AX25_FRAMES;
+}
+
+/**
+ * Decode the UI frame received in \a frame, FCS included, into \a msg.
+ * The payload of \a msg points into the frame buffer.
+ *
  * The decoded ax25 frame contains:
  * | DST_ID(7) |SRC_ID(7) | RPT_LIST(7 * 8) | CTRL(0x03) | PID(0xF0) | PAYLOAD | LEN |
+ *
+ * \return false if it is not a UI frame without layer 3 protocol.
  */
-static void ax25_decode(AX25Ctx *ctx)
+bool ax25_frameDecode(const AX25Frame *frame, AX25Msg *msg)
 {
-	AX25Msg msg;
-	uint8_t *buf = ctx->buf;
+	const uint8_t *buf = frame->buf;
 
-	DECODE_CALL(buf, msg.dst.call);
-	msg.dst.ssid = (*buf++ >> 1) & 0x0F;
+	DECODE_CALL(buf, msg->dst.call);
+	msg->dst.ssid = (*buf++ >> 1) & 0x0F;
 
-	DECODE_CALL(buf, msg.src.call);
-	msg.src.ssid = (*buf >> 1) & 0x0F;
+	DECODE_CALL(buf, msg->src.call);
+	msg->src.ssid = (*buf >> 1) & 0x0F;
 
-	LOG_INFO("SRC[%.6s-%d], DST[%.6s-%d]\n", msg.src.call, msg.src.ssid, msg.dst.call, msg.dst.ssid);
+	LOG_INFO("SRC[%.6s-%d], DST[%.6s-%d]\n", msg->src.call, msg->src.ssid, msg->dst.call, msg->dst.ssid);
 
 	/* Repeater addresses */
 	#if CONFIG_AX25_RPT_LST
-		for (msg.rpt_cnt = 0; !(*buf++ & 0x01) && (msg.rpt_cnt < countof(msg.rpt_lst)); msg.rpt_cnt++)
+		for (msg->rpt_cnt = 0; !(*buf++ & 0x01) && (msg->rpt_cnt < countof(msg->rpt_lst)); msg->rpt_cnt++)
 		{
-			DECODE_CALL(buf, msg.rpt_lst[msg.rpt_cnt].call);
-			msg.rpt_lst[msg.rpt_cnt].ssid = (*buf >> 1) & 0x0F;
-			AX25_SET_REPEATED(&msg, msg.rpt_cnt, (*buf & 0x80));
-
-			LOG_INFO("RPT%d[%.6s-%d]%c\n", msg.rpt_cnt, 
-				msg.rpt_lst[msg.rpt_cnt].call, 
-				msg.rpt_lst[msg.rpt_cnt].ssid,
-				(AX25_REPEATED(&msg, msg.rpt_cnt) ? '*' : ' '));
+			DECODE_CALL(buf, msg->rpt_lst[msg->rpt_cnt].call);
+			msg->rpt_lst[msg->rpt_cnt].ssid = (*buf >> 1) & 0x0F;
+			AX25_SET_REPEATED(msg, msg->rpt_cnt, (*buf & 0x80));
+
+			LOG_INFO("RPT%d[%.6s-%d]%c\n", msg->rpt_cnt, 
+				msg->rpt_lst[msg->rpt_cnt].call, 
+				msg->rpt_lst[msg->rpt_cnt].ssid,
+				(AX25_REPEATED(msg, msg->rpt_cnt) ? '*' : ' '));
 		}
 	#else
 		while (!(*buf++ & 0x01))
@@ -106,28 +169,461 @@ static void ax25_decode(AX25Ctx *ctx)
 		}
 	#endif
 
-	msg.ctrl = *buf++;
-	if (msg.ctrl != AX25_CTRL_UI)
+	msg->ctrl = *buf++;
+	if (msg->ctrl != AX25_CTRL_UI)
+	{
+		LOG_WARN("Only UI frames are handled, got [%02X]\n", msg->ctrl);
+		return false;
+	}
+
+	msg->pid = *buf++;
+	if (msg->pid != AX25_PID_NOLAYER3)
+	{
+		LOG_WARN("Only frames without layer3 protocol are handled, got [%02X]\n", msg->pid);
+		return false;
+	}
+
+	msg->len = frame->len - 2 - (buf - frame->buf);
+	msg->info = buf;
+	LOG_INFO("DATA: %.*s\n", msg->len, msg->info);
+	return true;
+}
+
+static void ax25_decode(AX25Ctx *ctx)
+{
+	AX25Msg msg;
+
+	if (ax25_frameDecode(ctx->frame, &msg) && ctx->hook)
+		ctx->hook(&msg);
+}
+
+
+/*
+ * Chars of a receive channel, read a chunk at a time
+ * rather than a kfile_getc() call each.
+ */
+typedef struct AX25RxChunk
+{
+	uint8_t buf[16];
+	uint8_t pos;
+	uint8_t len;
+} AX25RxChunk;
+
+INLINE int ax25_getc(KFile *ch, AX25RxChunk *rc)
+{
+	if (rc->pos == rc->len)
 	{
-		LOG_WARN("Only UI frames are handled, got [%02X]\n", msg.ctrl);
+		rc->pos = 0;
+		rc->len = kfile_read(ch, rc->buf, sizeof(rc->buf));
+		if (!rc->len)
+			return EOF;
+	}
+	return rc->buf[rc->pos++];
+}
+
+/*
+ * Pass a received frame to the hook, decoding it
+ * unless the pass through mode is enabled.
+ */
+static void ax25_dispatch(AX25Ctx *ctx, AX25Frame *frame)
+{
+	ctx->frame = frame;
+
+	if (ctx->pass_through) {
+		if (ctx->hook) {
+			//TODO: make MSG union and pass to hook
+			ctx->hook(NULL);
+		}
+	} else {
+		ax25_decode(ctx);
+	}
+	ctx->frame = NULL;
+}
+
+/*
+ * A good frame has been received: queue it for ax25_rxDeliver(),
+ * taking a reference so that the receiver moves on to a new buffer,
+ * or pass it to the hook right away without a receive queue.
+ * Without a free buffer to move on to, the receiver would lose the
+ * next frame: this one is passed to the hook right away too, after
+ * the queued ones, and the receiver keeps its buffer.
+ */
+static void ax25_deliver(AX25Ctx *ctx, AX25Frame *frame)
+{
+	LOG_INFO("Frame found!\n");
+#if CONFIG_AX25_STAT
+	ATOMIC(ctx->stat.rx_ok++);
+#endif
+#if CONFIG_AX25_RX_QUEUE
+	if (ctx->rx_queued == CONFIG_AX25_RX_QUEUE)
+	{
+		LOG_INFO("Receive queue full\n");
+	#if CONFIG_AX25_STAT
+		ATOMIC(ctx->stat.rx_qdrop++);
+	#endif
 		return;
 	}
+	if (!ax25_framesFree())
+	{
+		while (ax25_rxDeliver(ctx))
+			;
+		ax25_dispatch(ctx, frame);
+		return;
+	}
+	ax25_frameRef(frame);
+	ADDTAIL(&ctx->rx_queue, &frame->link);
+	ctx->rx_queued++;
+	#if CONFIG_AX25_STAT
+	if (ctx->rx_queued > ctx->stat.rx_qmax)
+		ctx->stat.rx_qmax = ctx->rx_queued;
+	#endif
+#else
+	ax25_dispatch(ctx, frame);
+#endif
+}
+
+#if CONFIG_AX25_RX_QUEUE
+/**
+ * Pass the oldest frame of the receive queue to the hook.
+ * Call it from the main loop after ax25_poll(): the hook can take its
+ * time, even poll the channel meanwhile, the frames received go on
+ * queueing up.
+ *
+ * \return true if a frame has been delivered.
+ */
+bool ax25_rxDeliver(AX25Ctx *ctx)
+{
+	if (LIST_EMPTY(&ctx->rx_queue))
+		return false;
+
+	AX25Frame *frame = (AX25Frame *)list_remHead(&ctx->rx_queue);
+	ctx->rx_queued--;
+	ax25_dispatch(ctx, frame);
+	ax25_frameRelease(frame);
+	return true;
+}
+#endif
+
+#if CONFIG_AX25_RX_CHANNELS > 1
+
+/*
+ * The same frame reaches all the receive channels within a few bit
+ * times, or after the codeword padding and parity for an FX.25 decoder
+ * (less than 130 bytes, 870ms). A transmitter doesn't send the same
+ * frame again so soon, and digipeated copies differ in the address field.
+ */
+#define AX25_DUP_TIME 1000 // ms
+
+/*
+ * Check if a frame with the same FCS has just been delivered,
+ * otherwise remember this one.
+ */
+static bool ax25_isDuplicate(AX25Ctx *ctx, const AX25Frame *frame)
+{
+	uint16_t fcs = frame->buf[frame->len - 2] | (frame->buf[frame->len - 1] << 8);
+	ticks_t now = timer_clock();
+
+	for (uint8_t i = 0; i < AX25_DUP_HISTORY; i++)
+	{
+		if (ctx->dup_fcs[i] == fcs
+			&& now - ctx->dup_time[i] < ms_to_ticks(AX25_DUP_TIME))
+		{
+#if CONFIG_AX25_STAT
+			ATOMIC(ctx->stat.rx_dup++);
+#endif
+			return true;
+		}
+	}
+
+	ctx->dup_fcs[ctx->dup_idx] = fcs;
+	ctx->dup_time[ctx->dup_idx] = now;
+	ctx->dup_idx = (ctx->dup_idx + 1) % AX25_DUP_HISTORY;
+	return false;
+}
+
+/*
+ * Deliver a frame received on channel \a idx, if not a duplicate.
+ */
+static void ax25_deliverFrom(AX25Ctx *ctx, uint8_t idx, AX25Frame *frame)
+{
+#if CONFIG_AX25_STAT
+	ATOMIC(ctx->stat.rx_chan[idx]++);
+#else
+	(void)idx;
+#endif
+	if (!ax25_isDuplicate(ctx, frame))
+		ax25_deliver(ctx, frame);
+}
+
+/*
+ * Deliver the frame just received by channel \a idx in *\a rx_frame,
+ * whose buffer is kept for the next one unless the hook kept the frame.
+ */
+static void ax25_received(AX25Ctx *ctx, uint8_t idx, AX25Frame **rx_frame, size_t len);
+
+/*
+ * Collect the frames of an additional receive channel.
+ * Errors are not accounted here, the main channel does it.
+ */
+static void ax25_pollRx(AX25Ctx *ctx, uint8_t idx)
+{
+	AX25Rx *rx = &ctx->rx[idx - 1];
+	AX25RxChunk rc = { .pos = 0, .len = 0 };
+	int c;
+
+	while ((c = ax25_getc(rx->ch, &rc)) != EOF)
+	{
+		if (!rx->escape && c == HDLC_FLAG)
+		{
+			if (rx->frm_len >= AX25_MIN_FRAME_LEN && rx->crc_in == AX25_CRC_CORRECT)
+				ax25_received(ctx, idx, &rx->rx_frame, rx->frm_len);
+
+			rx->sync = true;
+			rx->crc_in = CRC_CCITT_INIT_VAL;
+			rx->frm_len = 0;
+			if (!rx->rx_frame)
+				rx->rx_frame = ax25_frameAlloc();
+			continue;
+		}
+
+		if (!rx->escape && c == HDLC_RESET)
+		{
+			rx->sync = false;
+			continue;
+		}
+
+		if (!rx->escape && c == AX25_ESC)
+		{
+			rx->escape = true;
+			continue;
+		}
+
+		if (rx->sync)
+		{
+			if (rx->frm_len < CONFIG_AX25_FRAME_BUF_LEN)
+			{
+				/* Without a buffer the frame is still checked, to count it */
+				if (rx->rx_frame)
+					rx->rx_frame->buf[rx->frm_len] = c;
+				rx->frm_len++;
+				rx->crc_in = updcrc_ccitt(c, rx->crc_in);
+			}
+			else
+				rx->sync = false;
+		}
+		rx->escape = false;
+	}
+
+	if (kfile_error(rx->ch))
+		kfile_clearerr(rx->ch);
+}
+
+#else
+	#define ax25_deliverFrom(ctx, idx, frame) ((void)(idx), ax25_deliver(ctx, frame))
+#endif
+
+static void ax25_received(AX25Ctx *ctx, uint8_t idx, AX25Frame **rx_frame, size_t len)
+{
+	AX25Frame *frame = *rx_frame;
 
-	msg.pid = *buf++;
-	if (msg.pid != AX25_PID_NOLAYER3)
+	if (!frame)
 	{
-		LOG_WARN("Only frames without layer3 protocol are handled, got [%02X]\n", msg.pid);
+		LOG_INFO("No free frame buffer\n");
+#if CONFIG_AX25_STAT
+		ATOMIC(ctx->stat.rx_nobuf++);
+#endif
 		return;
 	}
 
-	msg.len = ctx->frm_len - 2 - (buf - ctx->buf);
-	msg.info = buf;
-	LOG_INFO("DATA: %.*s\n", msg.len, msg.info);
+	frame->len = len;
+	ax25_deliverFrom(ctx, idx, frame);
+	if (frame->refs > 1)
+	{
+		ax25_frameRelease(frame);
+		*rx_frame = NULL;
+	}
+}
 
-	if (ctx->hook)
-		ctx->hook(&msg);
+#if CONFIG_AX25_CRC_FIX
+
+/*
+ * Number of low confidence bits used to repair a frame.
+ */
+#define AX25_FIX_WEAK_MAX 8
+
+/* Reflected CRC-CCITT polynomial, as in crc_ccitt_tab */
+#define AX25_CRC_POLY 0x8408
+
+/*
+ * Bits flipped by a repair candidate, \a n adjacent bits starting
+ * at \a pos, and the change they cause to the frame CRC.
+ */
+typedef struct AX25Flip
+{
+	uint16_t pos;
+	uint8_t n;
+	uint16_t delta;
+} AX25Flip;
+
+/*
+ * Check a callsign field: uppercase letters and digits,
+ * padded with trailing spaces, all shifted left by one.
+ */
+static bool ax25_callSane(const uint8_t *buf)
+{
+	bool pad = false;
+
+	for (uint8_t i = 0; i < 6; i++)
+	{
+		if (buf[i] & 0x01)
+			return false;
+
+		char c = buf[i] >> 1;
+		if (c == ' ')
+		{
+			if (i == 0)
+				return false;
+			pad = true;
+		}
+		else if (pad || !(isupper(c) || isdigit(c)))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Check that a repaired frame (FCS excluded) still looks like an APRS
+ * frame: valid address fields, UI frame without layer 3 protocol and
+ * a text payload.
+ */
+static bool ax25_sane(const uint8_t *buf, size_t len)
+{
+	const uint8_t *end = buf + len;
+	uint8_t addr = 0;
+
+	do
+	{
+		/* Room for this address, ctrl, pid and some info */
+		if (end - buf < 7 + 3 || addr == 2 + AX25_MAX_RPT || !ax25_callSane(buf))
+			return false;
+		buf += 7;
+		addr++;
+	} while (!(buf[-1] & 0x01));
+
+	if (addr < 2 || *buf++ != AX25_CTRL_UI || *buf++ != AX25_PID_NOLAYER3)
+		return false;
+
+	while (buf < end)
+	{
+		uint8_t c = *buf++;
+		if ((c < 0x1C || c > 0x7F) && c != '\r' && c != '\n')
+			return false;
+	}
+	return true;
 }
 
+static void ax25_flip(uint8_t *buf, const AX25Flip *f)
+{
+	for (uint8_t i = 0; i < f->n; i++)
+		buf[(f->pos + i) >> 3] ^= BV((f->pos + i) & 7);
+}
+
+/*
+ * Apply the flips \a a and \a b (if not NULL) to the received frame,
+ * keep them if the frame looks sane.
+ */
+static bool ax25_tryFix(AX25Ctx *ctx, const AX25Flip *a, const AX25Flip *b)
+{
+	ax25_flip(ctx->rx_frame->buf, a);
+	if (b)
+		ax25_flip(ctx->rx_frame->buf, b);
+
+	if (ax25_sane(ctx->rx_frame->buf, ctx->frm_len - 2))
+	{
+		LOG_INFO("CRC fixed, bit %d\n", a->pos);
+#if CONFIG_AX25_STAT
+		ATOMIC(ctx->stat.rx_fixed++);
+#endif
+		return true;
+	}
+
+	if (b)
+		ax25_flip(ctx->rx_frame->buf, b);
+	ax25_flip(ctx->rx_frame->buf, a);
+	return false;
+}
+
+/*
+ * Try to repair a frame received with a wrong CRC.
+ *
+ * The CRC is linear: flipping a bit changes the final CRC by a value that
+ * only depends on the distance of the bit from the end of the frame.
+ * Walking the frame backwards, these changes are compared with the
+ * syndrome (the difference from the correct CRC) to find single bit
+ * errors and adjacent bit pairs (a wrong NRZI level flips two bits).
+ * Then pairs of errors are searched among the low confidence bits
+ * reported by the physical layer.
+ *
+ * At most CONFIG_AX25_CRC_FIX_BUDGET bits are searched.
+ */
+static bool ax25_fixFrame(AX25Ctx *ctx)
+{
+	uint16_t syn = ctx->crc_in ^ AX25_CRC_CORRECT;
+	uint16_t nbits = ctx->frm_len * 8;
+	uint16_t steps = MIN(nbits, (uint16_t)CONFIG_AX25_CRC_FIX_BUDGET);
+
+	uint16_t weak[AX25_FIX_WEAK_MAX];
+	uint8_t w = 0;
+	if (ctx->weak_bits)
+		w = ctx->weak_bits(ctx->ch, ctx->frm_len, weak, countof(weak));
+
+	AX25Flip cand[AX25_FIX_WEAK_MAX * 2];
+	uint8_t cand_cnt = 0;
+
+	AX25Flip f;
+	uint16_t prev = 0;
+	f.delta = AX25_CRC_POLY;
+	for (uint16_t d = 0; d < steps; d++)
+	{
+		f.pos = nbits - 1 - d;
+		f.n = 1;
+		if (f.delta == syn && ax25_tryFix(ctx, &f, NULL))
+			return true;
+
+		AX25Flip pair = { f.pos, 2, f.delta ^ prev };
+		if (d && pair.delta == syn && ax25_tryFix(ctx, &pair, NULL))
+			return true;
+
+		/* Weak bits come in ascending order, we walk backwards */
+		for (; w && weak[w - 1] >= f.pos; w--)
+		{
+			if (weak[w - 1] != f.pos)
+				continue;
+			cand[cand_cnt++] = f;
+			if (d)
+				cand[cand_cnt++] = pair;
+		}
+
+		prev = f.delta;
+		f.delta = (f.delta & 1) ? (f.delta >> 1) ^ AX25_CRC_POLY : f.delta >> 1;
+	}
+
+	for (uint8_t i = 0; i < cand_cnt; i++)
+		for (uint8_t j = i + 1; j < cand_cnt; j++)
+			if ((cand[i].delta ^ cand[j].delta) == syn
+				&& ax25_tryFix(ctx, &cand[i], &cand[j]))
+				return true;
+
+	return false;
+}
+
+#else
+	#define ax25_fixFrame(ctx) false
+#endif
+
+#if CONFIG_AX25_TX_QUEUE
+static void ax25_txWrite(AX25Ctx *ctx, bool wait);
+#endif
 
 /**
  * Check if there are any AX25 messages to be processed.
@@ -137,32 +633,35 @@ static void ax25_decode(AX25Ctx *ctx)
  * This function may be blocking if there are no available chars and the KFile
  * used in \a ctx to access the medium is configured in blocking mode.
  *
+ * When more receive channels are in use, a frame is delivered only
+ * by the first channel that receives it.
+ * With CONFIG_AX25_CRC_FIX, frames with a wrong CRC received on the
+ * main channel are repaired when possible.
+ * With CONFIG_AX25_TX_QUEUE, the queued frames are written to the
+ * channel as long as it has room, and the tx_clear hook grants it;
+ * a frame already started is written whole, so this waits for the
+ * modulator for up to a frame length.
+ *
  * \param ctx AX25 context to operate on.
  */
 void ax25_poll(AX25Ctx *ctx)
 {
+	AX25RxChunk rc = { .pos = 0, .len = 0 };
 	int c;
 
-	while ((c = kfile_getc(ctx->ch)) != EOF)
+#if CONFIG_AX25_TX_QUEUE
+	ax25_txWrite(ctx, false);
+#endif
+
+	while ((c = ax25_getc(ctx->ch, &rc)) != EOF)
 	{
 		if (!ctx->escape && c == HDLC_FLAG)
 		{
 			if (ctx->frm_len >= AX25_MIN_FRAME_LEN)
 			{
-				if (ctx->crc_in == AX25_CRC_CORRECT)
+				if (ctx->crc_in == AX25_CRC_CORRECT || (ctx->rx_frame && ax25_fixFrame(ctx)))
 				{
-					LOG_INFO("Frame found!\n");
-#if CONFIG_AX25_STAT
-					ATOMIC(ctx->stat.rx_ok++);
-#endif
-					if (ctx->pass_through) {
-						if (ctx->hook) {
-							//TODO: make MSG union and pass to hook
-							ctx->hook(NULL);
-						}
-					} else {
-						ax25_decode(ctx);
-					}
+					ax25_received(ctx, 0, &ctx->rx_frame, ctx->frm_len);
 				}
 				else
 				{
@@ -175,6 +674,8 @@ void ax25_poll(AX25Ctx *ctx)
 			ctx->sync = true;
 			ctx->crc_in = CRC_CCITT_INIT_VAL;
 			ctx->frm_len = 0;
+			if (!ctx->rx_frame)
+				ctx->rx_frame = ax25_frameAlloc();
 
 			ctx->dcd_state = 0;
 			ctx->dcd = false;
@@ -199,7 +700,10 @@ void ax25_poll(AX25Ctx *ctx)
 		{
 			if (ctx->frm_len < CONFIG_AX25_FRAME_BUF_LEN)
 			{
-				ctx->buf[ctx->frm_len++] = c;
+				/* Without a buffer the frame is still checked, to count it */
+				if (ctx->rx_frame)
+					ctx->rx_frame->buf[ctx->frm_len] = c;
+				ctx->frm_len++;
 				ctx->crc_in = updcrc_ccitt(c, ctx->crc_in);
 
 				if (ctx->dcd_state == 1 && c == AX25_PID_NOLAYER3) {
@@ -235,6 +739,11 @@ void ax25_poll(AX25Ctx *ctx)
 #endif
 		ctx->dcd = false;
 	}
+
+#if CONFIG_AX25_RX_CHANNELS > 1
+	for (uint8_t i = 1; i <= ctx->rx_cnt; i++)
+		ax25_pollRx(ctx, i);
+#endif
 }
 
 void ax25_putchar(AX25Ctx *ctx, uint8_t c)
@@ -246,7 +755,12 @@ void ax25_putchar(AX25Ctx *ctx, uint8_t c)
 	kfile_putc(c, ctx->ch);
 }
 
-static void ax25_sendCall(AX25Ctx *ctx, const AX25Call *addr, bool last,bool repeated)
+/**
+ * Encode \a addr in the AX25_CALL_LEN chars of \a buf, as in the address
+ * field of a frame: shifted callsign and SSID byte, with the extension
+ * bit set if \a last and the H bit if \a repeated.
+ */
+void ax25_encodeCall(uint8_t *buf, const AX25Call *addr, bool last, bool repeated)
 {
 	unsigned len = MIN(sizeof(addr->call), strlen(addr->call));
 
@@ -255,22 +769,44 @@ static void ax25_sendCall(AX25Ctx *ctx, const AX25Call *addr, bool last,bool rep
 		uint8_t c = addr->call[i];
 		ASSERT(isalnum(c) || c == ' ');
 		c = toupper(c);
-		ax25_putchar(ctx, c << 1);
+		*buf++ = c << 1;
 	}
 
 	/* Fill with spaces the rest of the CALL if it's shorter */
 	if (len < sizeof(addr->call))
 		for (unsigned i = 0; i < sizeof(addr->call) - len; i++)
-			ax25_putchar(ctx, ' ' << 1);
+			*buf++ = ' ' << 1;
 
-	/* The bit7 "has-been-repeated" flag is not implemented here */
 	/* Bits6:5 should be set to 1 for all SSIDs (0x60) */
 	/* The bit0 of last call SSID should be set to 1 */
 	uint8_t ssid = 0x60 | (addr->ssid << 1) | (last ? 0x01 : 0);
 	if(repeated) ssid |= 0x80;
-	ax25_putchar(ctx, ssid);
+	*buf = ssid;
+}
+
+static void ax25_sendCall(AX25Ctx *ctx, const AX25Call *addr, bool last,bool repeated)
+{
+	uint8_t buf[AX25_CALL_LEN];
+
+	ax25_encodeCall(buf, addr, last, repeated);
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		ax25_putchar(ctx, buf[i]);
 }
 
+#if CONFIG_AX25_TX_QUEUE
+/*
+ * Frames sent by the blocking functions go after the queued ones,
+ * and are counted with them to tell when a queued frame has been sent.
+ * They do not wait for the channel (tx_clear): frames that must, are
+ * queued and tried again later when the queue is full.
+ */
+#define ax25_txSync(ctx)  ax25_txWrite((ctx), true)
+#define ax25_txCount(ctx) ((ctx)->tx_seq++)
+#else
+#define ax25_txSync(ctx)  do {} while (0)
+#define ax25_txCount(ctx) do {} while (0)
+#endif
+
 /**
  * Send an AX25 frame on the channel through a specific path.
  * \param ctx AX25 context to operate on.
@@ -286,6 +822,7 @@ void ax25_sendVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const voi
 	ASSERT(path);
 	ASSERT(path_len >= 2);
 
+	ax25_txSync(ctx);
 	ctx->crc_out = CRC_CCITT_INIT_VAL;
 	kfile_putc(HDLC_FLAG, ctx->ch);
 
@@ -313,6 +850,7 @@ void ax25_sendVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const voi
 
 	// flush
 	kfile_putc(HDLC_FLAG, ctx->ch);
+	ax25_txCount(ctx);
 
 #if CONFIG_AX25_STAT
 	ATOMIC(ctx->stat.tx_ok++);
@@ -326,6 +864,7 @@ void ax25_sendMsg(AX25Ctx *ctx, const AX25Msg *msg){
 	const uint8_t *buf = msg->info;
 	size_t len = msg->len;
 
+	ax25_txSync(ctx);
 	ctx->crc_out = CRC_CCITT_INIT_VAL;
 	kfile_putc(HDLC_FLAG, ctx->ch);
 
@@ -357,6 +896,7 @@ void ax25_sendMsg(AX25Ctx *ctx, const AX25Msg *msg){
 	ASSERT(ctx->crc_out == AX25_CRC_CORRECT);
 
 	kfile_putc(HDLC_FLAG, ctx->ch);
+	ax25_txCount(ctx);
 
 	// flush the channel, wait the radio send off
 	kfile_flush(ctx->ch);
@@ -370,6 +910,7 @@ void ax25_sendRaw(AX25Ctx *ctx, const void *_buf, size_t len)
 {
 	const uint8_t *buf = (const uint8_t *)_buf;
 
+	ax25_txSync(ctx);
 	ctx->crc_out = CRC_CCITT_INIT_VAL;
 	kfile_putc(HDLC_FLAG, ctx->ch);
 
@@ -388,6 +929,7 @@ void ax25_sendRaw(AX25Ctx *ctx, const void *_buf, size_t len)
 	ASSERT(ctx->crc_out == AX25_CRC_CORRECT);
 
 	kfile_putc(HDLC_FLAG, ctx->ch);
+	ax25_txCount(ctx);
 
 	// flush the channel, wait the radio send off
 	kfile_flush(ctx->ch);
@@ -397,6 +939,258 @@ void ax25_sendRaw(AX25Ctx *ctx, const void *_buf, size_t len)
 #endif
 }
 
+#if CONFIG_AX25_TX_QUEUE
+
+/*
+ * Write the queued frames to the channel, only as long as it has room
+ * unless \a wait is true, then call back for the frames already sent.
+ * A frame is written whole once started, waiting for room as the
+ * blocking sends do: if the modulator ran out of chars in the middle,
+ * it would close the frame with a flag and cut it on air.
+ */
+static void ax25_txWrite(AX25Ctx *ctx, bool wait)
+{
+	while (ctx->tx_wcnt < ctx->tx_cnt)
+	{
+		AX25TxFrame *f = &ctx->tx_q[(ctx->tx_first + ctx->tx_wcnt) % CONFIG_AX25_TX_QUEUE];
+
+		/* An escaped char takes two */
+		if (!wait && ctx->tx_pos == 0 && ctx->tx_room && ctx->tx_room(ctx->ch) < 2)
+			break;
+
+		/* Wait for the channel, the blocking sends do not */
+		if (!wait && ctx->tx_pos == 0 && ctx->tx_clear && !ctx->tx_clear(ctx->ch))
+			break;
+
+		if (ctx->tx_pos == 0)
+		{
+			ctx->crc_out = CRC_CCITT_INIT_VAL;
+			kfile_putc(HDLC_FLAG, ctx->ch);
+		}
+		else if (ctx->tx_pos <= f->len)
+		{
+			if (f->frame)
+				ax25_putchar(ctx, f->frame->buf[f->ofs + ctx->tx_pos - 1]);
+#if CONFIG_AX25_TX_BUF_LEN
+			else
+			{
+				ax25_putchar(ctx, ctx->tx_buf[ctx->tx_tail]);
+				ctx->tx_tail = (ctx->tx_tail + 1) % sizeof(ctx->tx_buf);
+				ctx->tx_used--;
+			}
+#endif
+		}
+		else if (ctx->tx_pos == f->len + 1)
+		{
+			/* CRC is sent in reverse order */
+			ctx->tx_fcs = ctx->crc_out ^ 0xFFFF;
+			ax25_putchar(ctx, ctx->tx_fcs & 0xff);
+		}
+		else if (ctx->tx_pos == f->len + 2)
+		{
+			ax25_putchar(ctx, ctx->tx_fcs >> 8);
+			ASSERT(ctx->crc_out == AX25_CRC_CORRECT);
+		}
+		else
+		{
+			kfile_putc(HDLC_FLAG, ctx->ch);
+			ax25_txCount(ctx);
+			f->seq = ctx->tx_seq;
+			ctx->tx_wcnt++;
+			ctx->tx_pos = 0;
+#if CONFIG_AX25_STAT
+			ATOMIC(ctx->stat.tx_ok++);
+#endif
+			continue;
+		}
+		ctx->tx_pos++;
+	}
+
+	while (ctx->tx_wcnt)
+	{
+		AX25TxFrame *f = &ctx->tx_q[ctx->tx_first];
+
+		if (ctx->tx_frames && (int8_t)(ctx->tx_frames(ctx->ch) - f->seq) < 0)
+			break;
+
+		ctx->tx_first = (ctx->tx_first + 1) % CONFIG_AX25_TX_QUEUE;
+		ctx->tx_cnt--;
+		ctx->tx_wcnt--;
+		if (f->frame)
+			ax25_frameRelease(f->frame);
+		if (f->sent)
+			f->sent(ctx, f->user);
+	}
+}
+
+/*
+ * Make room in the queue for a frame of \a len chars, FCS excluded,
+ * to be copied with ax25_txPut(): in tx_buf, or in a frame of the arena
+ * when tx_buf is full or disabled.
+ */
+static AX25TxFrame *ax25_txAdd(AX25Ctx *ctx, size_t len, ax25_sent_t sent, void *user)
+{
+	if (ctx->tx_cnt == CONFIG_AX25_TX_QUEUE)
+		return NULL;
+
+	AX25TxFrame *f = &ctx->tx_q[(ctx->tx_first + ctx->tx_cnt) % CONFIG_AX25_TX_QUEUE];
+	f->frame = NULL;
+#if CONFIG_AX25_TX_BUF_LEN
+	if (len > sizeof(ctx->tx_buf) - ctx->tx_used)
+#endif
+	{
+		if (len > CONFIG_AX25_FRAME_BUF_LEN || !(f->frame = ax25_frameAlloc()))
+			return NULL;
+	}
+	f->ofs = 0;
+	f->len = 0;
+	f->sent = sent;
+	f->user = user;
+	return f;
+}
+
+static void ax25_txPut(AX25Ctx *ctx, AX25TxFrame *f, const uint8_t *buf, size_t len)
+{
+	if (f->frame)
+	{
+		memcpy(f->frame->buf + f->len, buf, len);
+		f->len += len;
+		return;
+	}
+#if CONFIG_AX25_TX_BUF_LEN
+	f->len += len;
+	while (len--)
+	{
+		ctx->tx_buf[ctx->tx_head] = *buf++;
+		ctx->tx_head = (ctx->tx_head + 1) % sizeof(ctx->tx_buf);
+		ctx->tx_used++;
+	}
+#else
+	(void)ctx;
+#endif
+}
+
+static void ax25_txPutCall(AX25Ctx *ctx, AX25TxFrame *f, const AX25Call *addr, bool last, bool repeated)
+{
+	uint8_t buf[AX25_CALL_LEN];
+
+	ax25_encodeCall(buf, addr, last, repeated);
+	ax25_txPut(ctx, f, buf, sizeof(buf));
+}
+
+/*
+ * Complete the frame being queued and start sending it,
+ * if the channel is free.
+ */
+static void ax25_txQueued(AX25Ctx *ctx)
+{
+	ctx->tx_cnt++;
+	ax25_txWrite(ctx, false);
+}
+
+/**
+ * Queue an AX25 frame to be sent through a specific path, without waiting.
+ * The frame is written to the channel by ax25_poll(), after the frames
+ * already queued, and \a sent is called by ax25_poll() when it has been sent.
+ *
+ * \param ctx AX25 context to operate on.
+ * \param path An array of callsigns used as path, \see AX25_PATH.
+ * \param path_len callsigns path lenght.
+ * \param _buf payload buffer, copied in the queue (see CONFIG_AX25_TX_BUF_LEN).
+ * \param len length of the payload.
+ * \param sent callback called when the frame has been sent, may be NULL.
+ * \param user argument for \a sent.
+ *
+ * \return false if there is no room for the frame in the queue.
+ */
+bool ax25_queueVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const void *_buf, size_t len, ax25_sent_t sent, void *user)
+{
+	static const uint8_t ctrl_pid[] = { AX25_CTRL_UI, AX25_PID_NOLAYER3 };
+	ASSERT(path);
+	ASSERT(path_len >= 2);
+
+	AX25TxFrame *f = ax25_txAdd(ctx, path_len * AX25_CALL_LEN + sizeof(ctrl_pid) + len, sent, user);
+	if (!f)
+		return false;
+
+	for (size_t i = 0; i < path_len; i++)
+		ax25_txPutCall(ctx, f, &path[i], (i == path_len - 1), false);
+	ax25_txPut(ctx, f, ctrl_pid, sizeof(ctrl_pid));
+	ax25_txPut(ctx, f, (const uint8_t *)_buf, len);
+
+	ax25_txQueued(ctx);
+	return true;
+}
+
+/**
+ * Queue a raw AX25 frame (addresses to payload, FCS excluded)
+ * to be sent without waiting, see ax25_queueVia().
+ */
+bool ax25_queueRaw(AX25Ctx *ctx, const void *_buf, size_t len, ax25_sent_t sent, void *user)
+{
+	AX25TxFrame *f = ax25_txAdd(ctx, len, sent, user);
+	if (!f)
+		return false;
+
+	ax25_txPut(ctx, f, (const uint8_t *)_buf, len);
+	ax25_txQueued(ctx);
+	return true;
+}
+
+/**
+ * Queue a decoded AX25 message to be sent without waiting, with the
+ * has-been-repeated flags of its path, see ax25_queueVia().
+ * Messages without repeaters or payload are not sent, as in ax25_sendMsg().
+ */
+bool ax25_queueMsg(AX25Ctx *ctx, const AX25Msg *msg, ax25_sent_t sent, void *user)
+{
+	static const uint8_t ctrl_pid[] = { AX25_CTRL_UI, AX25_PID_NOLAYER3 };
+
+	if (msg->rpt_cnt == 0 || msg->len == 0)
+		return false;
+
+	AX25TxFrame *f = ax25_txAdd(ctx, (2 + msg->rpt_cnt) * AX25_CALL_LEN + sizeof(ctrl_pid) + msg->len, sent, user);
+	if (!f)
+		return false;
+
+	ax25_txPutCall(ctx, f, &msg->dst, false, false);
+	ax25_txPutCall(ctx, f, &msg->src, false, false);
+	for (uint8_t i = 0; i < msg->rpt_cnt; i++)
+		ax25_txPutCall(ctx, f, &msg->rpt_lst[i], (i == msg->rpt_cnt - 1), AX25_REPEATED(msg, i));
+	ax25_txPut(ctx, f, ctrl_pid, sizeof(ctrl_pid));
+	ax25_txPut(ctx, f, msg->info, msg->len);
+
+	ax25_txQueued(ctx);
+	return true;
+}
+
+/**
+ * Queue a raw AX25 frame held in a frame of the arena, without copying
+ * it: \a len chars from \a ofs (addresses to payload, FCS excluded).
+ * The queue takes its own reference to \a frame until it has been sent,
+ * see ax25_queueVia().
+ *
+ * \return false if the queue is full.
+ */
+bool ax25_queueFrame(AX25Ctx *ctx, AX25Frame *frame, size_t ofs, size_t len, ax25_sent_t sent, void *user)
+{
+	ASSERT(ofs + len <= sizeof(frame->buf));
+
+	if (ctx->tx_cnt == CONFIG_AX25_TX_QUEUE)
+		return false;
+
+	AX25TxFrame *f = &ctx->tx_q[(ctx->tx_first + ctx->tx_cnt) % CONFIG_AX25_TX_QUEUE];
+	f->frame = ax25_frameRef(frame);
+	f->ofs = ofs;
+	f->len = len;
+	f->sent = sent;
+	f->user = user;
+
+	ax25_txQueued(ctx);
+	return true;
+}
+#endif
+
 static void print_call(KFile *ch, const AX25Call *call)
 {
 #if CPU_AVR
@@ -461,4 +1255,27 @@ void ax25_init(AX25Ctx *ctx, KFile *channel, ax25_callback_t hook)
 	// AS a TNC modem with KISS protocol used, pass_though could be enabled(set=1)
 	ctx->pass_through = 0;
 	ctx->crc_in = ctx->crc_out = CRC_CCITT_INIT_VAL;
+#if CONFIG_AX25_RX_QUEUE
+	LIST_INIT(&ctx->rx_queue);
+#endif
 }
+
+#if CONFIG_AX25_RX_CHANNELS > 1
+/**
+ * Add a receive channel to the AX25 protocol decoder.
+ * Frames received on this channel are delivered to the same hook,
+ * unless another channel received them first.
+ *
+ * \param ctx AX25 context to operate on.
+ * \param channel Used to receive from the physical medium
+ */
+void ax25_addRxChannel(AX25Ctx *ctx, KFile *channel)
+{
+	ASSERT(channel);
+	ASSERT(ctx->rx_cnt < countof(ctx->rx));
+
+	AX25Rx *rx = &ctx->rx[ctx->rx_cnt++];
+	rx->ch = channel;
+	rx->crc_in = CRC_CCITT_INIT_VAL;
+}
+#endif
@@ -49,6 +49,8 @@
 
 #include <cfg/compiler.h>
 #include <io/kfile.h>
+#include <drv/timer.h>
+#include <struct/list.h>
 
 /**
  * Maximum size of a AX25 frame.
@@ -63,25 +65,124 @@
 
 struct AX25Msg; // fwd declaration
 
+/**
+ * Frame buffer of the arena shared by the receivers, the transmit queue
+ * and the application, see ax25_frameAlloc().
+ *
+ * A frame is handed over without copies: each owner takes a reference
+ * with ax25_frameRef() and drops it with ax25_frameRelease(), the last
+ * one returns the buffer to the arena.
+ */
+typedef struct AX25Frame
+{
+	Node link;     ///< Free list of the arena, then free for the owner
+	uint16_t len;  ///< Frame length, FCS included for received frames
+	uint8_t refs;  ///< Owners of the frame
+	uint8_t buf[CONFIG_AX25_FRAME_BUF_LEN];
+} AX25Frame;
+
 /**
  * Type for AX25 messages callback.
  */
 typedef void (*ax25_callback_t)(struct AX25Msg *msg);
 
+#if CONFIG_AX25_CRC_FIX
+/**
+ * Type for the callback giving the positions of the low confidence bits
+ * of the last frame received by the physical layer (see afsk_weakBits()).
+ */
+typedef uint8_t (*ax25_weak_bits_t)(KFile *ch, size_t frm_len, uint16_t *pos, uint8_t max);
+#endif
+
+#if CONFIG_AX25_TX_QUEUE
+struct AX25Ctx; // fwd declaration
+
+/**
+ * Type for the callback called when a queued frame has been sent.
+ */
+typedef void (*ax25_sent_t)(struct AX25Ctx *ctx, void *user);
+
+/**
+ * Type for the callback giving the room in the transmit buffer of the
+ * physical layer, the chars that can be written without waiting
+ * (see afsk_txRoom()).
+ */
+typedef size_t (*ax25_tx_room_t)(KFile *ch);
+
+/**
+ * Type for the callback giving the number of frames sent by the
+ * physical layer, wrapping around (see afsk_txFrames()).
+ */
+typedef uint8_t (*ax25_tx_frames_t)(KFile *ch);
+
+/**
+ * Type for the callback granting the channel to a new transmission,
+ * polled until it returns true (see afsk_txClear()).
+ */
+typedef bool (*ax25_tx_clear_t)(KFile *ch);
+
+/**
+ * Frame in the transmit queue.
+ */
+typedef struct AX25TxFrame
+{
+	AX25Frame *frame; ///< Buffer of the frame, or NULL if it is in tx_buf
+	uint8_t ofs;      ///< Start of the frame in the buffer
+	uint16_t len;     ///< Frame length, FCS excluded
+	ax25_sent_t sent; ///< Called when the frame has been sent, optional
+	void *user;       ///< Argument passed to \a sent
+	uint8_t seq;      ///< Frames written to the channel, this one included
+} AX25TxFrame;
+#endif
+
 #if CONFIG_AX25_STAT
 typedef struct AX25Stat{
 	uint32_t rx_ok;
 	uint32_t tx_ok;
 	uint32_t rx_err;
+	uint32_t rx_nobuf; ///< Good frames lost because the arena had no free buffer
+#if CONFIG_AX25_CRC_FIX
+	uint32_t rx_fixed; ///< Frames with a wrong CRC repaired, counted in rx_ok too
+#endif
+#if CONFIG_AX25_RX_QUEUE
+	uint32_t rx_qdrop; ///< Good frames dropped because the receive queue was full
+	uint8_t rx_qmax;   ///< High-water mark of the receive queue
+#endif
+#if CONFIG_AX25_RX_CHANNELS > 1
+	uint32_t rx_dup; ///< Frames dropped because already received on another channel
+	uint32_t rx_chan[CONFIG_AX25_RX_CHANNELS]; ///< Good frames received by each channel, duplicates included
+#endif
 }AX25Stat;
 #endif
 
+#if CONFIG_AX25_RX_CHANNELS > 1
+/**
+ * Additional receive channel.
+ * Frames are collected here as on the main channel and
+ * delivered only if no other channel received them.
+ */
+typedef struct AX25Rx
+{
+	AX25Frame *rx_frame; ///< buffer for received chars, NULL if the arena was empty
+	KFile *ch;        ///< KFile used to access the physical medium
+	size_t frm_len;   ///< received frame length.
+	uint16_t crc_in;  ///< CRC for current received frame
+	bool sync;   ///< True if we have received a HDLC flag.
+	bool escape; ///< True when we have to escape the following char.
+} AX25Rx;
+
+/**
+ * Number of recently delivered frames checked for duplicates.
+ */
+#define AX25_DUP_HISTORY 4
+#endif
+
 /**
  * AX25 Protocol context.
  */
 typedef struct AX25Ctx
 {
-	uint8_t buf[CONFIG_AX25_FRAME_BUF_LEN]; ///< buffer for received chars
+	AX25Frame *rx_frame; ///< buffer for received chars, NULL if the arena was empty
 	KFile *ch;        ///< KFile used to access the physical medium
 	size_t frm_len;   ///< received frame length.
 	uint16_t crc_in;  ///< CRC for current received frame
@@ -93,6 +194,44 @@ typedef struct AX25Ctx
 	uint8_t dcd_state;
 	bool dcd;
 
+	AX25Frame *frame; ///< Received frame passed to the hook, FCS included
+
+#if CONFIG_AX25_CRC_FIX
+	ax25_weak_bits_t weak_bits; ///< Low confidence bits of the main channel, optional
+#endif
+
+#if CONFIG_AX25_RX_CHANNELS > 1
+	AX25Rx rx[CONFIG_AX25_RX_CHANNELS - 1]; ///< Additional receive channels
+	uint8_t rx_cnt;       ///< Number of additional receive channels in use
+	uint16_t dup_fcs[AX25_DUP_HISTORY];   ///< FCS of the last delivered frames
+	ticks_t dup_time[AX25_DUP_HISTORY];   ///< Delivery time of the last frames
+	uint8_t dup_idx;      ///< Next entry to be replaced in the history
+#endif
+
+#if CONFIG_AX25_RX_QUEUE
+	List rx_queue;    ///< Frames received, waiting for ax25_rxDeliver()
+	uint8_t rx_queued; ///< Frames in rx_queue
+#endif
+
+#if CONFIG_AX25_TX_QUEUE
+	ax25_tx_room_t tx_room;     ///< Room in the transmit buffer of the channel, optional
+	ax25_tx_frames_t tx_frames; ///< Frames sent by the channel, optional
+	ax25_tx_clear_t tx_clear;   ///< Channel access before each frame, optional
+	AX25TxFrame tx_q[CONFIG_AX25_TX_QUEUE]; ///< Frames queued or being sent
+	uint8_t tx_first; ///< Oldest frame in tx_q
+	uint8_t tx_cnt;   ///< Frames in tx_q
+	uint8_t tx_wcnt;  ///< Frames in tx_q already written to the channel
+	uint8_t tx_seq;   ///< Frames written to the channel, wrapping around
+	uint16_t tx_pos;  ///< Position in the frame being written, 0 for the opening flag
+	uint16_t tx_fcs;  ///< FCS of the frame being written
+#if CONFIG_AX25_TX_BUF_LEN
+	uint8_t tx_buf[CONFIG_AX25_TX_BUF_LEN]; ///< Data of the queued frames copied by the queue
+	uint16_t tx_head; ///< Where the data of the next queued frame goes
+	uint16_t tx_tail; ///< Next char of tx_buf to be written to the channel
+	uint16_t tx_used; ///< Chars of tx_buf in use
+#endif
+#endif
+
 #if CONFIG_AX25_STAT
 	volatile AX25Stat stat;
 #endif
@@ -120,6 +259,11 @@ typedef struct AX25Call
  */
 #define AX25_MAX_RPT 8
 
+/**
+ * Length of an encoded address, shifted callsign and SSID byte.
+ */
+#define AX25_CALL_LEN 7
+
 /*
  * Has to be lesser than 8 in order to fit in one byte
  * change AX25Msg.rpt_flags if you need more repeaters.
@@ -192,6 +336,19 @@ typedef struct AX25Msg
  */
 #define AX25_PATH(dst, src, ...) { dst, src, ## __VA_ARGS__ }
 
+AX25Frame *ax25_frameAlloc(void);
+void ax25_frameRelease(AX25Frame *frame);
+uint8_t ax25_framesFree(void);
+
+/**
+ * Take a reference to \a frame, to keep it after passing it on.
+ */
+INLINE AX25Frame *ax25_frameRef(AX25Frame *frame)
+{
+	frame->refs++;
+	return frame;
+}
+
 void ax25_poll(AX25Ctx *ctx);
 void ax25_sendVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const void *_buf, size_t len);
 void ax25_sendRaw(AX25Ctx *ctx, const void *_buf, size_t len);
@@ -212,7 +369,39 @@ void ax25_sendMsg(AX25Ctx *ctx, const AX25Msg *msg);
  */
 #define ax25_send(ctx, dst, src, buf, len) ax25_sendVia(ctx, ({static AX25Call __path[]={dst, src}; __path;}), 2, buf, len)
 void ax25_init(AX25Ctx *ctx, KFile *channel, ax25_callback_t hook);
+#if CONFIG_AX25_RX_CHANNELS > 1
+void ax25_addRxChannel(AX25Ctx *ctx, KFile *channel);
+#endif
+
+#if CONFIG_AX25_TX_QUEUE
+bool ax25_queueVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const void *_buf, size_t len, ax25_sent_t sent, void *user);
+bool ax25_queueRaw(AX25Ctx *ctx, const void *_buf, size_t len, ax25_sent_t sent, void *user);
+bool ax25_queueMsg(AX25Ctx *ctx, const AX25Msg *msg, ax25_sent_t sent, void *user);
+bool ax25_queueFrame(AX25Ctx *ctx, AX25Frame *frame, size_t ofs, size_t len, ax25_sent_t sent, void *user);
+
+/**
+ * \return the number of queued frames not sent yet.
+ */
+INLINE uint8_t ax25_txPending(const AX25Ctx *ctx)
+{
+	return ctx->tx_cnt;
+}
+#endif
+
+#if CONFIG_AX25_RX_QUEUE
+bool ax25_rxDeliver(AX25Ctx *ctx);
+
+/**
+ * \return the number of received frames waiting for ax25_rxDeliver().
+ */
+INLINE uint8_t ax25_rxPending(const AX25Ctx *ctx)
+{
+	return ctx->rx_queued;
+}
+#endif
 
+bool ax25_frameDecode(const AX25Frame *frame, AX25Msg *msg);
+void ax25_encodeCall(uint8_t *buf, const AX25Call *addr, bool last, bool repeated);
 void ax25_print(KFile *ch, const AX25Msg *msg);
 
 int ax25_testSetup(void);
@@ -0,0 +1,99 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief FX.25 correlation tags and codes.
+ */
+
+#include "fx25.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+#include <cpu/pgm.h>
+
+/*
+ * Correlation tags 0x01 to 0x0B of the FX.25 specification,
+ * shortest code first for each number of parity bytes.
+ */
+static const Fx25Code PROGMEM fx25_codes[] =
+{
+	{ 0x369660EE, 0x8F056EB4,  48,  32 },
+	{ 0xF3D9B09E, 0xC7DC0508,  80,  64 },
+	{ 0x00CC8FDE, 0x26FF60A6, 144, 128 },
+	{ 0x8A532F3E, 0xB74DB7DF, 255, 239 },
+	{ 0x2DBB1776, 0xDBF869BD,  64,  32 },
+	{ 0xBC09C00E, 0x1EB7B9CD,  96,  64 },
+	{ 0x4F1CFF4E, 0xFF94DC63, 160, 128 },
+	{ 0xC5835FAE, 0x6E260B1A, 255, 223 },
+	{ 0xA724B796, 0x4A4ABEC4, 128,  64 },
+	{ 0x543188D6, 0xAB69DB6A, 192, 128 },
+	{ 0xDEAE2836, 0x3ADB0C13, 255, 191 },
+};
+
+/*
+ * Count the bits set, giving up when more than FX25_TAG_ERR.
+ */
+INLINE uint8_t fx25_tagErr(uint32_t x, uint8_t err)
+{
+	while (x && err <= FX25_TAG_ERR)
+	{
+		x &= x - 1;
+		err++;
+	}
+	return err;
+}
+
+/**
+ * Look for a correlation tag in the last 64 received bits.
+ * \param lo first 32 bits received, first one in the LSB.
+ * \param hi last 32 bits received.
+ * \return the index of the code, -1 if none matches.
+ */
+int8_t fx25_findTag(uint32_t lo, uint32_t hi)
+{
+	for (int8_t i = 0; i < (int8_t)countof(fx25_codes); i++)
+	{
+		uint32_t tag_lo = pgm_read32(&fx25_codes[i].tag_lo);
+		uint32_t tag_hi = pgm_read32(&fx25_codes[i].tag_hi);
+
+		if (fx25_tagErr(lo ^ tag_lo, fx25_tagErr(hi ^ tag_hi, 0)) <= FX25_TAG_ERR)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * Choose the shortest code with \a nroots parity bytes
+ * that fits \a len data bytes.
+ * \return the index of the code, -1 if the data is too long.
+ */
+int8_t fx25_pickCode(uint8_t nroots, size_t len)
+{
+	for (int8_t i = 0; i < (int8_t)countof(fx25_codes); i++)
+	{
+		uint8_t n = pgm_read8(&fx25_codes[i].n);
+		uint8_t k = pgm_read8(&fx25_codes[i].k);
+
+		if (n - k == nroots && len <= k)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * Get the code with index \a idx.
+ */
+void fx25_code(int8_t idx, Fx25Code *code)
+{
+	ASSERT(idx >= 0 && idx < (int8_t)countof(fx25_codes));
+	code->tag_lo = pgm_read32(&fx25_codes[idx].tag_lo);
+	code->tag_hi = pgm_read32(&fx25_codes[idx].tag_hi);
+	code->n = pgm_read8(&fx25_codes[idx].n);
+	code->k = pgm_read8(&fx25_codes[idx].k);
+}
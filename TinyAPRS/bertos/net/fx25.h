@@ -0,0 +1,51 @@
+/**
+ * \file
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ *
+ * -->
+ *
+ * \brief FX.25 forward error correction for AX.25 frames.
+ *
+ * An FX.25 frame is a 64 bit correlation tag followed by a Reed-Solomon
+ * codeword. The data part of the codeword holds the usual HDLC bitstream
+ * of the AX.25 frame (flags, bit stuffing and FCS included), padded with
+ * flags, so that plain AX.25 receivers still decode it.
+ *
+ * $WIZ$ module_name = "fx25"
+ * $WIZ$ module_depends = "rs"
+ */
+
+#ifndef NET_FX25_H
+#define NET_FX25_H
+
+#include <cfg/compiler.h>
+
+/** Length of the correlation tag, in bytes */
+#define FX25_TAG_LEN 8
+
+/** Maximum data length of a codeword */
+#define FX25_MAX_DATA 239
+
+/** Bit errors allowed in a received correlation tag */
+#define FX25_TAG_ERR 4
+
+/**
+ * FX.25 code: correlation tag and Reed-Solomon code it announces.
+ */
+typedef struct Fx25Code
+{
+	uint32_t tag_lo; ///< Least significant (first sent) half of the tag
+	uint32_t tag_hi; ///< Most significant half of the tag
+	uint8_t n;       ///< Bytes sent after the tag
+	uint8_t k;       ///< Data bytes, the rest are parity
+} Fx25Code;
+
+int8_t fx25_findTag(uint32_t lo, uint32_t hi);
+int8_t fx25_pickCode(uint8_t nroots, size_t len);
+void fx25_code(int8_t idx, Fx25Code *code);
+
+#endif /* NET_FX25_H */
@@ -0,0 +1,220 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2015 Shawn Chain (shawn.chain@gmail.com)
+ * -->
+ *
+ * \defgroup spscbuf Single producer, single consumer ring buffer
+ * \ingroup struct
+ * \{
+ *
+ * \brief Lock-free ring buffer between one producer and one consumer,
+ * e.g. an ISR and the main loop.
+ *
+ * Unlike the FIFOBuffer, whose pointers can't be updated atomically by
+ * an 8-bit CPU, the ring is indexed by two 8-bit counters:
+ * \li \c head counts the chars popped, it is written by the consumer only;
+ * \li \c tail counts the chars pushed, it is written by the producer only;
+ * \li both wrap around at 256, the size of the buffer being a power
+ *     of 2, from 2 to 128, so that \c tail - \c head is the number of
+ *     chars in the buffer.
+ *
+ * Each side reads the counter of the other one with a single load and
+ * updates its own after accessing the data, so no interrupt masking
+ * is needed. Unlike the FIFOBuffer all the \a size chars can be used.
+ *
+ * The ordering relies on the compiler barrier only, which is enough on a
+ * single core CPU without a write buffer, like the AVR.
+ *
+ * Hosted builds needing larger rings (e.g. benchmarks queueing whole
+ * frames without a running ISR) can define SPSC_WIDE_INDEX to 1, for
+ * 16-bit counters and up to SPSC_MAX_LEN = 32768 chars.
+ *
+ * \author Shawn Chain <shawn.chain@gmail.com>
+ */
+
+#ifndef STRUCT_SPSCBUF_H
+#define STRUCT_SPSCBUF_H
+
+#include <cfg/compiler.h>
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN() */
+#include <cpu/irq.h> /* ATOMIC() */
+
+#include <string.h> /* memcpy() */
+
+#if defined(SPSC_WIDE_INDEX) && SPSC_WIDE_INDEX
+	typedef uint16_t spsc_idx_t;
+	#define SPSC_MAX_LEN 32768
+#else
+	typedef uint8_t spsc_idx_t;
+	#define SPSC_MAX_LEN 128
+#endif
+
+typedef struct SpscBuffer
+{
+	volatile spsc_idx_t head; ///< Chars popped, wrapping around
+	volatile spsc_idx_t tail; ///< Chars pushed, wrapping around
+	spsc_idx_t mask;          ///< Buffer size - 1
+	unsigned char *buf;
+} SpscBuffer;
+
+
+/**
+ * Ring initialization, \a size must be a power of 2 from 2 to SPSC_MAX_LEN.
+ */
+INLINE void spsc_init(SpscBuffer *sb, unsigned char *buf, size_t size)
+{
+	ASSERT(size >= 2 && size <= SPSC_MAX_LEN && !(size & (size - 1)));
+
+	sb->head = sb->tail = 0;
+	sb->mask = size - 1;
+	sb->buf = buf;
+}
+
+/**
+ * \return the size of the ring \a sb.
+ */
+INLINE size_t spsc_len(const SpscBuffer *sb)
+{
+	return sb->mask + 1;
+}
+
+/**
+ * \return the number of chars in the ring, safe from both sides.
+ */
+INLINE spsc_idx_t spsc_count(const SpscBuffer *sb)
+{
+	return (spsc_idx_t)(sb->tail - sb->head);
+}
+
+/**
+ * \return the number of chars that can be pushed, safe from both sides.
+ */
+INLINE spsc_idx_t spsc_room(const SpscBuffer *sb)
+{
+	return sb->mask + 1 - spsc_count(sb);
+}
+
+INLINE bool spsc_isempty(const SpscBuffer *sb)
+{
+	return sb->head == sb->tail;
+}
+
+INLINE bool spsc_isfull(const SpscBuffer *sb)
+{
+	return spsc_count(sb) > sb->mask;
+}
+
+/**
+ * Push a char, from the producer only.
+ * \note Calling spsc_push() on a full ring is undefined.
+ */
+INLINE void spsc_push(SpscBuffer *sb, unsigned char c)
+{
+	spsc_idx_t tail = sb->tail;
+
+	sb->buf[tail & sb->mask] = c;
+	MEMORY_BARRIER;
+	sb->tail = tail + 1;
+}
+
+/**
+ * Pop a char, from the consumer only.
+ * \note Calling spsc_pop() on an empty ring is undefined.
+ */
+INLINE unsigned char spsc_pop(SpscBuffer *sb)
+{
+	spsc_idx_t head = sb->head;
+	unsigned char c = sb->buf[head & sb->mask];
+
+	MEMORY_BARRIER;
+	sb->head = head + 1;
+	return c;
+}
+
+/**
+ * Push up to \a len chars, as many as there is room for, from the
+ * producer only.
+ *
+ * \return the number of chars pushed.
+ */
+INLINE size_t spsc_push_n(SpscBuffer *sb, const unsigned char *data, size_t len)
+{
+	spsc_idx_t tail = sb->tail;
+	spsc_idx_t pos = tail & sb->mask;
+	size_t n = MIN(len, (size_t)spsc_room(sb));
+	size_t first = MIN(n, (size_t)(sb->mask + 1 - pos));
+
+	memcpy(sb->buf + pos, data, first);
+	memcpy(sb->buf, data + first, n - first);
+	MEMORY_BARRIER;
+	sb->tail = tail + n;
+	return n;
+}
+
+/**
+ * Pop up to \a len chars, as many as there are, from the consumer only.
+ *
+ * \return the number of chars popped.
+ */
+INLINE size_t spsc_pop_n(SpscBuffer *sb, unsigned char *data, size_t len)
+{
+	spsc_idx_t head = sb->head;
+	spsc_idx_t pos = head & sb->mask;
+	size_t n = MIN(len, (size_t)spsc_count(sb));
+	size_t first = MIN(n, (size_t)(sb->mask + 1 - pos));
+
+	memcpy(data, sb->buf + pos, first);
+	memcpy(data + first, sb->buf, n - first);
+	MEMORY_BARRIER;
+	sb->head = head + n;
+	return n;
+}
+
+/**
+ * Discard the chars in the ring, from the consumer only.
+ */
+INLINE void spsc_flush(SpscBuffer *sb)
+{
+	sb->head = sb->tail;
+}
+
+/**
+ * Discard the chars in the ring, from either side: the other side
+ * is kept out by masking the interrupts, e.g. for the producer of
+ * a ring whose consumer is an ISR.
+ */
+INLINE void spsc_flush_locked(SpscBuffer *sb)
+{
+	ATOMIC(sb->head = sb->tail);
+}
+
+/** \} */ /* defgroup spscbuf */
+
+#endif /* STRUCT_SPSCBUF_H */